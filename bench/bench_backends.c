@@ -0,0 +1,200 @@
+// End-to-end comparison of the execution backends on TAC programs: the
+// reference interpreter, the VM, the x86-64 JIT, the x86-64 backend through
+// assembly text and through a direct ELF object, and the C backend compiled
+// with cc -O2 as the native-speed baseline. Build and run times are wall
+// clock, best of BENCH_RUNS; every backend's result is checked against the
+// reference interpreter (native programs report it as the exit status,
+// so only its low 8 bits are compared). A built-in program that keeps int
+// and float values live in one loop is always included, run through phase 5
+// with its default register allocation first.
+// Build the phases and run from the repository root:
+//     gcc -O2 phase_5_optimizer.c -o phase_5_optimizer
+//     gcc -O2 phase_6_vm.c -o phase_6_vm
+//     gcc -O2 phase_7_x86_backend.c -o phase_7_x86_backend
+//     gcc -O2 phase_8_c_backend.c -o phase_8_c_backend
+//     gcc -O2 -I. bench/bench_backends.c -o bench_backends && ./bench_backends [tac_opt.txt ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define BENCH_RUNS 3
+#define OPT_CMD    "./phase_5_optimizer"
+#define VM_CMD     "./phase_6_vm"
+#define X86_CMD    "./phase_7_x86_backend"
+#define C_CMD      "./phase_8_c_backend"
+#define CC_CMD     "cc"
+#define MIXED_IN   "bench_mix_in.txt"
+#define MIXED_FILE "bench_mix.txt"
+
+//--------------------------------------------------- Backends
+// In-process backends print "main returned N"; native ones are built once
+// and then run as programs.
+typedef struct {
+    const char *name;
+    const char *build;      // Build command, NULL if none; %s is the TAC file
+    const char *run;        // Run command; %s is the TAC file
+    const char *marker;     // Result line prefix, NULL for the exit status
+} Backend;
+
+static const Backend backends[] = {
+    { "vm",    NULL, VM_CMD " %s", "[vm] main returned " },
+    { "jit",   NULL, X86_CMD " -jit %s", "[jit] main returned " },
+    { "asm",   X86_CMD " -o bench_out.s %s > /dev/null && " CC_CMD " bench_out.s -o bench_out_asm",
+               "./bench_out_asm", NULL },
+    { "elf",   X86_CMD " -c -o bench_out.o %s > /dev/null && " CC_CMD " bench_out.o -o bench_out_elf",
+               "./bench_out_elf", NULL },
+    { "c -O2", C_CMD " -o bench_out.c %s > /dev/null && " CC_CMD " -O2 bench_out.c -o bench_out_c",
+               "./bench_out_c", NULL },
+};
+
+//--------------------------------------------------- Mixed Program
+// Phase 4's output for a loop carrying a float and an int recurrence:
+//     for (n = 0; n < count; n = n + 1) {
+//         f = f * 0.5 + 1.0;
+//         s = (s * 3 + n) % 1000 - n % 7;
+//     }
+// Their temps are live together, so the register allocator has to keep
+// the two classes apart.
+static const char *mixed_program =
+    "global limit = 1000000\n"
+    "func mix(count):\n"
+    "f = 1.0\n"
+    "s = 0\n"
+    "n = 0\n"
+    "ifFalse n < count goto L1\n"
+    "L0:\n"
+    "t0 = f *. 0.5\n"
+    "t1 = t0 +. 1.0\n"
+    "f = t1\n"
+    "t2 = s * 3\n"
+    "t3 = t2 + n\n"
+    "t4 = t3 % 1000\n"
+    "t5 = n % 7\n"
+    "t6 = t4 - t5\n"
+    "s = t6\n"
+    "t7 = n + 1\n"
+    "n = t7\n"
+    "if n < count goto L0\n"
+    "L1:\n"
+    "ifFalse f >. 1.5 goto L2\n"
+    "t8 = s + 1\n"
+    "s = t8\n"
+    "goto L3\n"
+    "L2:\n"
+    "L3:\n"
+    "return s\n"
+    "endfunc\n"
+    "\n"
+    "func main:\n"
+    "param limit\n"
+    "t9 = call mix, 1\n"
+    "return t9\n"
+    "endfunc\n";
+
+//--------------------------------------------------- Helpers
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run a command; returns its exit status, or -1 if it did not exit normally.
+// With a marker, *result is parsed from the matching output line.
+static int bench_command(const char *cmd, const char *marker, double *result) {
+    FILE *p = popen(cmd, "r");
+    if (!p) {
+        perror("Error running command");
+        exit(EXIT_FAILURE);
+    }
+    char line[TAC_MAX_LINE_LEN];
+    size_t n = marker ? strlen(marker) : 0;
+    while (fgets(line, sizeof(line), p))
+        if (marker && strncmp(line, marker, n) == 0) *result = strtod(line + n, NULL);
+    int status = pclose(p);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+//--------------------------------------------------- Benchmark
+static int bench_file(const char *file) {
+    TacProgram prog = { 0 };
+    tac_load(&prog, file);
+    const TacFunc *main_fn = tac_find_func(&prog, "main");
+    if (!main_fn) {
+        fprintf(stderr, "Error: %s has no function 'main'\n", file);
+        return EXIT_FAILURE;
+    }
+    TacValue *env = tac_env_new(&prog);
+    TacRunStats st = { 0 };
+    double t0 = now_sec();
+    TacValue ref = tac_run(&prog, main_fn, env, &st);
+    double interp = now_sec() - t0;
+    long want = ref.is_float ? (long)ref.f : ref.i;
+    free(env);
+    printf("%-16s %-8s %10s %10.3f   %ld\n", file, "interp", "-", interp * 1e3, want);
+
+    int failed = 0;
+    char cmd[2 * TAC_MAX_LINE_LEN];
+    for (int b = 0; b < (int)(sizeof(backends) / sizeof(backends[0])); b++) {
+        const Backend *be = &backends[b];
+        double build = 0.0, run = 0.0, result = 0.0;
+        int status = 0;
+        for (int k = 0; k < BENCH_RUNS; k++) {
+            if (be->build) {
+                snprintf(cmd, sizeof(cmd), be->build, file);
+                t0 = now_sec();
+                if (bench_command(cmd, NULL, NULL) != 0) {
+                    fprintf(stderr, "Error: %s build failed: %s\n", be->name, cmd);
+                    return EXIT_FAILURE;
+                }
+                double s = now_sec() - t0;
+                if (k == 0 || s < build) build = s;
+            }
+            snprintf(cmd, sizeof(cmd), be->run, file);
+            t0 = now_sec();
+            status = bench_command(cmd, be->marker, &result);
+            double s = now_sec() - t0;
+            if (k == 0 || s < run) run = s;
+        }
+        int ok = be->marker ? status == 0 && (long)result == want : status == (int)(want & 0xff);
+        failed |= !ok;
+        if (be->build) printf("%-16s %-8s %10.3f %10.3f   %s\n", "", be->name, build * 1e3, run * 1e3, ok ? "ok" : "MISMATCH");
+        else           printf("%-16s %-8s %10s %10.3f   %s\n", "", be->name, "-", run * 1e3, ok ? "ok" : "MISMATCH");
+    }
+    return failed ? EXIT_FAILURE : 0;
+}
+
+// Optimize the mixed program into MIXED_FILE; returns 0 if phase 5 failed
+static int bench_mixed_prepare() {
+    FILE *out = fopen(MIXED_IN, "w");
+    if (!out) {
+        perror("Error opening " MIXED_IN " for write");
+        exit(EXIT_FAILURE);
+    }
+    fputs(mixed_program, out);
+    fclose(out);
+    if (bench_command(OPT_CMD " -o " MIXED_FILE " " MIXED_IN, NULL, NULL) != 0) {
+        fprintf(stderr, "Error: %s failed on %s\n", OPT_CMD, MIXED_IN);
+        return 0;
+    }
+    return 1;
+}
+
+//--------------------------------------------------- main
+int main(int argc, char **argv) {
+    static const char *outputs[] = { "bench_out.s", "bench_out.o", "bench_out.c", "bench_out_asm", "bench_out_elf", "bench_out_c",
+                                     MIXED_IN, MIXED_FILE };
+    const char *fallback = "tac_opt.txt";
+    const char **files = argc > 1 ? (const char **)argv + 1 : &fallback;
+    int nfiles = argc > 1 ? argc - 1 : 1, status = 0;
+    printf("%-16s %-8s %10s %10s   %s\n", "program", "backend", "build ms", "run ms", "result");
+    for (int i = 0; i < nfiles; i++) status |= bench_file(files[i]);
+    if (bench_mixed_prepare()) status |= bench_file(MIXED_FILE);
+    else                       status = EXIT_FAILURE;
+    for (int i = 0; i < (int)(sizeof(outputs) / sizeof(outputs[0])); i++) remove(outputs[i]);
+    return status;
+}
@@ -0,0 +1,111 @@
+// Scaling benchmark for the TAC analysis layer (CFG, dominators, liveness).
+// Build and run from the repository root:
+//     gcc -O2 -I. bench/bench_cfg.c -o bench_cfg && ./bench_cfg
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define NUM_VARS 48      // Source variables shared by all regions
+
+//--------------------------------------------------- Synthetic Functions
+static int bench_label_counter = 0;
+
+static int bench_label() {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "L%d", bench_label_counter++);
+    return tac_intern_label(buf);
+}
+
+static int bench_var(int i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "v%d", i % NUM_VARS);
+    return tac_intern(buf);
+}
+
+// A few statements in the shape phase 4 produces: "tN = a op b; v = tN"
+static void bench_statements(TacFunc *fn, int n, unsigned *seed) {
+    for (int k = 0; k < n; k++) {
+        *seed = *seed * 1103515245u + 12345u;
+        int t = tac_new_temp();
+        tac_emit(fn, tac_make(TAC_BINARY, OP_ADD, t, bench_var(*seed >> 8), bench_var(*seed >> 16), -1));
+        tac_emit(fn, tac_make(TAC_COPY, OP_NONE, bench_var(*seed >> 4), t, -1, -1));
+    }
+}
+
+// Alternate if/else diamonds and while loops, as gen_node() lowers them.
+// Temps stay inside their block, so the liveness universe is the variables.
+static void bench_build(TacFunc *fn, int target) {
+    unsigned seed = 1;
+    while (fn->count < target) {
+        int c = tac_new_temp();
+        seed = seed * 1103515245u + 12345u;
+        if ((fn->count / 8) % 2) {
+            int Lelse = bench_label(), Lend = bench_label();
+            tac_emit(fn, tac_make(TAC_BINARY, OP_LT, c, bench_var(seed >> 8), tac_intern("100"), -1));
+            tac_emit(fn, tac_make(TAC_IFFALSE, OP_NONE, -1, c, -1, Lelse));
+            bench_statements(fn, 3, &seed);
+            tac_emit(fn, tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, Lend));
+            tac_emit(fn, tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lelse));
+            bench_statements(fn, 2, &seed);
+            tac_emit(fn, tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lend));
+        } else {
+            int Lstart = bench_label(), Lend = bench_label();
+            tac_emit(fn, tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lstart));
+            tac_emit(fn, tac_make(TAC_BINARY, OP_LT, c, bench_var(seed >> 12), bench_var(seed >> 8), -1));
+            tac_emit(fn, tac_make(TAC_IFFALSE, OP_NONE, -1, c, -1, Lend));
+            bench_statements(fn, 4, &seed);
+            tac_emit(fn, tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, Lstart));
+            tac_emit(fn, tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lend));
+        }
+    }
+    tac_emit(fn, tac_make(TAC_RETURN, OP_NONE, -1, bench_var(0), -1, -1));
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------- main
+int main() {
+    static const int sizes[] = { 12500, 25000, 50000, 100000, 200000, 400000 };
+    printf("%10s %8s %8s %10s %10s %10s %10s\n",
+           "instrs", "blocks", "names", "cfg+dom ms", "live ms", "ns/instr", "cached ms");
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        TacFunc fn = { 0 };
+        fn.name = "bench";
+        bench_build(&fn, sizes[s]);
+
+        double t0 = now_sec();
+        TacCFG *cfg = tac_get_cfg(&fn);
+        double t1 = now_sec();
+        TacLiveness *lv = tac_get_liveness(&fn);
+        double t2 = now_sec();
+        // A second request without edits must hit the cache
+        if (tac_get_cfg(&fn) != cfg || tac_get_liveness(&fn) != lv) {
+            fprintf(stderr, "Error: analysis cache missed without an IR change\n");
+            return EXIT_FAILURE;
+        }
+        double t3 = now_sec();
+
+        printf("%10d %8d %8d %10.2f %10.2f %10.1f %10.4f\n",
+               fn.count, cfg->nblocks, lv->nnames, (t1 - t0) * 1e3, (t2 - t1) * 1e3,
+               (t2 - t0) * 1e9 / fn.count, (t3 - t2) * 1e3);
+
+        // An edit invalidates both analyses
+        tac_changed(&fn);
+        if (tac_get_cfg(&fn)->version != fn.version || tac_get_liveness(&fn)->version != fn.version) {
+            fprintf(stderr, "Error: stale analysis survived tac_changed()\n");
+            return EXIT_FAILURE;
+        }
+        tac_free_cfg(fn.cfg);
+        tac_free_liveness(fn.live);
+        free(fn.code);
+    }
+    return 0;
+}
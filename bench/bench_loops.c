@@ -0,0 +1,128 @@
+// Dynamic instruction counts for top-tested versus rotated loops, measured
+// with the reference TAC interpreter. Each kernel is written exactly as
+// phase 4 lowers it before and after loop rotation.
+// Build and run from the repository root:
+//     gcc -O2 -I. bench/bench_loops.c -o bench_loops && ./bench_loops
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Kernels
+typedef struct {
+    const char  *name;
+    const char **top;       // Lstart: cond; ifFalse goto Lend; body; goto Lstart
+    const char **rotated;   // ifFalse cond goto Lend; Lbody: body; if cond goto Lbody
+} Kernel;
+
+// for (i = 0; i < n; i = i + 1) sum = sum + i;
+static const char *for_top[] = {
+    "sum = 0", "i = 0",
+    "L0:", "ifFalse i < n goto L1",
+    "t0 = sum + i", "sum = t0", "t1 = i + 1", "i = t1",
+    "goto L0", "L1:", "return sum", NULL
+};
+static const char *for_rotated[] = {
+    "sum = 0", "i = 0",
+    "ifFalse i < n goto L1", "L0:",
+    "t0 = sum + i", "sum = t0", "t1 = i + 1", "i = t1",
+    "if i < n goto L0", "L1:", "return sum", NULL
+};
+
+// while (i >= 0) { if (i % 2 == 0) sum = sum + i; i = i - 1; }
+static const char *while_top[] = {
+    "sum = 0", "i = n",
+    "L0:", "ifFalse i >= 0 goto L1",
+    "t0 = i % 2", "ifFalse t0 == 0 goto L2", "t1 = sum + i", "sum = t1", "L2:",
+    "t2 = i - 1", "i = t2",
+    "goto L0", "L1:", "return sum", NULL
+};
+static const char *while_rotated[] = {
+    "sum = 0", "i = n",
+    "ifFalse i >= 0 goto L1", "L0:",
+    "t0 = i % 2", "ifFalse t0 == 0 goto L2", "t1 = sum + i", "sum = t1", "L2:",
+    "t2 = i - 1", "i = t2",
+    "if i >= 0 goto L0", "L1:", "return sum", NULL
+};
+
+// while (i < n && sum < 1000000000) { sum = sum + i; i = i + 1; }
+static const char *and_top[] = {
+    "sum = 0", "i = 0",
+    "L0:", "ifFalse i < n goto L1", "ifFalse sum < 1000000000 goto L1",
+    "t0 = sum + i", "sum = t0", "t1 = i + 1", "i = t1",
+    "goto L0", "L1:", "return sum", NULL
+};
+static const char *and_rotated[] = {
+    "sum = 0", "i = 0",
+    "ifFalse i < n goto L1", "ifFalse sum < 1000000000 goto L1", "L0:",
+    "t0 = sum + i", "sum = t0", "t1 = i + 1", "i = t1",
+    "ifFalse i < n goto L2", "if sum < 1000000000 goto L0", "L2:",
+    "L1:", "return sum", NULL
+};
+
+static const Kernel kernels[] = {
+    { "for",       for_top,   for_rotated   },
+    { "while-if",  while_top, while_rotated },
+    { "while-&&",  and_top,   and_rotated   },
+};
+
+//--------------------------------------------------- Helpers
+static TacFunc bench_func(const char *name, const char **text) {
+    TacFunc fn = { 0 };
+    fn.name = (char *)name;
+    for (int i = 0; text[i]; i++) {
+        char buf[TAC_MAX_LINE_LEN];
+        snprintf(buf, sizeof(buf), "%s", text[i]);
+        tac_parse_instr(&fn, buf, i + 1);
+    }
+    return fn;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static TacValue bench_run(const TacFunc *fn, long n, TacRunStats *st, double *sec) {
+    TacValue *env = tac_env_new(NULL);
+    env[tac_intern("n")] = tac_int_value(n);
+    memset(st, 0, sizeof(*st));
+    double t0 = now_sec();
+    TacValue r = tac_run(NULL, fn, env, st);
+    *sec = now_sec() - t0;
+    free(env);
+    return r;
+}
+
+//--------------------------------------------------- main
+int main() {
+    static const long trips[] = { 0, 1, 10, 1000, 1000000 };
+    printf("%-10s %8s %12s %12s %8s %10s %10s %10s\n",
+           "kernel", "n", "top instrs", "rot instrs", "saved", "top jumps", "rot jumps", "rot ns/in");
+    for (int k = 0; k < (int)(sizeof(kernels) / sizeof(kernels[0])); k++) {
+        TacFunc top = bench_func(kernels[k].name, kernels[k].top);
+        TacFunc rot = bench_func(kernels[k].name, kernels[k].rotated);
+        tac_intern("n");
+        for (int t = 0; t < (int)(sizeof(trips) / sizeof(trips[0])); t++) {
+            TacRunStats st_top, st_rot;
+            double s_top, s_rot;
+            TacValue a = bench_run(&top, trips[t], &st_top, &s_top);
+            TacValue b = bench_run(&rot, trips[t], &st_rot, &s_rot);
+            if (a.is_float != b.is_float || a.i != b.i) {
+                fprintf(stderr, "Error: %s with n = %ld returned %ld top-tested but %ld rotated\n",
+                        kernels[k].name, trips[t], a.i, b.i);
+                return EXIT_FAILURE;
+            }
+            printf("%-10s %8ld %12ld %12ld %7.1f%% %10ld %10ld %10.2f\n",
+                   kernels[k].name, trips[t], st_top.executed, st_rot.executed,
+                   100.0 * (st_top.executed - st_rot.executed) / st_top.executed,
+                   st_top.jumps, st_rot.jumps, s_rot * 1e9 / st_rot.executed);
+        }
+        free(top.code);
+        free(rot.code);
+    }
+    return 0;
+}
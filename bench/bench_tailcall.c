@@ -0,0 +1,168 @@
+// Deep recursion with and without tail-call elimination. A tail-recursive
+// sum is written as phase 4 lowers it; phase 5 then rewrites it, with the
+// call turned into parameter copies and a jump back to the entry. Both
+// forms run on the reference interpreter, where the recursive one stops at
+// TAC_MAX_CALL_DEPTH, and must agree wherever both finish. The recursive
+// form also runs natively through the x86-64 JIT, which lowers the tail
+// call to a jump: without that, a depth of a million needs some 48 MB of
+// machine stack.
+// Build phase 5 and the x86 backend and run from the repository root:
+//     gcc -O2 phase_5_optimizer.c -o phase_5_optimizer -lm
+//     gcc -O2 phase_7_x86_backend.c -o phase_7_x86_backend
+//     gcc -O2 -I. bench/bench_tailcall.c -o bench_tailcall && ./bench_tailcall
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define BENCH_FILE  "bench_tail.txt"
+#define OPT_FILE    "bench_tail_opt.txt"
+// Tail calls only: no register allocation or unrolling in the loop form
+#define OPT_CMD     "./phase_5_optimizer -regs=0 -unroll=0 -o " OPT_FILE " " BENCH_FILE
+#define OPT_RESULT  "[tail] %d self tail calls in %d"
+#define JIT_CMD     "./phase_7_x86_backend -jit " BENCH_FILE
+#define JIT_RESULT  "[jit] main returned "
+#define JIT_RUN     " run "
+
+//--------------------------------------------------- Program
+// sum(n, acc) = n == 0 ? acc : sum(n - 1, acc + n). The depth is a global
+// so that phase 5 cannot evaluate the call from main at compile time.
+static const char *program =
+    "global depth = %ld\n"
+    "func sum_rec(n, acc):\n"
+    "ifFalse n == 0 goto L0\n"
+    "return acc\n"
+    "L0:\n"
+    "t0 = n - 1\n"
+    "t1 = acc + n\n"
+    "param t0\n"
+    "param t1\n"
+    "t2 = call sum_rec, 2\n"
+    "return t2\n"
+    "endfunc\n"
+    "\n"
+    "func main:\n"
+    "param depth\n"
+    "param 0\n"
+    "t3 = call sum_rec, 2\n"
+    "return t3\n"
+    "endfunc\n";
+
+//--------------------------------------------------- Helpers
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Interpret fn(n, 0); returns 0 if it stopped on an error such as the call depth
+static int bench_interp(const TacProgram *prog, const char *name, long n, long *result, TacRunStats *st, double *sec) {
+    const TacFunc *fn = tac_find_func(prog, name);
+    TacValue *env = tac_env_new(prog);
+    env[fn->params[0]] = tac_int_value(n);
+    env[fn->params[1]] = tac_int_value(0);
+    memset(st, 0, sizeof(*st));
+    tac_trapping = 1;
+    tac_trap = NULL;
+    double t0 = now_sec();
+    TacValue r = tac_run(prog, fn, env, st);
+    *sec = now_sec() - t0;
+    tac_trapping = 0;
+    free(env);
+    *result = r.i;
+    return tac_trap == NULL;
+}
+
+// Run phase 5 on BENCH_FILE; returns the number of tail calls it turned
+// into jumps, or -1 if it failed
+static int bench_optimize() {
+    FILE *p = popen(OPT_CMD, "r");
+    if (!p) {
+        perror("Error running phase 5");
+        exit(EXIT_FAILURE);
+    }
+    char line[TAC_MAX_LINE_LEN];
+    int done = -1, sites, funcs;
+    while (fgets(line, sizeof(line), p))
+        if (sscanf(line, OPT_RESULT, &sites, &funcs) == 2) done = sites;
+    return pclose(p) == 0 ? done : -1;
+}
+
+// Does fn still call anything?
+static int bench_has_call(const TacFunc *fn) {
+    for (int i = 0; i < fn->count; i++)
+        if (fn->code[i].kind == TAC_CALL) return 1;
+    return 0;
+}
+
+// Run main natively; returns 0 if the JIT did not report a result
+static int bench_jit(long *result, double *run_ms) {
+    FILE *p = popen(JIT_CMD, "r");
+    if (!p) {
+        perror("Error running the x86 backend");
+        exit(EXIT_FAILURE);
+    }
+    char line[TAC_MAX_LINE_LEN];
+    int found = 0;
+    while (fgets(line, sizeof(line), p)) {
+        char *run = strstr(line, JIT_RUN);
+        if (strncmp(line, JIT_RESULT, strlen(JIT_RESULT)) == 0) {
+            *result = strtol(line + strlen(JIT_RESULT), NULL, 10);
+            found = 1;
+        } else if (run && strncmp(line, "[jit] ", 6) == 0) {
+            *run_ms = strtod(run + strlen(JIT_RUN), NULL);
+        }
+    }
+    pclose(p);
+    return found;
+}
+
+//--------------------------------------------------- main
+int main() {
+    static const long depths[] = { 1000, 10000, 100000, 1000000 };
+    printf("%9s %12s %10s %12s %10s %10s   %s\n",
+           "depth", "rec instrs", "rec ms", "loop instrs", "loop ms", "jit ms", "result");
+    int status = 0;
+    for (int d = 0; d < (int)(sizeof(depths) / sizeof(depths[0])); d++) {
+        long n = depths[d], want = n * (n + 1) / 2;
+        FILE *out = fopen(BENCH_FILE, "w");
+        if (!out) {
+            perror("Error opening " BENCH_FILE " for write");
+            return EXIT_FAILURE;
+        }
+        fprintf(out, program, n);
+        fclose(out);
+        if (bench_optimize() != 1) {
+            fprintf(stderr, "Error: phase 5 did not turn the tail call in sum_rec into a jump\n");
+            return EXIT_FAILURE;
+        }
+        TacProgram rec = { 0 }, opt = { 0 };
+        tac_load(&rec, BENCH_FILE);
+        tac_load(&opt, OPT_FILE);
+        if (!tac_find_func(&opt, "sum_rec") || bench_has_call(tac_find_func(&opt, "sum_rec"))) {
+            fprintf(stderr, "Error: " OPT_FILE " has no call-free sum_rec\n");
+            return EXIT_FAILURE;
+        }
+
+        TacRunStats st_rec, st_loop;
+        double s_rec, s_loop, jit_ms = 0.0;
+        long r_rec = 0, r_loop = 0, r_jit = 0;
+        int ok_rec  = bench_interp(&rec, "sum_rec", n, &r_rec, &st_rec, &s_rec);
+        int ok_loop = bench_interp(&opt, "sum_rec", n, &r_loop, &st_loop, &s_loop);
+        int ok_jit  = bench_jit(&r_jit, &jit_ms);
+        int ok = (!ok_rec || r_rec == r_loop) && ok_loop && r_loop == want && ok_jit && r_jit == want;
+        status |= !ok;
+
+        char rec_ms[32];
+        if (ok_rec) snprintf(rec_ms, sizeof(rec_ms), "%.3f", s_rec * 1e3);
+        else        snprintf(rec_ms, sizeof(rec_ms), "overflow");
+        printf("%9ld %12ld %10s %12ld %10.3f %10.3f   %s\n",
+               n, st_rec.executed, rec_ms, st_loop.executed, s_loop * 1e3, jit_ms, ok ? "ok" : "MISMATCH");
+    }
+    remove(BENCH_FILE);
+    remove(OPT_FILE);
+    return status ? EXIT_FAILURE : 0;
+}
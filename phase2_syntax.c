@@ -305,6 +305,7 @@ static ASTNode *parse_while_statement();
 static ASTNode *parse_for_statement();
 static ASTNode *parse_add_sub();
 static ASTNode *parse_block_statement();
+static ASTNode *parse_body_statement();
 static ASTNode *parse_assignment_inline();
 static ASTNode *parse_function_call();
 
@@ -590,6 +591,16 @@ static ASTNode *parse_block_statement() {
     return body_node;
 }
 
+// Body of an if, else, while or for: a single statement without braces is
+// wrapped in a Body node of its own, so later phases see the same shape
+static ASTNode *parse_body_statement() {
+    ASTNode *stmt = parse_statement();
+    if (stmt->kind == NODE_BODY) return stmt;
+    ASTNode *body_node = ast_new_node(NODE_BODY, "Body:");
+    node_list_append(&body_node->children, stmt);
+    return body_node;
+}
+
 
 // statement := assignment | return_stmt | if_stmt | while_stmt | for_stmt | block
 static ASTNode *parse_statement() {
@@ -701,23 +712,18 @@ static ASTNode *parse_if_statement() {
     ASTNode *if_node = ast_new_node(NODE_IF, "If:");
     node_list_append(&if_node->children, condition);
 
-    ASTNode *then_stmt = parse_statement();
+    ASTNode *then_stmt = parse_body_statement();
     node_list_append(&if_node->children, then_stmt);
 
     Token *t = peek_token();
     if (t && t->type == TOK_KEYWORD && strcmp(t->lexeme, "else") == 0) {
         advance_token(); // consume 'else'
 
-        Token *next = peek_token();
-        if (next && next->type == TOK_KEYWORD && strcmp(next->lexeme, "if") == 0) {
-            ASTNode *else_if_node = parse_statement();
-            node_list_append(&if_node->children, else_if_node);
-        } else {
-            ASTNode *else_body = parse_body();
-            ASTNode *else_node = ast_new_node(NODE_ELSE, "Else:");
-            node_list_append(&else_node->children, else_body);
-            node_list_append(&if_node->children, else_node);
-        }
+        // "else if" becomes an Else whose Body holds the inner If
+        ASTNode *else_body = parse_body_statement();
+        ASTNode *else_node = ast_new_node(NODE_ELSE, "Else:");
+        node_list_append(&else_node->children, else_body);
+        node_list_append(&if_node->children, else_node);
     }
 
 
@@ -733,7 +739,7 @@ static ASTNode *parse_while_statement() {
     ASTNode *while_node = ast_new_node(NODE_WHILE, "While:");
     node_list_append(&while_node->children, cond);
 
-    ASTNode *body = parse_statement();
+    ASTNode *body = parse_body_statement();
     node_list_append(&while_node->children, body);
 
     return while_node;
@@ -766,7 +772,7 @@ static ASTNode *parse_for_statement() {
     }
     expect_token(TOK_PUNCTUATION, ")");
 
-    ASTNode *body = parse_statement();
+    ASTNode *body = parse_body_statement();
     node_list_append(&for_node->children, body);
 
     return for_node;
@@ -12,6 +12,8 @@
 //--------------------------------------------------- Data Type
 typedef enum { TYPE_INT, TYPE_FLOAT, TYPE_BOOL, TYPE_VOID, TYPE_UNKNOWN } VarType; //Supported variable types
 
+static const char *type_names[] = { "int", "float", "bool", "void" };
+
 typedef struct {
     char    name[64];       //Symbol name
     VarType type;           //Symbol type
@@ -32,6 +34,7 @@ typedef struct {
 typedef struct {
     int   indent;           //Indentation level (in 4-space units)
     char  text[MAX_LINE_LEN];  //AST line text
+    VarType type;           //Type found for the node, TYPE_UNKNOWN if none
 } ASTLine;
 
 //--------------------------------------------------- Global Variables
@@ -41,6 +44,7 @@ static int       current_line = 0;   //Index of current AST line
 static Function  functions[MAX_FUNCS];
 static int       func_count    = 0;  //Parsed functions count
 static Function *current_function = NULL;  //Active function context
+static Scope     global_scope = { .count = 0 };  //Top-level variables
 
 //--------------------------------------------------- Utility Functions
 //Map type keyword string to VarType enum
@@ -87,6 +91,23 @@ static VarType lookup_symbol(Scope *scope, const char *name) {
     return TYPE_UNKNOWN;
 }
 
+//Lookup a variable: locals of the current function, then globals
+static VarType lookup_var(const char *name) {
+    VarType vt = current_function ? lookup_symbol(&current_function->scope, name) : TYPE_UNKNOWN;
+    return vt != TYPE_UNKNOWN ? vt : lookup_symbol(&global_scope, name);
+}
+
+//Can a value of type from be stored where type to is expected? Ints widen
+//to floats as in C; phase 4 inserts the conversion
+static int assignable(VarType to, VarType from) {
+    return to == from || (to == TYPE_FLOAT && from == TYPE_INT);
+}
+
+//A literal with a decimal point is a float
+static VarType literal_type(const char *s) {
+    return strchr(s, '.') ? TYPE_FLOAT : TYPE_INT;
+}
+
 //--------------------------------------------------- AST Loading
 //Load AST lines from file, set indent and strip newline
 static void load_ast(const char *filename) {
@@ -102,6 +123,7 @@ static void load_ast(const char *filename) {
         int indent = spaces / 4;
         buf[strcspn(buf, "\r\n")] = '\0';  //Remove newline
         lines[line_count].indent = indent;
+        lines[line_count].type   = TYPE_UNKNOWN;
         strncpy(lines[line_count].text, buf + spaces, MAX_LINE_LEN - 1);
         line_count++;
         if (line_count >= MAX_LINES) break;
@@ -109,6 +131,58 @@ static void load_ast(const char *filename) {
     fclose(fp);
 }
 
+//--------------------------------------------------- Dead Function Elimination
+//Only functions reachable from main through calls are checked and passed on
+//to code generation; the rest are cut from the AST here. A call is a line
+//whose text is a function's name, the same test phase 4 uses. A program
+//without main is left whole.
+static void remove_unreachable_functions(void) {
+    int  start[MAX_FUNCS], end[MAX_FUNCS], work[MAX_FUNCS];
+    char names[MAX_FUNCS][64], reached[MAX_FUNCS] = { 0 };
+    int  nfuncs = 0, root = -1;
+    for (int i = 0; i < line_count; i++) {
+        if (lines[i].indent != 0 || strncmp(lines[i].text, "FunctionDefinition:", 19) != 0) continue;
+        if (nfuncs >= MAX_FUNCS) semantic_error(i, "Too many functions");
+        sscanf(lines[i].text + 19, "%63s", names[nfuncs]);
+        if (strcmp(names[nfuncs], "main") == 0) root = nfuncs;
+        start[nfuncs] = i;
+        end[nfuncs] = i + 1;
+        while (end[nfuncs] < line_count && lines[end[nfuncs]].indent > 0) end[nfuncs]++;
+        nfuncs++;
+    }
+    if (root < 0) return;
+
+    int nwork = 0;
+    reached[root] = 1;
+    work[nwork++] = root;
+    while (nwork > 0) {
+        int f = work[--nwork];
+        for (int j = start[f] + 1; j < end[f]; j++)
+            for (int g = 0; g < nfuncs; g++)
+                if (!reached[g] && strcmp(lines[j].text, names[g]) == 0) {
+                    reached[g] = 1;
+                    work[nwork++] = g;
+                }
+    }
+
+    int removed = 0, dropped = 0, kept = 0, f = 0;
+    for (int i = 0; i < line_count; i++) {
+        while (f < nfuncs && end[f] <= i) f++;
+        if (f < nfuncs && i >= start[f] && !reached[f]) {
+            if (i == start[f]) {
+                printf("[dfe] %s: unreachable from main, %d AST lines removed\n", names[f], end[f] - start[f]);
+                dropped++;
+            }
+            removed++;
+            continue;
+        }
+        lines[kept++] = lines[i];
+    }
+    printf("[dfe] %d of %d functions unreachable from main, %d of %d AST lines removed\n",
+           dropped, nfuncs, removed, line_count);
+    line_count = kept;
+}
+
 //--------------------------------------------------- AST Parsing and Semantic Analysis
 //Parse AST node at expected indent level and check semantics
 static VarType parse_node(int expected_indent) {
@@ -137,6 +211,7 @@ static VarType parse_node(int expected_indent) {
 
         // Second child: Body
         parse_node(expected_indent + 1);
+        ln->type = fn->return_type;
         return TYPE_VOID;
     }
 
@@ -156,13 +231,17 @@ static VarType parse_node(int expected_indent) {
         if (current_function) {
             add_symbol(&current_function->scope, name, vt, current_line);
         } else {
-            static Scope global_scope = { .count = 0 };
             add_symbol(&global_scope, name, vt, current_line);
         }
 
         current_line++;
         if (lines[current_line].indent == expected_indent + 1) {
-            parse_node(expected_indent + 1);
+            VarType init = parse_node(expected_indent + 1);
+            if (!assignable(vt, init)) {
+                char buf[128];
+                snprintf(buf, sizeof(buf), "Type mismatch in initialization of '%s'", name);
+                semantic_error(current_line, buf);
+            }
         }
         return TYPE_VOID;
     }
@@ -172,15 +251,16 @@ static VarType parse_node(int expected_indent) {
         char name[64];
         sscanf(txt + 7, "%s", name);
         if (!current_function) semantic_error(0, "Assignment outside function");
-        VarType lhs = lookup_symbol(&current_function->scope, name);
+        VarType lhs = lookup_var(name);
         if (lhs == TYPE_UNKNOWN) {
             char buf[128];
             snprintf(buf, sizeof(buf), "Use of undeclared '%s'", name);
             semantic_error(0, buf);
         }
+        ln->type = lhs;
         current_line++;
         VarType rhs = parse_node(expected_indent + 1);
-        if (rhs != lhs) {
+        if (!assignable(lhs, rhs)) {
             char buf[128];
             snprintf(buf, sizeof(buf), "Type mismatch in assignment to '%s'", name);
             semantic_error(0, buf);
@@ -195,10 +275,13 @@ static VarType parse_node(int expected_indent) {
             semantic_error(current_line, "Condition of 'if' must be boolean");
         }
 
-        // then‐body
+        // then‐body; phase 2 wraps a single statement in a Body, and anything
+        // else here would never be consumed
         if (current_line < line_count && lines[current_line].indent == expected_indent + 1 &&
             strncmp(lines[current_line].text, "Body:", 5) == 0) {
             parse_node(expected_indent + 1);
+        } else {
+            semantic_error(current_line, "Branch of 'if' is not a Body");
         }
 
         if (current_line < line_count && lines[current_line].indent == expected_indent + 1 &&
@@ -207,6 +290,8 @@ static VarType parse_node(int expected_indent) {
             if (current_line < line_count && lines[current_line].indent == expected_indent + 2 &&
                 strncmp(lines[current_line].text, "Body:", 5) == 0) {
                 parse_node(expected_indent + 2);
+            } else {
+                semantic_error(current_line, "Branch of 'else' is not a Body");
             }
         }
 
@@ -228,18 +313,19 @@ static VarType parse_node(int expected_indent) {
         } else {
             char temp[64];
             sscanf(rest, "%s", temp);
-            if (isdigit(temp[0]))
-                rt = TYPE_INT;
+            if (isdigit((unsigned char)temp[0]) || temp[0] == '-' || temp[0] == '.')
+                rt = literal_type(temp);
             else
-                rt = lookup_symbol(&current_function->scope, temp);
+                rt = lookup_var(temp);
             current_line++;
         }
+        ln->type = rt;
 
         if (current_function->return_type == TYPE_INT && strcmp(current_function->name, "main") != 0) {
             current_function->return_type = rt;
         }
 
-        if (rt != current_function->return_type) {
+        if (!assignable(current_function->return_type, rt)) {
             semantic_error(current_line, "Return type mismatch");
         }
 
@@ -293,37 +379,44 @@ static VarType parse_node(int expected_indent) {
         sscanf(txt + 6, "%[^)]", op);
         current_line++;
         VarType left  = parse_node(expected_indent + 1);
+        if (strcmp(op, "!") == 0) return ln->type = TYPE_BOOL;     // Logical not has one operand
         VarType right = parse_node(expected_indent + 1);
 
-        if (left != right) semantic_error(current_line, "Type mismatch in binary operation");
+        // && and || take any scalar operands, as in C; an int meeting a
+        // float is converted, anything else must match
+        int logical = strcmp(op, "&&") == 0 || strcmp(op, "||") == 0;
+        VarType operands = assignable(left, right) ? left : assignable(right, left) ? right : TYPE_UNKNOWN;
+        if (operands == TYPE_UNKNOWN && !logical) semantic_error(current_line, "Type mismatch in binary operation");
 
         if (strcmp(op, "==") == 0 || strcmp(op, "!=") == 0 ||
             strcmp(op, "<") == 0  || strcmp(op, ">") == 0 ||
             strcmp(op, "<=") == 0 || strcmp(op, ">=") == 0 ||
             strcmp(op, "&&") == 0 || strcmp(op, "||") == 0) {
-            return TYPE_BOOL;
+            return ln->type = TYPE_BOOL;
         }
 
-        return left;
+        return ln->type = operands;
     }
 
 
     if (strncmp(txt, "Number(", 7) == 0) {
+        char val[64];
+        sscanf(txt + 7, "%63[^)]", val);
         current_line++;
-        return TYPE_INT;           //Integer literal
+        return ln->type = literal_type(val);
     }
 
     if (strncmp(txt, "Var(", 4) == 0) {
         char varname[64];
         sscanf(txt + 4, "%[^)]", varname);
-        VarType vt = lookup_symbol(&current_function->scope, varname);
+        VarType vt = lookup_var(varname);
         if (vt == TYPE_UNKNOWN) {
             char buf[128];
             snprintf(buf, sizeof(buf), "Use of undeclared '%s'", varname);
             semantic_error(0, buf);
         }
         current_line++;
-        return vt;
+        return ln->type = vt;
     }
     if (strncmp(txt, "Cast(", 5) == 0) {
         char typestr[16];
@@ -331,7 +424,7 @@ static VarType parse_node(int expected_indent) {
         VarType cast_type = string_to_type(typestr);
         current_line++;
         VarType inner = parse_node(expected_indent + 1);
-        return cast_type;
+        return ln->type = cast_type;
     }
     if (strncmp(txt, "Parameters:", 11) == 0) {
         current_line++;  // Skip "Parameters:"
@@ -403,7 +496,7 @@ static VarType parse_node(int expected_indent) {
                 parse_node(expected_indent + 1);
             }
 
-            return ret_type;
+            return ln->type = ret_type;
         }
     }
 
@@ -411,9 +504,28 @@ static VarType parse_node(int expected_indent) {
     return TYPE_UNKNOWN;
 }
 
+//--------------------------------------------------- Typed AST Output
+//Write the AST back with each node's type appended, "Var(x) [float]": the
+//value's type for expressions and Return, the variable's for Assign and
+//the return type for FunctionDefinition. Phase 4 generates code from it.
+static void write_typed_ast(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening ast_typed.txt for write");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < line_count; i++) {
+        fprintf(fp, "%*s%s", lines[i].indent * 4, "", lines[i].text);
+        if (lines[i].type < TYPE_UNKNOWN) fprintf(fp, " [%s]", type_names[lines[i].type]);
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+}
+
 //--------------------------------------------------- main
 int main() {
     load_ast("ast.txt");        //Load AST from file
+    remove_unreachable_functions();
     current_line = 0;
     while (current_line < line_count) {
         parse_node(0);
@@ -424,6 +536,7 @@ int main() {
             return EXIT_FAILURE;
         }
     }
+    write_typed_ast("ast_typed.txt");
     printf("Semantic Analysis: Successful\n");
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -1,23 +1,64 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+
+#include "tac_ir.h"
 
 //--------------------------------------------------- Defines
 #define MAX_LINES     2048      // Maximum number of AST lines
 #define MAX_LINE_LEN   512      // Maximum length of each AST line
+#define MAX_FUNCS       64      // Maximum number of function definitions
+#define MAX_PARAMS      16      // Maximum parameters per function
+#define MAX_INLINE_SIZE 12      // Largest callee body (AST lines) worth inlining
+#define INLINE_BUDGET   48      // AST lines each caller may grow by through inlining
+#define MAX_RENAMES    128      // Parameters and locals of one inlined callee
+#define HOT_CALLS     1000      // Profiled calls that double a callee's inlining limits
 
 //--------------------------------------------------- AST Line Structure
+// Phase 3 appends the type it found to each typed node: "Var(x) [float]"
+typedef enum { TYPE_INT, TYPE_FLOAT, TYPE_BOOL, TYPE_VOID, TYPE_UNKNOWN } VarType;
+
+static const char *type_names[] = { "int", "float", "bool", "void" };
+
 typedef struct {
-    int   indent;             // Indentation level (in 4-space units)
-    char  text[MAX_LINE_LEN]; // AST line text
+    int     indent;             // Indentation level (in 4-space units)
+    char    text[MAX_LINE_LEN]; // AST line text, without the type
+    VarType type;               // TYPE_UNKNOWN if the line has none
 } ASTLine;
 
+//--------------------------------------------------- Function Table
+typedef struct {
+    char name[64];
+    int  line;                      // FunctionDefinition line
+    int  end;                       // First line after the definition
+    int  body;                      // Body: line, -1 if none
+    char params[MAX_PARAMS][64];
+    VarType param_type[MAX_PARAMS];
+    int  nparams;
+    VarType ret_type;               // From phase 3
+    int  size;                      // AST lines in the body
+    int  leaf;                      // Body contains no calls
+    int  profiled;                  // Has an entry in the -profile file
+    unsigned prof_hash;             // ... for the TAC with this hash
+    long prof_calls;                // ... entered this many times
+    int  hot;                       // Profile matches what was generated and calls >= HOT_CALLS
+} FuncInfo;
+
 //--------------------------------------------------- Globals
 static ASTLine lines[MAX_LINES];
 static int     line_count = 0;
 static int     current_line = 0;
 static int     temp_counter = 0;
 static int     label_counter = 0;
+static FILE   *out;                // TAC output (tac.txt)
+static int     fused_branches = 0;  // Relations branched on without a temp
+static char    current_func[64];   // Function being generated, for reports
+static FuncInfo funcs[MAX_FUNCS];
+static int      func_count = 0;
+static int      caller = -1;        // Index of current_func in funcs
+static VarType  ret_type;           // Return type of the body being generated
+static int      conversions = 0;    // Implicit int -> float conversions
 
 //--------------------------------------------------- Utility: generate new temp and label
 static char *new_temp() {
@@ -33,10 +74,16 @@ static char *new_label() {
 }
 
 //--------------------------------------------------- Load AST
+static VarType string_to_type(const char *s) {
+    for (int t = TYPE_INT; t < TYPE_UNKNOWN; t++)
+        if (strcmp(s, type_names[t]) == 0) return (VarType)t;
+    return TYPE_UNKNOWN;
+}
+
 static void load_ast(const char *filename) {
     FILE *fp = fopen(filename, "r");
     if (!fp) {
-        perror("Error opening ast.txt");
+        perror("Error opening ast_typed.txt (run phase 3 first)");
         exit(EXIT_FAILURE);
     }
     char buf[MAX_LINE_LEN];
@@ -46,6 +93,14 @@ static void load_ast(const char *filename) {
         int indent = spaces / 4;
         buf[strcspn(buf, "\r\n")] = '\0';
         lines[line_count].indent = indent;
+        lines[line_count].type   = TYPE_UNKNOWN;
+        char *mark = strrchr(buf + spaces, '[');
+        size_t len = strlen(buf);
+        if (mark && mark > buf + spaces && mark[-1] == ' ' && buf[len - 1] == ']') {
+            buf[len - 1] = '\0';
+            lines[line_count].type = string_to_type(mark + 1);
+            mark[-1] = '\0';
+        }
         strncpy(lines[line_count].text, buf + spaces, MAX_LINE_LEN - 1);
         line_count++;
         if (line_count >= MAX_LINES) break;
@@ -53,10 +108,443 @@ static void load_ast(const char *filename) {
     fclose(fp);
 }
 
+//--------------------------------------------------- Types
+// Where an int meets a float (assignment, argument, return, the operands
+// of an arithmetic or relational operator) it is converted first, with
+// "t = (float)a", or by writing an int literal as a float one. Arithmetic
+// and relations on floats then use the float form of the operator,
+// "t = a *. b", and on ints the plain one, "t = a * b": every operator says
+// which machine operation it is, so later phases never have to guess.
+
+static int has_float_form(const char *op) {
+    static const char *ops[] = { "+", "-", "*", "/", "<", ">", "<=", ">=", "==", "!=" };
+    for (int k = 0; k < (int)(sizeof(ops) / sizeof(ops[0])); k++)
+        if (strcmp(op, ops[k]) == 0) return 1;
+    return 0;
+}
+
+// Type both operands of op are brought to before it is applied
+static VarType operand_type(const char *op, int l, int r) {
+    if (!has_float_form(op)) return TYPE_UNKNOWN;
+    return lines[l].type == TYPE_FLOAT || lines[r].type == TYPE_FLOAT ? TYPE_FLOAT : lines[l].type;
+}
+
+static const char *op_form(VarType operands) {
+    return operands == TYPE_FLOAT ? "." : "";
+}
+
+// Operand a of type from where type to is needed; frees a if it converts
+static char *gen_convert(char *a, VarType from, VarType to) {
+    if (!a || to != TYPE_FLOAT || (from != TYPE_INT && from != TYPE_BOOL)) return a;
+    conversions++;
+    if (isdigit((unsigned char)a[0]) || (a[0] == '-' && isdigit((unsigned char)a[1]))) {
+        char *lit = (char *)malloc(strlen(a) + 3);
+        sprintf(lit, "%s.0", a);
+        free(a);
+        return lit;
+    }
+    char *t = new_temp();
+    fprintf(out, "%s = (float)%s\n", t, a);
+    free(a);
+    return t;
+}
+
 //--------------------------------------------------- Code Generation
 // Returns operand name for use in expressions
 static char *gen_node(int indent);
 
+// Index of the first line after the subtree rooted at line i
+static int subtree_end(int i) {
+    int j = i + 1;
+    while (j < line_count && lines[j].indent > lines[i].indent) j++;
+    return j;
+}
+
+// A call is a line holding just the callee's name, with the arguments as children
+static int find_func(const char *name) {
+    for (int f = 0; f < func_count; f++)
+        if (strcmp(funcs[f].name, name) == 0) return f;
+    return -1;
+}
+
+static void scan_functions() {
+    for (int i = 0; i < line_count; i++) {
+        if (lines[i].indent != 0 || strncmp(lines[i].text, "FunctionDefinition:", 19) != 0) continue;
+        if (func_count >= MAX_FUNCS) {
+            fprintf(stderr, "Error: more than %d functions\n", MAX_FUNCS);
+            exit(EXIT_FAILURE);
+        }
+        FuncInfo *f = &funcs[func_count++];
+        sscanf(lines[i].text + 19, "%63s", f->name);
+        f->ret_type = lines[i].type;
+        f->line = i;
+        f->end  = subtree_end(i);
+        f->body = -1;
+        for (int j = i + 1; j < f->end; j = subtree_end(j)) {
+            char type[16], name[64];
+            if (strcmp(lines[j].text, "Body:") == 0) {
+                f->body = j;
+                f->size = subtree_end(j) - j - 1;
+            }
+            if (strcmp(lines[j].text, "Parameters:") != 0) continue;
+            for (int k = j + 1; k < subtree_end(j); k++)
+                if (sscanf(lines[k].text, "Param: %15s %63s", type, name) == 2 && f->nparams < MAX_PARAMS) {
+                    f->param_type[f->nparams] = string_to_type(type);
+                    snprintf(f->params[f->nparams++], 64, "%s", name);
+                }
+        }
+    }
+    for (int f = 0; f < func_count; f++) {
+        funcs[f].leaf = 1;
+        for (int j = funcs[f].line + 1; j < funcs[f].end; j++)
+            if (find_func(lines[j].text) >= 0) funcs[f].leaf = 0;
+    }
+}
+
+//--------------------------------------------------- Profile
+// With -profile=FILE (written by the VM running the previous tac.txt) a
+// callee that was called at least HOT_CALLS times may be inlined at twice
+// the usual size and budget. The profile names each function with a hash
+// of its TAC; a callee only counts as hot once its TAC has been written
+// here and hashes the same, so a changed body, or one that comes after the
+// caller, gets the usual limits. Both sides hash with tac_hash_text().
+
+// Entry counts come from each function's first block
+static void load_profile(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Error opening profile");
+        exit(EXIT_FAILURE);
+    }
+    char buf[MAX_LINE_LEN], name[64];
+    unsigned hash;
+    int nblocks, f = -1;
+    long count;
+    while (fgets(buf, sizeof(buf), fp)) {
+        if (sscanf(buf, "func %63s %x %d", name, &hash, &nblocks) == 3) {
+            f = find_func(name);
+            if (f < 0) continue;
+            funcs[f].profiled  = 1;
+            funcs[f].prof_hash = hash;
+        } else if (f >= 0 && sscanf(buf, "block 0 %ld", &count) == 1) {
+            funcs[f].prof_calls = count;
+        } else if (strncmp(buf, "endfunc", 7) == 0) {
+            f = -1;
+        }
+    }
+    fclose(fp);
+}
+
+// Function f was written to out from offset start on
+static void check_profile(int f, long start) {
+    if (!funcs[f].profiled) return;
+    long end = ftell(out);
+    char *text = (char *)malloc(end - start + 1);
+    fseek(out, start, SEEK_SET);
+    size_t n = fread(text, 1, end - start, out);
+    text[n] = '\0';
+    fseek(out, 0, SEEK_END);
+    if (tac_hash_text(text) != funcs[f].prof_hash) {
+        printf("[pgo] %s: stale profile ignored\n", funcs[f].name);
+    } else {
+        funcs[f].hot = funcs[f].prof_calls >= HOT_CALLS;
+        printf("[pgo] %s: %ld profiled calls%s\n", funcs[f].name, funcs[f].prof_calls,
+               funcs[f].hot ? ", inlining limits doubled" : "");
+    }
+    free(text);
+}
+
+//--------------------------------------------------- Inlining
+// Calls to small leaf functions are expanded in place from the callee's AST.
+// Parameters and locals get a per-site prefix ("inl3_a"), temps and labels
+// are fresh anyway, the arguments are copied into the renamed parameters and
+// each return becomes an assignment to the result temp plus a jump to the
+// continuation label. The cost is the callee's body size: at most
+// MAX_INLINE_SIZE lines, plus two per literal argument (those fold away
+// once constant propagation sees them), and no more than INLINE_BUDGET
+// lines per caller; both double for a callee the profile shows to be hot.
+// Leaves cannot recurse, so expansion always terminates.
+
+static int  inline_sites = 0, inline_calls = 0, inline_lines = 0;
+static int  inline_used = 0;        // Budget spent in the current caller
+static int  inline_active = 0;      // Generating an inlined body
+static int  inline_end;             // First line after the inlined body
+static int  inline_indent;          // Indent of the inlined body's statements
+static char inline_ret[32];         // Temp receiving the return value
+static char inline_cont[32];        // Continuation label
+static char inline_from[MAX_RENAMES][64], inline_to[MAX_RENAMES][80];
+static int  inline_nrenames = 0;
+
+// Name a variable has in the code being generated
+static const char *local_name(const char *name) {
+    for (int k = 0; inline_active && k < inline_nrenames; k++)
+        if (strcmp(inline_from[k], name) == 0) return inline_to[k];
+    return name;
+}
+
+static void inline_rename(const char *name, int site) {
+    for (int k = 0; k < inline_nrenames; k++)
+        if (strcmp(inline_from[k], name) == 0) return;
+    if (inline_nrenames >= MAX_RENAMES) {
+        fprintf(stderr, "Error: more than %d names in inlined function\n", MAX_RENAMES);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(inline_from[inline_nrenames], 64, "%s", name);
+    snprintf(inline_to[inline_nrenames], 80, "inl%d_%s", site, name);
+    inline_nrenames++;
+}
+
+// Does function f declare name as a parameter or local?
+static int func_declares(int f, const char *name) {
+    for (int j = funcs[f].line + 1; j < funcs[f].end; j++) {
+        char type[16], var[64];
+        if ((sscanf(lines[j].text, "Param: %15s %63s", type, var) == 2 ||
+             sscanf(lines[j].text, "VarDecl: %15s %63s", type, var) == 2) && strcmp(var, name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Reason not to inline callee f at the call on line call, NULL to go ahead
+static const char *inline_refusal(int f, int call) {
+    const FuncInfo *fi = &funcs[f];
+    int nargs = 0, literals = 0;
+    for (int j = call + 1; j < subtree_end(call); j = subtree_end(j)) {
+        nargs++;
+        if (strncmp(lines[j].text, "Number(", 7) == 0) literals++;
+    }
+    if (caller < 0 || fi->body < 0) return "no body";
+    if (!fi->leaf)                 return "not a leaf";
+    if (nargs != fi->nparams)      return "argument count";
+    int scale = fi->hot ? 2 : 1;
+    if (fi->size > scale * MAX_INLINE_SIZE + 2 * literals) return "too large";
+    if (inline_used + fi->size > scale * INLINE_BUDGET)    return "budget exhausted";
+    // A global the callee reads must not be shadowed by a local of the caller
+    for (int j = fi->body + 1; j < fi->end; j++) {
+        char name[64];
+        if (sscanf(lines[j].text, "Var(%63[^)]", name) != 1 &&
+            sscanf(lines[j].text, "Assign: %63s", name) != 1) continue;
+        if (!func_declares(f, name) && func_declares(caller, name)) return "name clash";
+    }
+    return NULL;
+}
+
+// Expand callee f with the given argument operands; returns the result temp
+static char *gen_inline(int f, char **args) {
+    const FuncInfo *fi = &funcs[f];
+    int site = inline_sites++;
+    inline_nrenames = 0;
+    for (int k = 0; k < fi->nparams; k++) inline_rename(fi->params[k], site);
+    for (int j = fi->body + 1; j < fi->end; j++) {
+        char type[16], name[64];
+        if (sscanf(lines[j].text, "VarDecl: %15s %63s", type, name) == 2) inline_rename(name, site);
+    }
+    inline_active = 1;
+    for (int k = 0; k < fi->nparams; k++)
+        fprintf(out, "%s = %s\n", local_name(fi->params[k]), args[k]);
+    char *t = new_temp(), *Lcont = new_label();
+    snprintf(inline_ret, sizeof(inline_ret), "%s", t);
+    snprintf(inline_cont, sizeof(inline_cont), "%s", Lcont);
+    inline_end    = fi->end;
+    inline_indent = lines[fi->body].indent + 1;
+    int resume = current_line;
+    VarType caller_ret = ret_type;
+    ret_type = fi->ret_type;
+    current_line = fi->body;
+    gen_node(lines[fi->body].indent);
+    current_line = resume;
+    ret_type = caller_ret;
+    fprintf(out, "%s:\n", Lcont);
+    inline_active = 0;
+    inline_used  += fi->size;
+    inline_lines += fi->size;
+    free(Lcont);
+    return t;
+}
+
+//--------------------------------------------------- Sethi-Ullman Ordering
+// Temps an expression needs at its peak (Sethi & Ullman). Variables and
+// numbers are used in place and need none; an operator holds the temp of the
+// operand it evaluated first while it evaluates the other, so starting with
+// the hungrier side lowers the peak. Operands are only reordered when both
+// are free of side effects (a call could write a global the other reads);
+// the instruction itself keeps its operand order.
+
+static int su_memo[2][MAX_LINES];   // Need per line: [0] left to right, [1] reordered
+static int su_pure_memo[MAX_LINES];
+static int su_depth = 0;            // Nesting of operand evaluation
+static int su_exprs = 0, su_swapped = 0, su_total = 0, su_total_ltr = 0;
+
+static int su_is_pure(int i) {
+    if (su_pure_memo[i] == 0) {
+        int pure = 1;
+        for (int j = i; j < subtree_end(i) && pure; j++)
+            if (strncmp(lines[j].text, "BinOp(", 6) != 0 && strncmp(lines[j].text, "Var(", 4) != 0 &&
+                strncmp(lines[j].text, "Number(", 7) != 0 && strncmp(lines[j].text, "Cast(", 5) != 0)
+                pure = 0;
+        su_pure_memo[i] = pure ? 1 : 2;
+    }
+    return su_pure_memo[i] == 1;
+}
+
+static int su_need(int i, int reorder);
+
+// Evaluate the right operand first? Only pays when the left one needs a temp.
+static int su_swap(int l, int r) {
+    int nl = su_need(l, 1);
+    return nl > 0 && su_need(r, 1) > nl && su_is_pure(l) && su_is_pure(r);
+}
+
+static int su_need(int i, int reorder) {
+    if (su_memo[reorder][i]) return su_memo[reorder][i] - 1;
+    const char *text = lines[i].text;
+    int end = subtree_end(i), need;
+    int child[2], nchild = 0, held = 0, peak = 0;
+    for (int j = i + 1; j < end; j = subtree_end(j)) {
+        if (nchild < 2) child[nchild] = j;
+        nchild++;
+    }
+    if (strncmp(text, "Var(", 4) == 0 || strncmp(text, "Number(", 7) == 0) {
+        need = 0;
+    } else if (nchild == 2 && strncmp(text, "BinOp(", 6) == 0 &&
+               strcmp(text, "BinOp(&&)") != 0 && strcmp(text, "BinOp(||)") != 0) {
+        int first = child[0], second = child[1];
+        if (reorder && su_swap(child[0], child[1])) { first = child[1]; second = child[0]; }
+        int n1 = su_need(first, reorder), n2 = su_need(second, reorder) + (n1 > 0);
+        need = n1 > n2 ? n1 : n2;
+        if (need < 1) need = 1;
+    } else if (strncmp(text, "Cast(", 5) == 0 && strcmp(text, "Cast(int)") != 0 &&
+               strcmp(text, "Cast(float)") != 0 && strcmp(text, "Cast(bool)") != 0) {
+        need = nchild ? su_need(i + 1, reorder) : 0;
+    } else {
+        // Anything else evaluates its operands left to right into one result
+        for (int j = i + 1; j < end; j = subtree_end(j)) {
+            int n = su_need(j, reorder);
+            if (held + n > peak) peak = held + n;
+            if (n > 0) held++;
+        }
+        need = peak > 1 ? peak : 1;
+    }
+    su_memo[reorder][i] = need + 1;
+    return need;
+}
+
+// Generate both operands of the operator whose line was just consumed,
+// hungrier side first, and return them in source order
+static void gen_operands(int indent, char **l, char **r) {
+    int op = current_line - 1, cl = current_line, cr = subtree_end(cl);
+    int swap = cr < line_count && lines[cr].indent == indent && su_swap(cl, cr);
+    if (su_depth == 0) {
+        int need = su_need(op, 1), ltr = su_need(op, 0);
+        su_exprs++;
+        su_total += need;
+        su_total_ltr += ltr;
+        if (ltr > 1)
+            printf("[su] %s: expression %s at AST line %d: peak temps %d (left to right %d)\n",
+                   current_func, lines[op].text, op + 1, need, ltr);
+    }
+    su_depth++;
+    if (swap) {
+        current_line = cr;
+        *r = gen_node(indent);
+        int end = current_line;
+        current_line = cl;
+        *l = gen_node(indent);
+        current_line = end;
+        su_swapped++;
+    } else {
+        *l = gen_node(indent);
+        *r = gen_node(indent);
+    }
+    su_depth--;
+}
+
+// Jump to label when the condition at current_line evaluates to sense and
+// fall through otherwise. && and || stop as soon as the left operand
+// decides the result, as in C.
+static void gen_branch(int indent, const char *label, int sense) {
+    ASTLine *ln = &lines[current_line];
+    int is_and = strcmp(ln->text, "BinOp(&&)") == 0;
+    int is_or  = strcmp(ln->text, "BinOp(||)") == 0;
+    if (is_and || is_or) {
+        current_line++;
+        if (is_and != sense) {
+            // false && ... / true || ...: either operand alone takes the jump
+            gen_branch(indent+1, label, sense);
+            gen_branch(indent+1, label, sense);
+        } else {
+            // the left operand can only rule the jump out
+            char *Lskip = new_label();
+            gen_branch(indent+1, Lskip, !sense);
+            gen_branch(indent+1, label, sense);
+            fprintf(out, "%s:\n", Lskip);
+            free(Lskip);
+        }
+        return;
+    }
+    // Logical not has a single operand: branch on it with the sense flipped
+    if (strcmp(ln->text, "BinOp(!)") == 0 && subtree_end(current_line+1) == subtree_end(current_line)) {
+        current_line++;
+        gen_branch(indent+1, label, !sense);
+        return;
+    }
+    // A relation feeding the branch is tested directly: "if a < b goto L"
+    char op[8];
+    if (sscanf(ln->text, "BinOp(%7[^)]", op) == 1 && strchr("<>=!", op[0]) && strcmp(op, "!") != 0) {
+        current_line++;
+        int cl = current_line, cr = subtree_end(cl);
+        VarType ty = operand_type(op, cl, cr);
+        char *l, *r;
+        gen_operands(indent+1, &l, &r);
+        l = gen_convert(l, lines[cl].type, ty);
+        r = gen_convert(r, lines[cr].type, ty);
+        fprintf(out, "%s %s %s%s %s goto %s\n", sense ? "if" : "ifFalse", l, op, op_form(ty), r, label);
+        free(l); free(r);
+        fused_branches++;
+        return;
+    }
+    char *cond = gen_node(indent);
+    fprintf(out, "%s %s goto %s\n", sense ? "if" : "ifFalse", cond, label);
+    free(cond);
+}
+
+// Value of the constant expression rooted at line i, as the program would
+// compute it; returns 0 if it reads a variable or calls a function
+static int fold_const(int i, TacValue *v) {
+    const char *text = lines[i].text;
+    int end = subtree_end(i), child[2], nchild = 0;
+    for (int j = i + 1; j < end; j = subtree_end(j)) {
+        if (nchild == 2) return 0;
+        child[nchild++] = j;
+    }
+    char name[16];
+    if (sscanf(text, "Number(%15[^)]", name) == 1) {
+        *v = tac_const_value(tac_intern(name));
+        return 1;
+    }
+    TacValue x, y = tac_int_value(0);
+    if (nchild == 0 || !fold_const(child[0], &x)) return 0;
+    if (sscanf(text, "Cast(%15[^)]", name) == 1) {
+        if (strcmp(name, "int") == 0)        *v = tac_eval("", OP_TOINT, x, y);
+        else if (strcmp(name, "float") == 0) *v = tac_eval("", OP_TOFLOAT, x, y);
+        else if (strcmp(name, "bool") == 0)  *v = tac_int_value(tac_value_true(x));
+        else                                 *v = x;
+        return 1;
+    }
+    if (sscanf(text, "BinOp(%15[^)]", name) != 1) return 0;
+    TacOp op = tac_parse_op(name, nchild == 1);
+    if (op == OP_NONE || (nchild == 2 && !fold_const(child[1], &y))) return 0;
+    tac_trapping = 1;
+    tac_trap = NULL;
+    *v = tac_eval("", op, x, y);
+    tac_trapping = 0;
+    if (tac_trap) {
+        fprintf(stderr, "Error: %s in a global initializer at AST line %d\n", tac_trap, i + 1);
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
 static void gen_block(int indent) {
     while (current_line < line_count && lines[current_line].indent >= indent) {
         gen_node(indent);
@@ -71,15 +559,27 @@ static char *gen_node(int indent) {
     // FunctionDefinition: name
     if (strncmp(ln->text, "FunctionDefinition:", 19) == 0) {
         char name[64]; sscanf(ln->text + 19, "%s", name);
-        printf("func %s:\n", name);
+        snprintf(current_func, sizeof(current_func), "%s", name);
+        caller = find_func(name);
+        ret_type = caller >= 0 ? funcs[caller].ret_type : TYPE_UNKNOWN;
+        inline_used = 0;
+        long start = ftell(out);
+        fprintf(out, "func %s", name);
+        for (int k = 0; caller >= 0 && k < funcs[caller].nparams; k++)
+            fprintf(out, "%s%s", k ? ", " : "(", funcs[caller].params[k]);
+        fprintf(out, "%s:\n", caller >= 0 && funcs[caller].nparams > 0 ? ")" : "");
         current_line++;
         // skip parameters
-        if (current_line < line_count && lines[current_line].indent == indent+1)
-            gen_node(indent+1);
+        if (current_line < line_count && strncmp(lines[current_line].text, "Parameters:", 11) == 0) {
+            current_line++;
+            while (current_line < line_count && lines[current_line].indent > indent+1)
+                current_line++;
+        }
         // body
         if (current_line < line_count && strstr(lines[current_line].text, "Body:"))
-            gen_block(indent+1);
-        printf("endfunc\n\n");
+            gen_node(indent+1);
+        fprintf(out, "endfunc\n\n");
+        if (caller >= 0) check_profile(caller, start);
         return NULL;
     }
 
@@ -90,11 +590,54 @@ static char *gen_node(int indent) {
         return NULL;
     }
 
-    // VarDeclGroup: skip declarations
+    // VarDeclGroup at top level: declare globals. An initializer is folded
+    // to a literal; one that is not a constant expression is an error.
+    if (strncmp(ln->text, "VarDeclGroup:", 13) == 0 && indent == 0) {
+        current_line++;
+        while (current_line < line_count && lines[current_line].indent > indent) {
+            char type[16], name[64];
+            if (lines[current_line].indent == indent+1 &&
+                sscanf(lines[current_line].text, "VarDecl: %15s %63s", type, name) == 2) {
+                int e = current_line + 1;
+                TacValue val;
+                if (strstr(lines[current_line].text, " =") && e < line_count && lines[e].indent == indent+2) {
+                    if (!fold_const(e, &val)) {
+                        fprintf(stderr, "Error: initializer of global '%s' is not a constant expression\n", name);
+                        exit(EXIT_FAILURE);
+                    }
+                    char *v = gen_convert(strdup(SYM_NAME(tac_value_literal(val))), lines[e].type, string_to_type(type));
+                    fprintf(out, "global %s = %s\n", name, v);
+                    free(v);
+                } else if (string_to_type(type) == TYPE_FLOAT) {
+                    fprintf(out, "global %s = 0.0\n", name);
+                } else {
+                    fprintf(out, "global %s\n", name);
+                }
+            }
+            current_line++;
+        }
+        return NULL;
+    }
+
+    // VarDeclGroup: initialized declarations become assignments. Floats
+    // without one start at 0.0 rather than the int 0 of a fresh name.
     if (strncmp(ln->text, "VarDeclGroup:", 13) == 0) {
         current_line++;
-        while (current_line < line_count && lines[current_line].indent > indent)
+        while (current_line < line_count && lines[current_line].indent > indent) {
+            char type[16], name[64];
+            int is_decl  = lines[current_line].indent == indent+1 &&
+                           sscanf(lines[current_line].text, "VarDecl: %15s %63s", type, name) == 2;
+            int has_init = is_decl && strstr(lines[current_line].text, " =") != NULL;
             current_line++;
+            if (has_init) {
+                int e = current_line;
+                char *r = gen_convert(gen_node(indent+2), lines[e].type, string_to_type(type));
+                fprintf(out, "%s = %s\n", local_name(name), r);
+                free(r);
+            } else if (is_decl && string_to_type(type) == TYPE_FLOAT) {
+                fprintf(out, "%s = 0.0\n", local_name(name));
+            }
+        }
         return NULL;
     }
 
@@ -110,21 +653,31 @@ static char *gen_node(int indent) {
     if (strncmp(ln->text, "Assign:", 7) == 0) {
         char var[64]; sscanf(ln->text + 7, "%s", var);
         current_line++;
-        char *r = gen_node(indent+1);
-        printf("%s = %s\n", var, r);
+        int e = current_line;
+        char *r = gen_convert(gen_node(indent+1), lines[e].type, ln->type);
+        fprintf(out, "%s = %s\n", local_name(var), r);
         free(r);
         return NULL;
     }
 
-    // Return:
+    // Return: a Number or Var operand is printed inline ("Return: x")
     if (strncmp(ln->text, "Return", 6) == 0) {
+        char inline_val[64];
+        int  has_inline = sscanf(ln->text, "Return: %63s", inline_val) == 1;
         current_line++;
-        char *r = gen_node(indent+1);
-        if (r) {
-            printf("return %s\n", r);
+        char *r = has_inline ? strdup(local_name(inline_val)) : gen_node(indent+1);
+        r = gen_convert(r, ln->type, ret_type);
+        if (inline_active) {
+            // Inlined: deliver the value and leave, unless this is the last statement
+            if (r) fprintf(out, "%s = %s\n", inline_ret, r);
+            if (!(ln->indent == inline_indent && current_line >= inline_end))
+                fprintf(out, "goto %s\n", inline_cont);
+            free(r);
+        } else if (r) {
+            fprintf(out, "return %s\n", r);
             free(r);
         } else {
-            printf("return\n");
+            fprintf(out, "return\n");
         }
         return NULL;
     }
@@ -132,75 +685,107 @@ static char *gen_node(int indent) {
     // If:
     if (strncmp(ln->text, "If:", 3) == 0) {
         current_line++;
-        char *cond = gen_node(indent+1);
         char *Lelse = new_label();
         char *Lend  = new_label();
-        printf("ifFalse %s goto %s\n", cond, Lelse);
-        free(cond);
+        gen_branch(indent+1, Lelse, 0);
         // then
         if (current_line < line_count && strcmp(lines[current_line].text, "Body:") == 0)
-            gen_block(indent+1);
-        printf("goto %s\n", Lend);
-        printf("%s:\n", Lelse);
+            gen_node(indent+1);
+        fprintf(out, "goto %s\n", Lend);
+        fprintf(out, "%s:\n", Lelse);
         // else
         if (current_line < line_count && strncmp(lines[current_line].text, "Else:",5)==0) {
             current_line++;
             if (current_line < line_count && strcmp(lines[current_line].text, "Body:") == 0)
                 gen_block(indent+2);
         }
-        printf("%s:\n", Lend);
+        fprintf(out, "%s:\n", Lend);
         free(Lelse); free(Lend);
         return NULL;
     }
 
+    // Loops are rotated: the condition guards entry once, then is tested
+    // again at the bottom, so each iteration runs one backward branch.
+    //     ifFalse cond goto Lend; Lbody: body; if cond goto Lbody; Lend:
+
     // For:
     if (strncmp(ln->text, "For:", 4) == 0) {
         current_line++;
         // init
         gen_node(indent+1);
-        char *Lstart = new_label();
-        char *Lend   = new_label();
-        printf("%s:\n", Lstart);
-        // cond
-        char *cond = gen_node(indent+1);
-        printf("ifFalse %s goto %s\n", cond, Lend);
-        free(cond);
-        // body
+        char *Lbody = new_label();
+        char *Lend  = new_label();
+        int cond = current_line;
+        gen_branch(indent+1, Lend, 0);
+        fprintf(out, "%s:\n", Lbody);
+        // the increment precedes the body in the AST but runs after it
+        int inc = current_line;
+        current_line = subtree_end(inc);
         if (current_line < line_count && strcmp(lines[current_line].text, "Body:") == 0)
-            gen_block(indent+1);
-        // increment
+            gen_node(indent+1);
+        int after = current_line;
+        current_line = inc;
         gen_node(indent+1);
-        printf("goto %s\n", Lstart);
-        printf("%s:\n", Lend);
-        free(Lstart); free(Lend);
+        current_line = cond;
+        gen_branch(indent+1, Lbody, 1);
+        current_line = after;
+        fprintf(out, "%s:\n", Lend);
+        free(Lbody); free(Lend);
         return NULL;
     }
 
     // While:
     if (strncmp(ln->text, "While:", 6) == 0) {
         current_line++;
-        char *Lstart = new_label();
-        char *Lend   = new_label();
-        printf("%s:\n", Lstart);
-        char *cond = gen_node(indent+1);
-        printf("ifFalse %s goto %s\n", cond, Lend);
-        free(cond);
+        char *Lbody = new_label();
+        char *Lend  = new_label();
+        int cond = current_line;
+        gen_branch(indent+1, Lend, 0);
+        fprintf(out, "%s:\n", Lbody);
         if (current_line < line_count && strcmp(lines[current_line].text, "Body:")==0)
             gen_block(indent+1);
-        printf("goto %s\n", Lstart);
-        printf("%s:\n", Lend);
-        free(Lstart); free(Lend);
+        int after = current_line;
+        current_line = cond;
+        gen_branch(indent+1, Lbody, 1);
+        current_line = after;
+        fprintf(out, "%s:\n", Lend);
+        free(Lbody); free(Lend);
         return NULL;
     }
 
+    // BinOp(&&) / BinOp(||) as a value: branch, then materialize 1 or 0
+    if (strcmp(ln->text, "BinOp(&&)") == 0 || strcmp(ln->text, "BinOp(||)") == 0) {
+        char *t = new_temp();
+        char *Lfalse = new_label();
+        char *Lend   = new_label();
+        gen_branch(indent, Lfalse, 0);
+        fprintf(out, "%s = 1\n", t);
+        fprintf(out, "goto %s\n", Lend);
+        fprintf(out, "%s:\n", Lfalse);
+        fprintf(out, "%s = 0\n", t);
+        fprintf(out, "%s:\n", Lend);
+        free(Lfalse); free(Lend);
+        return t;
+    }
+
     // BinOp(op)
     if (strncmp(ln->text, "BinOp(", 6) == 0) {
         char op[8]; sscanf(ln->text + 6, "%[^)]", op);
         current_line++;
-        char *l = gen_node(indent+1);
-        char *r = gen_node(indent+1);
+        char *l, *r = NULL;
+        int cl = current_line, cr = subtree_end(cl);
+        VarType ty = TYPE_UNKNOWN;
+        if (cr < subtree_end(current_line - 1)) {
+            gen_operands(indent+1, &l, &r);
+            ty = operand_type(op, cl, cr);
+            l = gen_convert(l, lines[cl].type, ty);
+            r = gen_convert(r, lines[cr].type, ty);
+        } else {
+            l = gen_node(indent+1);
+        }
         char *t = new_temp();
-        printf("%s = %s %s %s\n", t, l, op, r);
+        if (r) fprintf(out, "%s = %s %s%s %s\n", t, l, op, op_form(ty), r);
+        else   fprintf(out, "%s = %s%s\n", t, op, l);       // unary: !a
         free(l); free(r);
         return t;
     }
@@ -216,13 +801,57 @@ static char *gen_node(int indent) {
     if (strncmp(ln->text, "Var(", 4) == 0) {
         char name[64]; sscanf(ln->text + 4, "%[^)]", name);
         current_line++;
-        return strdup(name);
+        return strdup(local_name(name));
     }
 
-    // Cast(type)
+    // Cast(type): "t = (int)a", "t = (float)a"; bools are 0/1, so "t = a != 0"
     if (strncmp(ln->text, "Cast(", 5) == 0) {
+        char type[16]; sscanf(ln->text + 5, "%15[^)]", type);
         current_line++;
-        return gen_node(indent+1);
+        char *a = gen_node(indent+1);
+        if (strcmp(type, "int") != 0 && strcmp(type, "float") != 0 && strcmp(type, "bool") != 0)
+            return a;
+        char *t = new_temp();
+        if (strcmp(type, "bool") == 0) fprintf(out, "%s = %s != 0\n", t, a);
+        else                           fprintf(out, "%s = (%s)%s\n", t, type, a);
+        free(a);
+        return t;
+    }
+
+    // Call: arguments left to right, then inline the callee or pass them
+    //     param a; param b; t = call f, 2
+    int f = find_func(ln->text);
+    if (f >= 0) {
+        int call = current_line, end = subtree_end(call), nargs = 0;
+        char *args[MAX_PARAMS];
+        const char *why = inline_active ? "inside inlined body" : inline_refusal(f, call);
+        current_line++;
+        while (current_line < end) {
+            int e = current_line;
+            char *a = gen_node(indent+1);
+            if (a && nargs < MAX_PARAMS) {
+                args[nargs] = gen_convert(a, lines[e].type, funcs[f].param_type[nargs]);
+                nargs++;
+            } else {
+                free(a);
+            }
+        }
+        inline_calls++;
+        char *t;
+        if (!why) {
+            t = gen_inline(f, args);
+            printf("[inline] %s: %s inlined at AST line %d (%d lines, budget %d left%s)\n",
+                   current_func, funcs[f].name, call + 1, funcs[f].size,
+                   (funcs[f].hot ? 2 : 1) * INLINE_BUDGET - inline_used, funcs[f].hot ? ", hot" : "");
+        } else {
+            for (int k = 0; k < nargs; k++) fprintf(out, "param %s\n", args[k]);
+            t = new_temp();
+            fprintf(out, "%s = call %s, %d\n", t, funcs[f].name, nargs);
+            printf("[inline] %s: call to %s at AST line %d kept (%s)\n",
+                   current_func, funcs[f].name, call + 1, why);
+        }
+        for (int k = 0; k < nargs; k++) free(args[k]);
+        return t;
     }
 
     // Default skip
@@ -231,11 +860,36 @@ static char *gen_node(int indent) {
 }
 
 //--------------------------------------------------- main
-int main() {
-    load_ast("ast.txt");
+int main(int argc, char **argv) {
+    const char *profile = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-profile=", 9) == 0) {
+            profile = argv[i] + 9;
+        } else {
+            fprintf(stderr, "Usage: %s [-profile=FILE]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    load_ast("ast_typed.txt");
+    scan_functions();
+    if (profile) load_profile(profile);
+    out = fopen("tac.txt", "w+");     // Read back to check profile hashes
+    if (!out) {
+        perror("Error opening tac.txt for write");
+        return EXIT_FAILURE;
+    }
     current_line = 0;
     while (current_line < line_count) {
         gen_node(0);
     }
+    fclose(out);
+    // Each fused branch replaces "t = a op b; ifFalse t goto L"
+    printf("[tac] %d compare-and-branch fusions: %d instructions and %d temps saved\n",
+           fused_branches, fused_branches, fused_branches);
+    printf("[su] %d expressions: %d operand pairs evaluated right first, peak temps summed %d (left to right %d)\n",
+           su_exprs, su_swapped, su_total, su_total_ltr);
+    printf("[inline] %d of %d call sites inlined, %d AST lines copied\n",
+           inline_sites, inline_calls, inline_lines);
+    printf("[types] %d int operands converted to float\n", conversions);
     return 0;
 }
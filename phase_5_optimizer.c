@@ -0,0 +1,2424 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define INPUT_FILE  "tac.txt"
+#define OUTPUT_FILE "tac_opt.txt"
+#define DEFAULT_REGS 8          // Register file size for linear scan (-regs=N)
+
+//--------------------------------------------------- Profile-Guided Layout
+// With -profile=FILE, block and edge counts the VM collected on this same
+// tac.txt, every function whose hash still matches is laid out before the
+// other passes run. A region its branch enters at most PGO_COLD_PERCENT of
+// the time, and that nothing else enters, moves behind the end of the
+// function, the branch inverted if the region was its fall-through: the hot
+// path falls through and cold code stops sharing its cache lines. A region
+// is the run of blocks the edge's target dominates, and must rejoin right
+// after where it stood. Branches inside loops stay put: the loop passes
+// that follow want each loop in one run of blocks, and unrolling a hot loop
+// gains more than moving its cold path. Loop counts are kept by header
+// label for unrolling.
+
+#define PGO_COLD_PERCENT 20     // An edge taken at most this often (of its block) leads to cold code
+#define PGO_MAX_UNROLL    8     // Largest unroll factor a profile can choose
+
+static long *pgo_trips;         // By loop header label: body executions, -1 if not profiled
+static long *pgo_entries;       // By loop header label: times the loop was entered
+static int   pgo_nsyms = 0;
+
+static void pgo_loop_counts(TacFunc *fn, const TacProfileFunc *pf) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLoopInfo *li  = tac_get_loops(fn);
+    for (int l = 0; l < li->nloops; l++) {
+        const TacLoop  *lp = &li->loops[l];
+        const TacBlock *hb = &cfg->blocks[lp->header];
+        if (hb->start >= fn->count || fn->code[hb->start].kind != TAC_LABEL) continue;
+        long entries = 0;
+        for (int k = 0; k < hb->npred; k++) {
+            int p = cfg->pred_list[hb->pred_start + k];
+            if (!tac_in_loop(li, l, p)) entries += tac_profile_edge(pf, p, lp->header);
+        }
+        pgo_trips[fn->code[hb->start].label]   = pf->count[lp->header];
+        pgo_entries[fn->code[hb->start].label] = entries;
+    }
+}
+
+// Factor the profile suggests for the loop at header, -1 if it has no say
+static int pgo_unroll_factor(int header, long *avg) {
+    if (header >= pgo_nsyms || pgo_trips[header] < 0) return -1;
+    *avg = pgo_entries[header] ? pgo_trips[header] / pgo_entries[header] : 0;
+    int factor = 1;
+    while (factor * 2 <= *avg && factor * 2 <= PGO_MAX_UNROLL) factor *= 2;
+    return factor;
+}
+
+static int pgo_falls_through(const TacFunc *fn, const TacBlock *bb) {
+    return bb->end == bb->start || !(fn->code[bb->end - 1].kind == TAC_GOTO || fn->code[bb->end - 1].kind == TAC_RETURN);
+}
+
+// Returns the number of instructions moved out of line
+static int pgo_layout(TacFunc *fn, const TacProfileFunc *pf, int *nregions) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLoopInfo *li  = tac_get_loops(fn);
+    int  nb = cfg->nblocks;
+    int *region_end = (int *)tac_xrealloc(NULL, sizeof(int) * nb);    // At a region's first block
+    int *label      = (int *)tac_xrealloc(NULL, sizeof(int) * nb);    // Label a block starts with, -1 if none
+    char *moved     = (char *)calloc(nb, 1);
+    char *invert    = (char *)calloc(nb, 1);
+    for (int b = 0; b < nb; b++) {
+        region_end[b] = -1;
+        label[b] = fn->code[cfg->blocks[b].start].kind == TAC_LABEL ? fn->code[cfg->blocks[b].start].label : -1;
+    }
+
+    // Outermost regions first: a branch inside a moved region stays as it is
+    *nregions = 0;
+    for (int b = 0; b < nb; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        if (moved[b] || bb->nsucc != 2 || pf->count[b] == 0 || li->loop_of[b] >= 0) continue;
+        for (int k = 0; k < 2; k++) {
+            int s = bb->succ[k], e = s + 1;
+            if (s <= b || cfg->blocks[s].npred != 1) continue;
+            if (tac_profile_edge(pf, b, s) * 100 > pf->count[b] * PGO_COLD_PERCENT) continue;
+            while (e < nb && tac_dominates(cfg, s, e)) e++;
+            // A moved fall-through leaves the branch falling into its target
+            if (e == nb || (k == 0 && e != bb->succ[1])) continue;
+            int clash = 0, size = 0;
+            for (int r = s; r < e; r++) {
+                clash |= moved[r];
+                for (int i = cfg->blocks[r].start; i < cfg->blocks[r].end; i++) size += fn->code[i].kind != TAC_LABEL;
+            }
+            if (clash || size == 0) continue;
+            for (int r = s; r < e; r++) moved[r] = 1;
+            region_end[s] = e;
+            invert[b] = k == 0;
+            (*nregions)++;
+            break;
+        }
+    }
+    if (*nregions == 0) {
+        free(region_end); free(label); free(moved); free(invert);
+        return 0;
+    }
+
+    // Jumps into a region and out of its end need labels
+    for (int s = 0; s < nb; s++) {
+        if (region_end[s] < 0) continue;
+        if (label[s] < 0) label[s] = tac_new_label();
+        int e = region_end[s];
+        if (pgo_falls_through(fn, &cfg->blocks[e - 1]) && label[e] < 0) label[e] = tac_new_label();
+    }
+
+    TacInstr *code = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * (fn->count + 3 * nb + 1));
+    int n = 0, outlined = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int b = 0; b < nb; b++) {
+            const TacBlock *bb = &cfg->blocks[b];
+            if (moved[b] != pass) continue;
+            if (label[b] >= 0 && fn->code[bb->start].kind != TAC_LABEL)
+                code[n++] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, label[b]);
+            for (int i = bb->start; i < bb->end; i++) code[n++] = fn->code[i];
+            if (invert[b]) {
+                code[n - 1].kind  = code[n - 1].kind == TAC_IF ? TAC_IFFALSE : TAC_IF;
+                code[n - 1].label = label[bb->succ[0]];
+            }
+            outlined += pass * (bb->end - bb->start);
+            // The end of a moved region jumps back to where it rejoins
+            if (pass == 1 && (b + 1 == nb || !moved[b + 1] || region_end[b + 1] >= 0) && pgo_falls_through(fn, bb))
+                code[n++] = tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, label[b + 1]);
+        }
+        // The hot part falling off the end returns, as it did before
+        if (pass == 0 && pgo_falls_through(fn, &cfg->blocks[nb - 1]))
+            code[n++] = tac_make(TAC_RETURN, OP_NONE, -1, -1, -1, -1);
+    }
+    free(fn->code);
+    fn->code = code;
+    fn->count = fn->capacity = n;
+    tac_changed(fn);
+    free(region_end); free(label); free(moved); free(invert);
+    return outlined;
+}
+
+static void pgo_apply(TacProgram *prog, const char *filename) {
+    TacProfile *prof = tac_read_profile(filename);
+    pgo_nsyms   = tac_sym_count;
+    pgo_trips   = (long *)tac_xrealloc(NULL, sizeof(long) * (pgo_nsyms + 1));
+    pgo_entries = (long *)tac_xrealloc(NULL, sizeof(long) * (pgo_nsyms + 1));
+    for (int s = 0; s < pgo_nsyms; s++) pgo_trips[s] = -1;
+    for (int f = 0; f < prog->count; f++) {
+        TacFunc *fn = &prog->funcs[f];
+        const TacProfileFunc *pf = tac_profile_find(prof, fn->name);
+        if (!pf || fn->count == 0) {
+            printf("[pgo] %s: not in profile\n", fn->name);
+            continue;
+        }
+        if (pf->hash != tac_func_hash(fn) || pf->nblocks != tac_get_cfg(fn)->nblocks) {
+            printf("[pgo] %s: stale profile ignored\n", fn->name);
+            continue;
+        }
+        pgo_loop_counts(fn, pf);
+        int nregions, outlined = pgo_layout(fn, pf, &nregions);
+        printf("[pgo] %s: entered %ld times, %d cold regions (%d instructions) moved out of line\n",
+               fn->name, pf->count[0], nregions, outlined);
+    }
+    tac_free_profile(prof);
+}
+
+//--------------------------------------------------- Tail Recursion Elimination
+// "t = call f, n; return t" inside f itself becomes a jump back to the
+// entry after copying the arguments into the parameters, so deep recursion
+// runs in one frame. The arguments go through fresh temps first, since one
+// may read a parameter that another overwrites (gcd(b, a % b)); copy
+// optimization removes the temps it can. Locals keep their value into the
+// next round instead of starting at 0, so a function that may read a local
+// before assigning it is left alone.
+
+static int tail_done = 0, tail_funcs = 0;
+
+// Is the call at i a self tail call with its n arguments in the params just before it?
+static int tail_self_call(const TacFunc *fn, int i) {
+    const TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_CALL || in->dst < 0 || strcmp(SYM_NAME(in->label), fn->name) != 0) return 0;
+    int n = (int)tac_const_int(in->b), j = i + 1;
+    if (n != fn->nparams || n > i) return 0;
+    for (int k = i - n; k < i; k++)
+        if (fn->code[k].kind != TAC_PARAM) return 0;
+    while (j < fn->count && fn->code[j].kind == TAC_LABEL) j++;
+    return j < fn->count && fn->code[j].kind == TAC_RETURN && fn->code[j].a == in->dst;
+}
+
+static int eliminate_tail_recursion(TacFunc *fn) {
+    int sites = 0;
+    for (int i = 0; i < fn->count; i++) sites += tail_self_call(fn, i);
+    if (sites == 0) return 0;
+
+    TacLiveness *lv = tac_get_liveness(fn);
+    for (int k = 0; k < lv->nnames; k++) {
+        int sym = lv->names[k], is_param = 0;
+        for (int p = 0; p < fn->nparams; p++) is_param |= fn->params[p] == sym;
+        if (!is_param && !IS_GLOBAL(sym) && tac_live_in(lv, 0, sym)) {
+            printf("[tail] %s: %d self tail calls kept ('%s' may be read before it is assigned)\n",
+                   fn->name, sites, SYM_NAME(sym));
+            return 0;
+        }
+    }
+
+    int n = fn->nparams, m = 0;
+    int entry = fn->count > 0 && fn->code[0].kind == TAC_LABEL ? fn->code[0].label : tac_new_label();
+    int *tmp = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    TacInstr *code = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * (fn->count + 1 + sites * (n + 1)));
+    if (fn->count == 0 || fn->code[0].kind != TAC_LABEL) code[m++] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, entry);
+    for (int i = 0; i < fn->count; i++) {
+        if (i + n < fn->count && tail_self_call(fn, i + n)) {
+            for (int k = 0; k < n; k++) {
+                tmp[k] = tac_new_temp();
+                code[m++] = tac_make(TAC_COPY, OP_NONE, tmp[k], fn->code[i + k].a, -1, -1);
+            }
+            for (int k = 0; k < n; k++) code[m++] = tac_make(TAC_COPY, OP_NONE, fn->params[k], tmp[k], -1, -1);
+            code[m++] = tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, entry);
+            i += n;             // The return after it is now unreachable
+            continue;
+        }
+        code[m++] = fn->code[i];
+    }
+    free(fn->code);
+    fn->code = code;
+    fn->count = fn->capacity = m;
+    tac_changed(fn);
+    free(tmp);
+    printf("[tail] %s: %d self tail calls turned into jumps to the entry\n", fn->name, sites);
+    tail_done += sites;
+    tail_funcs++;
+    return sites;
+}
+
+//--------------------------------------------------- Sparse Conditional Constant Propagation
+// Wegman & Zadeck over SSA form. Every SSA name starts at TOP (no value seen
+// yet) and can only go down to one constant and then to BOTTOM. CFG edges
+// become executable as branches are evaluated, so code behind a branch
+// that is constant never contributes to a phi. Names read before any
+// definition (parameters, globals) are BOTTOM from the start.
+
+enum { SCCP_TOP, SCCP_CONST, SCCP_BOTTOM };
+
+typedef struct {
+    int      state;
+    TacValue val;
+} SCCPCell;
+
+static SCCPCell *sccp_cell;
+static char     *sccp_edge;         // Executable flags, two slots per block
+static char     *sccp_block;        // Block has been visited
+static int      *sccp_flow;         // Edge worklist (block * 2 + succ slot)
+static int       sccp_nflow;
+static int      *sccp_ssa;          // Symbols whose cell went down
+static int       sccp_nssa, sccp_ssa_cap;
+
+static int sccp_same(TacValue x, TacValue y) {
+    return x.is_float == y.is_float && (x.is_float ? x.f == y.f : x.i == y.i);
+}
+
+static void sccp_lower(int sym, int state, TacValue val) {
+    SCCPCell *c = &sccp_cell[sym];
+    if (c->state == SCCP_BOTTOM || state == SCCP_TOP) return;
+    if (c->state == SCCP_CONST && state == SCCP_CONST && sccp_same(c->val, val)) return;
+    if (c->state == SCCP_CONST || state == SCCP_BOTTOM) {
+        c->state = SCCP_BOTTOM;
+    } else {
+        c->state = SCCP_CONST;
+        c->val   = val;
+    }
+    if (sccp_nssa >= sccp_ssa_cap) {
+        sccp_ssa_cap = sccp_ssa_cap ? sccp_ssa_cap * 2 : 256;
+        sccp_ssa = (int *)tac_xrealloc(sccp_ssa, sizeof(int) * sccp_ssa_cap);
+    }
+    sccp_ssa[sccp_nssa++] = sym;
+}
+
+static void sccp_mark_edge(int b, int k) {
+    if (sccp_edge[2 * b + k]) return;
+    sccp_edge[2 * b + k] = 1;
+    sccp_flow[sccp_nflow++] = 2 * b + k;
+}
+
+// Operation folded at compile time; BOTTOM where the program would trap
+static int sccp_fold(TacOp op, TacValue x, TacValue y, TacValue *r) {
+    int is_float = x.is_float || y.is_float;
+    if ((op == OP_DIV || op == OP_MOD) && (is_float ? (y.is_float ? y.f : y.i) == 0 : y.i == 0)) return 0;
+    if (is_float && (op == OP_MOD || op == OP_SHL || op == OP_SHR || op == OP_BAND)) return 0;
+    if ((op == OP_SHL || op == OP_SHR) && (y.i < 0 || y.i > 63)) return 0;
+    if (op == OP_TOINT && x.is_float && !(fabs(x.f) < 9e18)) return 0;
+    *r = tac_eval("", op, x, y);
+    return !r->is_float || isfinite(r->f);
+}
+
+// Cell state of an operand, constants included
+static int sccp_operand(int sym, TacValue *v) {
+    if (sym < 0) { *v = tac_int_value(0); return SCCP_CONST; }
+    *v = sccp_cell[sym].val;
+    return sccp_cell[sym].state;
+}
+
+static void sccp_visit(const TacFunc *fn, const TacCFG *cfg, int i) {
+    const TacInstr *in = &fn->code[i];
+    int b = cfg->block_of[i];
+    TacValue x, y, r;
+    if (in->kind == TAC_PHI) {
+        const TacBlock *bb = &cfg->blocks[b];
+        for (int j = 0; j < bb->npred; j++) {
+            int p = cfg->pred_list[bb->pred_start + j];
+            const TacBlock *pb = &cfg->blocks[p];
+            int live_edge = 0;
+            for (int k = 0; k < pb->nsucc; k++)
+                if (pb->succ[k] == b && sccp_edge[2 * p + k]) live_edge = 1;
+            if (!live_edge) continue;
+            int s = sccp_operand(TAC_PHI_ARG(fn, in, j), &x);
+            sccp_lower(in->dst, s, x);
+        }
+        return;
+    }
+    int sa = sccp_operand(in->a, &x), sb = sccp_operand(in->b, &y);
+    int state = sa > sb ? sa : sb;
+    if (tac_is_cond_branch(in)) {
+        const TacBlock *bb = &cfg->blocks[b];
+        if (state == SCCP_TOP) return;
+        if (state == SCCP_BOTTOM || bb->nsucc < 2) {
+            for (int k = 0; k < bb->nsucc; k++) sccp_mark_edge(b, k);
+            return;
+        }
+        int cond = tac_is_fused_branch(in) ? sccp_fold(in->op, x, y, &r) && tac_value_true(r) : tac_value_true(x);
+        sccp_mark_edge(b, cond == (in->kind == TAC_IF) ? 1 : 0);
+        return;
+    }
+    if (tac_def(in) < 0) return;
+    switch (in->kind) {
+        case TAC_COPY:
+            sccp_lower(in->dst, sa, x);
+            break;
+        case TAC_UNARY:
+        case TAC_BINARY:
+            if (state == SCCP_CONST && !sccp_fold(in->op, x, y, &r)) state = SCCP_BOTTOM;
+            sccp_lower(in->dst, state, r);
+            break;
+        default:
+            sccp_lower(in->dst, SCCP_BOTTOM, x);
+            break;
+    }
+}
+
+static void sccp(TacFunc *fn) {
+    tac_to_ssa(fn);
+    TacCFG *cfg = tac_get_cfg(fn);
+    int nb = cfg->nblocks, nsyms = tac_sym_count;
+
+    sccp_cell  = (SCCPCell *)tac_xrealloc(NULL, sizeof(SCCPCell) * nsyms);
+    sccp_edge  = (char *)calloc(2 * nb + 2, 1);
+    sccp_block = (char *)calloc(nb + 1, 1);
+    sccp_flow  = (int *)tac_xrealloc(NULL, sizeof(int) * (2 * nb + 2));
+    sccp_nflow = sccp_nssa = 0;
+    for (int x = 0; x < nsyms; x++) {
+        sccp_cell[x].val = tac_int_value(0);
+        if (IS_CONST(x)) {
+            sccp_cell[x].state = SCCP_CONST;
+            sccp_cell[x].val   = tac_const_value(x);
+        } else {
+            sccp_cell[x].state = tac_syms[x].ssa_base >= 0 ? SCCP_TOP : SCCP_BOTTOM;
+        }
+    }
+
+    // SSA def-use chains: instructions reading each symbol, phis included
+    int *use_start = (int *)calloc(nsyms + 1, sizeof(int));
+    int *use_list  = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < fn->count; i++) {
+            const TacInstr *in = &fn->code[i];
+            int u[4], nu = tac_uses(in, u);
+            for (int j = 0; j < nu; j++)
+                if (pass == 0) use_start[u[j] + 1]++; else use_list[use_start[u[j]]++] = i;
+            for (int j = 0; in->kind == TAC_PHI && j < in->b; j++) {
+                int s = TAC_PHI_ARG(fn, in, j);
+                if (pass == 0) use_start[s + 1]++; else use_list[use_start[s]++] = i;
+            }
+        }
+        if (pass == 0) {
+            for (int x = 0; x < nsyms; x++) use_start[x + 1] += use_start[x];
+            use_list = (int *)tac_xrealloc(NULL, sizeof(int) * (use_start[nsyms] + 1));
+        } else {
+            for (int x = nsyms; x > 0; x--) use_start[x] = use_start[x - 1];
+            use_start[0] = 0;
+        }
+    }
+
+    // Propagate until both worklists are empty
+    if (nb > 0) {
+        sccp_block[0] = 1;
+        const TacBlock *bb = &cfg->blocks[0];
+        for (int i = bb->start; i < bb->end; i++) sccp_visit(fn, cfg, i);
+        if (bb->end == bb->start || !tac_is_cond_branch(&fn->code[bb->end - 1]))
+            for (int k = 0; k < bb->nsucc; k++) sccp_mark_edge(0, k);
+    }
+    while (sccp_nflow > 0 || sccp_nssa > 0) {
+        while (sccp_nflow > 0) {
+            int e = sccp_flow[--sccp_nflow], s = cfg->blocks[e / 2].succ[e % 2];
+            const TacBlock *bb = &cfg->blocks[s];
+            if (sccp_block[s]) {            // Only the phis see the new edge
+                for (int i = bb->start; i < bb->end; i++)
+                    if (fn->code[i].kind == TAC_PHI) sccp_visit(fn, cfg, i);
+                continue;
+            }
+            sccp_block[s] = 1;
+            for (int i = bb->start; i < bb->end; i++) sccp_visit(fn, cfg, i);
+            if (bb->end == bb->start || !tac_is_cond_branch(&fn->code[bb->end - 1]))
+                for (int k = 0; k < bb->nsucc; k++) sccp_mark_edge(s, k);
+        }
+        while (sccp_nssa > 0) {
+            int x = sccp_ssa[--sccp_nssa];
+            for (int j = use_start[x]; j < use_start[x + 1]; j++)
+                if (sccp_block[cfg->block_of[use_list[j]]]) sccp_visit(fn, cfg, use_list[j]);
+        }
+    }
+
+    // Rewrite: constants into their uses, folded branches, dead blocks out
+    int found = 0, replaced = 0, folded = 0, dead = 0;
+    for (int x = 0; x < nsyms; x++)
+        if (sccp_cell[x].state == SCCP_CONST && tac_syms[x].ssa_base >= 0) found++;
+    for (int b = 0; b < nb; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        if (!sccp_block[b]) {
+            for (int i = bb->start; i < bb->end; i++) fn->code[i].kind = TAC_NOP;
+            if (bb->end > bb->start) dead++;
+            continue;
+        }
+        for (int i = bb->start; i < bb->end; i++) {
+            TacInstr *in = &fn->code[i];
+            if (in->kind == TAC_PHI) {
+                int n = 0;
+                for (int j = 0; j < bb->npred; j++) {
+                    int p = cfg->pred_list[bb->pred_start + j], keep = 0;
+                    for (int k = 0; k < cfg->blocks[p].nsucc; k++)
+                        if (cfg->blocks[p].succ[k] == b && sccp_edge[2 * p + k]) keep = 1;
+                    if (!keep) continue;
+                    int s = TAC_PHI_ARG(fn, in, j);
+                    if (!IS_CONST(s) && sccp_cell[s].state == SCCP_CONST) {
+                        s = tac_value_literal(sccp_cell[s].val);
+                        replaced++;
+                    }
+                    fn->phi_args[in->a + n++] = s;
+                }
+                in->b = n;
+                if (sccp_cell[in->dst].state == SCCP_CONST) {
+                    *in = tac_make(TAC_COPY, OP_NONE, in->dst, tac_value_literal(sccp_cell[in->dst].val), -1, -1);
+                } else if (n == 1) {
+                    *in = tac_make(TAC_COPY, OP_NONE, in->dst, fn->phi_args[in->a], -1, -1);
+                }
+                continue;
+            }
+            int *ops[2] = { &in->a, &in->b };
+            for (int k = 0; k < 2; k++)
+                if (*ops[k] >= 0 && !IS_CONST(*ops[k]) && sccp_cell[*ops[k]].state == SCCP_CONST) {
+                    *ops[k] = tac_value_literal(sccp_cell[*ops[k]].val);
+                    replaced++;
+                }
+            if (tac_is_cond_branch(in) && bb->nsucc == 2 && sccp_edge[2 * b] != sccp_edge[2 * b + 1]) {
+                if (sccp_edge[2 * b + 1]) *in = tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, in->label);
+                else                      in->kind = TAC_NOP;
+                folded++;
+            } else if (tac_def(in) >= 0 && in->dst >= 0 && sccp_cell[in->dst].state == SCCP_CONST &&
+                       !(in->kind == TAC_COPY && IS_CONST(in->a))) {
+                *in = tac_make(TAC_COPY, OP_NONE, in->dst, tac_value_literal(sccp_cell[in->dst].val), -1, -1);
+            }
+        }
+    }
+    tac_compact(fn);
+    tac_from_ssa(fn);
+    printf("[sccp] %s: %d constants found, %d uses replaced, %d branches folded, %d unreachable blocks removed\n",
+           fn->name, found, replaced, folded, dead);
+
+    free(sccp_cell); free(sccp_edge); free(sccp_block); free(sccp_flow); free(sccp_ssa);
+    free(use_start); free(use_list);
+    sccp_ssa = NULL;
+    sccp_ssa_cap = 0;
+}
+
+//--------------------------------------------------- Compile-Time Evaluation of Pure Calls
+// A call to a pure function (see the call graph in tac_ir.h) with only
+// literal arguments is run on the reference interpreter and replaced by
+// its result, which SCCP then carries on with. A run is cut off after
+// FOLD_MAX_STEPS instructions or FOLD_MAX_DEPTH nested calls, and one that
+// fails that way, or with a runtime error, leaves the call for run time.
+
+#define FOLD_MAX_STEPS 100000   // Instructions one compile-time call may execute
+#define FOLD_MAX_DEPTH     64   // Calls it may nest
+
+static TacCallGraph *fold_graph;
+static int fold_sites = 0, fold_done = 0;
+
+static int fold_pure_calls(const TacProgram *prog, TacFunc *fn) {
+    int folded = 0;
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        if (in->kind != TAC_CALL) continue;
+        const TacFunc *callee = tac_find_func(prog, SYM_NAME(in->label));
+        int n = (int)tac_const_int(in->b), k = 0;
+        if (!callee || !fold_graph->pure[callee - prog->funcs] || n != callee->nparams || n > i) continue;
+        while (k < n && fn->code[i - n + k].kind == TAC_PARAM && IS_CONST(fn->code[i - n + k].a)) k++;
+        if (k < n) continue;
+
+        char args[TAC_MAX_LINE_LEN] = "";
+        size_t len = 0;
+        TacValue *env = tac_env_new(prog);
+        for (k = 0; k < n; k++) {
+            int a = fn->code[i - n + k].a;
+            env[callee->params[k]] = tac_const_value(a);
+            len += (size_t)snprintf(args + len, len < sizeof(args) ? sizeof(args) - len : 0, "%s%s", k ? ", " : "", SYM_NAME(a));
+        }
+        TacRunStats st = { 0 };
+        st.step_limit  = FOLD_MAX_STEPS;
+        st.depth_limit = FOLD_MAX_DEPTH;
+        tac_trapping = 1;
+        tac_trap = NULL;
+        TacValue r = tac_run(prog, callee, env, &st);
+        tac_trapping = 0;
+        free(env);
+        fold_sites++;
+        if (tac_trap) {
+            printf("[pure] %s: %s(%s) left for run time (%s)\n", fn->name, callee->name, args, tac_trap);
+            continue;
+        }
+        int lit = tac_value_literal(r);
+        printf("[pure] %s: %s(%s) = %s at compile time (%ld instructions)\n",
+               fn->name, callee->name, args, SYM_NAME(lit), st.executed);
+        for (k = 0; k < n; k++) fn->code[i - n + k].kind = TAC_NOP;
+        if (in->dst >= 0) *in = tac_make(TAC_COPY, OP_NONE, in->dst, lit, -1, -1);
+        else              in->kind = TAC_NOP;
+        folded++;
+    }
+    if (folded) tac_compact(fn);
+    fold_done += folded;
+    return folded;
+}
+
+//--------------------------------------------------- Value Numbering
+// Dominator-based value numbering (Briggs, Cooper & Simpson). Every symbol
+// carries the value number it currently holds; pure expressions are hashed on
+// (op, vn(a), vn(b)). The dominator tree is walked with a scoped expression
+// table and an undo log, so a block sees exactly the facts of its dominators.
+// Assigning a variable gives it a new value number, which invalidates every
+// expression that used the old one; a call may assign any global.
+
+typedef struct {
+    TacOp op;
+    int   vna, vnb;     // Operand value numbers (vnb = -1 for unary)
+    int   vn;           // Value number of the result
+    int   holder;       // Symbol that held the result when it was recorded
+    int   block;        // Block that computed it (local vs global hit)
+    int   next;         // Hash chain
+} VNEntry;
+
+typedef struct {
+    int sym;
+    int old_vn;
+} VNUndo;
+
+static int      *vn_of;          // Symbol -> current value number
+static VNEntry  *vn_entries;
+static int       vn_entry_count, vn_entry_cap;
+static int      *vn_buckets;     // Chain heads, -1 = empty
+static int       vn_nbuckets;
+static VNUndo   *vn_undo;
+static int       vn_undo_count, vn_undo_cap;
+static int       vn_next;        // Next fresh value number
+
+static unsigned vn_key_hash(TacOp op, int vna, int vnb) {
+    unsigned h = (unsigned)op * 31u + (unsigned)vna;
+    h = h * 2654435761u + (unsigned)vnb;
+    return (h ^ (h >> 15)) & (unsigned)(vn_nbuckets - 1);
+}
+
+static void vn_set(int sym, int vn) {
+    if (vn_undo_count >= vn_undo_cap) {
+        vn_undo_cap = vn_undo_cap ? vn_undo_cap * 2 : 1024;
+        vn_undo = (VNUndo *)tac_xrealloc(vn_undo, sizeof(VNUndo) * vn_undo_cap);
+    }
+    vn_undo[vn_undo_count].sym    = sym;
+    vn_undo[vn_undo_count].old_vn = vn_of[sym];
+    vn_undo_count++;
+    vn_of[sym] = vn;
+}
+
+static VNEntry *vn_lookup(TacOp op, int vna, int vnb) {
+    for (int e = vn_buckets[vn_key_hash(op, vna, vnb)]; e >= 0; e = vn_entries[e].next) {
+        VNEntry *en = &vn_entries[e];
+        if (en->op == op && en->vna == vna && en->vnb == vnb) return en;
+    }
+    return NULL;
+}
+
+static void vn_insert(TacOp op, int vna, int vnb, int vn, int holder, int block) {
+    if (vn_entry_count >= vn_entry_cap) {
+        vn_entry_cap = vn_entry_cap ? vn_entry_cap * 2 : 1024;
+        vn_entries = (VNEntry *)tac_xrealloc(vn_entries, sizeof(VNEntry) * vn_entry_cap);
+    }
+    unsigned h = vn_key_hash(op, vna, vnb);
+    VNEntry *en = &vn_entries[vn_entry_count];
+    en->op = op; en->vna = vna; en->vnb = vnb;
+    en->vn = vn; en->holder = holder; en->block = block;
+    en->next = vn_buckets[h];
+    vn_buckets[h] = vn_entry_count++;
+}
+
+// Pop scoped entries and undo value-number changes back to the given marks
+static void vn_restore(int entry_mark, int undo_mark) {
+    while (vn_entry_count > entry_mark) {
+        VNEntry *en = &vn_entries[--vn_entry_count];
+        vn_buckets[vn_key_hash(en->op, en->vna, en->vnb)] = en->next;
+    }
+    while (vn_undo_count > undo_mark) {
+        vn_undo_count--;
+        vn_of[vn_undo[vn_undo_count].sym] = vn_undo[vn_undo_count].old_vn;
+    }
+}
+
+static void vn_kill_globals() {
+    for (int s = 0; s < tac_sym_count; s++)
+        if (IS_GLOBAL(s)) vn_set(s, vn_next++);
+}
+
+// Symbols that may be redefined on a path from idom(b) to b: walk backwards
+// from b's predecessors and stop at the immediate dominator.
+static void vn_join_kills(const TacFunc *fn, const TacCFG *cfg, int b,
+                          int *mark, int stamp, int *work) {
+    int idom = cfg->blocks[b].idom;
+    int sp = 0;
+    for (int k = 0; k < cfg->blocks[b].npred; k++) {
+        int p = cfg->pred_list[cfg->blocks[b].pred_start + k];
+        if (p != idom && cfg->blocks[p].rpo >= 0 && mark[p] != stamp) {
+            mark[p] = stamp;
+            work[sp++] = p;
+        }
+    }
+    while (sp > 0) {
+        int x = work[--sp];
+        const TacBlock *bb = &cfg->blocks[x];
+        for (int i = bb->start; i < bb->end; i++) {
+            if (fn->code[i].kind == TAC_CALL) vn_kill_globals();
+            if (tac_def(&fn->code[i]) >= 0) vn_set(fn->code[i].dst, vn_next++);
+        }
+        for (int k = 0; k < bb->npred; k++) {
+            int p = cfg->pred_list[bb->pred_start + k];
+            if (p != idom && cfg->blocks[p].rpo >= 0 && mark[p] != stamp) {
+                mark[p] = stamp;
+                work[sp++] = p;
+            }
+        }
+    }
+}
+
+// Number one block, counting redundant computations as local or global hits
+static void vn_block(TacFunc *fn, const TacCFG *cfg, int b, const int *defs,
+                     int *subst, int *local, int *global) {
+    const TacBlock *bb = &cfg->blocks[b];
+    for (int i = bb->start; i < bb->end; i++) {
+        TacInstr *in = &fn->code[i];
+        if (in->kind == TAC_COPY) {
+            vn_set(in->dst, vn_of[in->a]);
+            continue;
+        }
+        if (!tac_is_pure(in)) {
+            if (in->kind == TAC_CALL) vn_kill_globals();
+            if (in->dst >= 0) vn_set(in->dst, vn_next++);
+            continue;
+        }
+        int vna = vn_of[in->a];
+        int vnb = in->b >= 0 ? vn_of[in->b] : -1;
+        if (tac_op_commutative(in->op) && vnb >= 0 && vnb < vna) {
+            int t = vna; vna = vnb; vnb = t;
+        }
+        VNEntry *en = vn_lookup(in->op, vna, vnb);
+        if (en && vn_of[en->holder] == en->vn) {
+            if (en->block == b) (*local)++;
+            else                (*global)++;
+            if (en->holder == in->dst) {        // Already holds the value
+                in->kind = TAC_NOP;
+                continue;
+            }
+            // Single-assignment temps can be forwarded outright; anything
+            // else keeps its definition as a copy of the earlier result.
+            if (IS_TEMP(in->dst) && defs[in->dst] == 1 && defs[en->holder] == 1) {
+                subst[in->dst] = en->holder;
+                in->kind = TAC_NOP;
+            } else {
+                *in = tac_make(TAC_COPY, OP_NONE, in->dst, en->holder, -1, -1);
+            }
+            vn_set(in->dst, en->vn);
+            continue;
+        }
+        int vn = vn_next++;
+        vn_set(in->dst, vn);
+        vn_insert(in->op, vna, vnb, vn, in->dst, b);
+    }
+}
+
+static int vn_resolve(int *subst, int s) {
+    while (s >= 0 && subst[s] >= 0) s = subst[s];
+    return s;
+}
+
+static void value_number(TacFunc *fn) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    int nsyms = tac_sym_count;
+
+    vn_of = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    int *defs  = (int *)calloc(nsyms, sizeof(int));
+    int *subst = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    for (int s = 0; s < nsyms; s++) {
+        vn_of[s] = s;               // Entry value of every symbol
+        subst[s] = -1;
+    }
+    vn_next = nsyms;
+    for (int i = 0; i < fn->count; i++)
+        if (tac_def(&fn->code[i]) >= 0) defs[fn->code[i].dst]++;
+
+    vn_nbuckets = 1024;
+    while (vn_nbuckets < fn->count * 2) vn_nbuckets *= 2;
+    vn_buckets = (int *)tac_xrealloc(NULL, sizeof(int) * vn_nbuckets);
+    for (int i = 0; i < vn_nbuckets; i++) vn_buckets[i] = -1;
+    vn_entry_count = vn_undo_count = 0;
+
+    // Iterative preorder walk of the dominator tree; each frame remembers
+    // the table marks to restore once its subtree is done.
+    int  n = cfg->nblocks;
+    int *stack      = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1) * 4);
+    int *mark       = (int *)calloc(n + 1, sizeof(int));
+    int *work       = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    int  sp = 0, stamp = 0, local = 0, global = 0;
+    if (cfg->nrpo > 0) {
+        stack[0] = 0; stack[1] = -1; stack[2] = 0; stack[3] = 0;
+        sp = 1;
+    }
+    while (sp > 0) {
+        int *fr = &stack[(sp - 1) * 4];   // block, next child, entry mark, undo mark
+        int b = fr[0];
+        if (fr[1] < 0) {
+            fr[2] = vn_entry_count;
+            fr[3] = vn_undo_count;
+            if (cfg->blocks[b].npred > 1 || (b == 0 && cfg->blocks[b].npred > 0))
+                vn_join_kills(fn, cfg, b, mark, ++stamp, work);
+            vn_block(fn, cfg, b, defs, subst, &local, &global);
+            fr[1] = cfg->dom_child_start[b];
+        }
+        if (fr[1] < cfg->dom_child_start[b + 1]) {
+            int c = cfg->dom_children[fr[1]++];
+            int *nf = &stack[sp * 4];
+            nf[0] = c; nf[1] = -1;
+            sp++;
+        } else {
+            vn_restore(fr[2], fr[3]);
+            sp--;
+        }
+    }
+
+    // Forward uses of deleted temps to the value that replaced them
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        if (in->a >= 0) in->a = vn_resolve(subst, in->a);
+        if (in->b >= 0) in->b = vn_resolve(subst, in->b);
+    }
+    tac_compact(fn);
+
+    printf("[vn] %s: %d redundant computations eliminated (%d local, %d global)\n",
+           fn->name, local + global, local, global);
+
+    free(stack); free(mark); free(work); free(defs); free(subst);
+    free(vn_of); free(vn_buckets);
+}
+
+//--------------------------------------------------- Copy Propagation and Coalescing
+// Phase 4 lowers every assignment as "tN = <expr>; var = tN". Coalescing
+// first makes the computation write the variable directly when the temp has
+// no other reader and the variable is untouched in between. Copy
+// propagation then forwards the remaining copies "x = y" into later reads
+// of x wherever the copy reaches on every path (available copies, a forward
+// dataflow over the CFG), and copies nobody reads any more are dropped.
+// Copies of globals are left alone: a call may change them.
+
+typedef struct {
+    int coalesced;      // Temps merged into the variable they were copied to
+    int propagated;     // Reads rewritten to the copy's source
+    int removed;        // Instructions deleted
+} CopyStats;
+
+// Most temps live at any one point of the function
+static int peak_live_temps(TacFunc *fn) {
+    TacLiveness *lv  = tac_get_liveness(fn);
+    TacCFG      *cfg = tac_get_cfg(fn);
+    char *live = (char *)calloc(tac_sym_count, 1);
+    int   peak = 0;
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        int n = 0;
+        for (int k = 0; k < lv->nnames; k++)
+            if (IS_TEMP(lv->names[k]) && BITSET_TEST(lv->out + (size_t)b * lv->words, k)) {
+                live[lv->names[k]] = 1;
+                n++;
+            }
+        if (n > peak) peak = n;
+        for (int i = bb->end - 1; i >= bb->start; i--) {
+            const TacInstr *in = &fn->code[i];
+            int d = tac_def(in);
+            if (IS_TEMP(d) && live[d]) { live[d] = 0; n--; }
+            int u[4], nu = tac_uses(in, u);
+            for (int j = 0; j < nu; j++)
+                if (IS_TEMP(u[j]) && !live[u[j]]) { live[u[j]] = 1; n++; }
+            if (n > peak) peak = n;
+        }
+        for (int i = bb->start; i < bb->end; i++) {
+            int u[4], nu = tac_uses(&fn->code[i], u);
+            for (int j = 0; j < nu; j++) live[u[j]] = 0;
+        }
+        for (int k = 0; k < lv->nnames; k++) live[lv->names[k]] = 0;
+    }
+    free(live);
+    return peak;
+}
+
+// "t = <expr> ... v = t"  =>  "v = <expr> ...", within a block
+static void copy_coalesce(TacFunc *fn, CopyStats *st) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    int  nsyms = tac_sym_count;
+    int *uses  = (int *)calloc(nsyms, sizeof(int));
+    int *defs  = (int *)calloc(nsyms, sizeof(int));
+    int *def_at = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    int *touch = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);    // Last position reading or writing
+    memset(touch, 0xff, sizeof(int) * nsyms);   // Positions in earlier blocks are below any def_at here
+    for (int i = 0; i < fn->count; i++) {
+        int u[4], nu = tac_uses(&fn->code[i], u), d = tac_def(&fn->code[i]);
+        for (int j = 0; j < nu; j++) uses[u[j]]++;
+        if (d >= 0) { defs[d]++; def_at[d] = i; }
+    }
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        for (int i = bb->start; i < bb->end; i++) {
+            TacInstr *in = &fn->code[i];
+            int t = in->a, v = in->dst;
+            if (in->kind == TAC_COPY && IS_TEMP(t) && !IS_GLOBAL(v) && v != t &&
+                uses[t] == 1 && defs[t] == 1 && def_at[t] >= bb->start && def_at[t] < i &&
+                touch[v] <= def_at[t] && (fn->code[def_at[t]].kind == TAC_COPY || tac_is_pure(&fn->code[def_at[t]]))) {
+                fn->code[def_at[t]].dst = v;
+                in->kind = TAC_NOP;
+                uses[t] = defs[t] = 0;
+                touch[v] = def_at[v] = def_at[t];
+                st->coalesced++;
+                st->removed++;
+                continue;
+            }
+            int u[4], nu = tac_uses(in, u), d = tac_def(in);
+            for (int j = 0; j < nu; j++) touch[u[j]] = i;
+            if (d >= 0) touch[d] = i;
+        }
+    }
+    free(uses); free(defs); free(def_at); free(touch);
+    tac_compact(fn);
+}
+
+static int copy_candidate(const TacInstr *in) {
+    return in->kind == TAC_COPY && in->dst != in->a && !IS_GLOBAL(in->dst) && !IS_GLOBAL(in->a);
+}
+
+static void copy_propagate(TacFunc *fn, CopyStats *st) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    int nb = cfg->nblocks, nsyms = tac_sym_count;
+
+    // The copies, and for each symbol the copies that mention it (CSR)
+    int *copy_at = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    int  ncopies = 0;
+    for (int i = 0; i < fn->count; i++)
+        if (copy_candidate(&fn->code[i])) copy_at[ncopies++] = i;
+    int *men_start = (int *)calloc(nsyms + 1, sizeof(int));
+    int *men_list  = (int *)tac_xrealloc(NULL, sizeof(int) * (2 * ncopies + 1));
+    for (int c = 0; c < ncopies; c++) {
+        men_start[fn->code[copy_at[c]].dst + 1]++;
+        men_start[fn->code[copy_at[c]].a + 1]++;
+    }
+    for (int s = 0; s < nsyms; s++) men_start[s + 1] += men_start[s];
+    for (int c = 0; c < ncopies; c++) {
+        men_list[men_start[fn->code[copy_at[c]].dst]++] = c;
+        men_list[men_start[fn->code[copy_at[c]].a]++]   = c;
+    }
+    for (int s = nsyms; s > 0; s--) men_start[s] = men_start[s - 1];
+    men_start[0] = 0;
+
+    // Per block: copies generated (and not killed after), and copies killed
+    int words = (ncopies + 63) / 64 + 1;
+    uint64_t *gen  = (uint64_t *)calloc((size_t)nb * words, sizeof(uint64_t));
+    uint64_t *kill = (uint64_t *)calloc((size_t)nb * words, sizeof(uint64_t));
+    uint64_t *in   = (uint64_t *)calloc((size_t)nb * words, sizeof(uint64_t));
+    uint64_t *out  = (uint64_t *)tac_xrealloc(NULL, sizeof(uint64_t) * (size_t)nb * words);
+    int *copy_of = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    for (int i = 0; i < fn->count; i++) copy_of[i] = -1;
+    for (int c = 0; c < ncopies; c++) copy_of[copy_at[c]] = c;
+    for (int b = 0; b < nb; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        uint64_t *g = gen + (size_t)b * words, *k = kill + (size_t)b * words;
+        for (int i = bb->start; i < bb->end; i++) {
+            int d = tac_def(&fn->code[i]);
+            if (d >= 0)
+                for (int j = men_start[d]; j < men_start[d + 1]; j++) {
+                    BITSET_SET(k, men_list[j]);
+                    BITSET_CLEAR(g, men_list[j]);
+                }
+            if (copy_of[i] >= 0) {
+                BITSET_SET(g, copy_of[i]);
+                BITSET_CLEAR(k, copy_of[i]);
+            }
+        }
+    }
+    for (size_t w = 0; w < (size_t)nb * words; w++) out[w] = ~(uint64_t)0;
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int r = 0; r < cfg->nrpo; r++) {
+            int b = cfg->rpo_order[r];
+            const TacBlock *bb = &cfg->blocks[b];
+            uint64_t *bi = in + (size_t)b * words, *bo = out + (size_t)b * words;
+            for (int w = 0; w < words; w++) bi[w] = bb->npred > 0 && b != 0 ? ~(uint64_t)0 : 0;
+            for (int j = 0; j < bb->npred; j++) {
+                const uint64_t *po = out + (size_t)cfg->pred_list[bb->pred_start + j] * words;
+                for (int w = 0; w < words; w++) bi[w] &= po[w];
+            }
+            for (int w = 0; w < words; w++) {
+                uint64_t o = gen[(size_t)b * words + w] | (bi[w] & ~kill[(size_t)b * words + w]);
+                if (o != bo[w]) { bo[w] = o; changed = 1; }
+            }
+        }
+    }
+
+    // Rewrite reads, tracking which copy currently defines each symbol
+    int *src = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    for (int s = 0; s < nsyms; s++) src[s] = -1;
+    for (int r = 0; r < cfg->nrpo; r++) {
+        int b = cfg->rpo_order[r];
+        const TacBlock *bb = &cfg->blocks[b];
+        const uint64_t *bi = in + (size_t)b * words;
+        for (int c = 0; c < ncopies; c++)
+            if (BITSET_TEST(bi, c)) src[fn->code[copy_at[c]].dst] = fn->code[copy_at[c]].a;
+        for (int i = bb->start; i < bb->end; i++) {
+            TacInstr *ins = &fn->code[i];
+            int *ops[2] = { &ins->a, &ins->b };
+            for (int k = 0; k < 2; k++)
+                if (*ops[k] >= 0 && *ops[k] < nsyms && src[*ops[k]] >= 0) {
+                    *ops[k] = src[*ops[k]];
+                    st->propagated++;
+                }
+            int d = tac_def(ins);
+            if (d >= 0) {
+                src[d] = -1;
+                for (int j = men_start[d]; j < men_start[d + 1]; j++) {
+                    const TacInstr *cp = &fn->code[copy_at[men_list[j]]];
+                    if (cp->a == d && src[cp->dst] == d) src[cp->dst] = -1;
+                }
+            }
+            if (copy_candidate(ins)) src[ins->dst] = ins->a;
+        }
+        for (int c = 0; c < ncopies; c++) src[fn->code[copy_at[c]].dst] = -1;
+    }
+    free(copy_at); free(men_start); free(men_list); free(gen); free(kill); free(in); free(out);
+    free(copy_of); free(src);
+    tac_changed(fn);
+
+    // Copies whose destination is no longer read
+    TacLiveness *lv = tac_get_liveness(fn);
+    cfg = tac_get_cfg(fn);
+    int *read_in = (int *)tac_xrealloc(NULL, sizeof(int) * tac_sym_count);
+    uint64_t *live = (uint64_t *)tac_xrealloc(NULL, sizeof(uint64_t) * (lv->words + 1));
+    memset(read_in, 0xff, sizeof(int) * tac_sym_count);
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        memcpy(live, lv->out + (size_t)b * lv->words, sizeof(uint64_t) * lv->words);
+        for (int i = bb->end - 1; i >= bb->start; i--) {
+            TacInstr *ins = &fn->code[i];
+            int d = tac_def(ins);
+            if (d >= 0) {
+                int k = tac_live_index(lv, d);
+                int is_live = IS_GLOBAL(d) || (k >= 0 ? BITSET_TEST(live, k) : read_in[d] == b);
+                if (!is_live && ins->kind == TAC_COPY) {
+                    ins->kind = TAC_NOP;
+                    st->removed++;
+                    continue;
+                }
+                if (k >= 0) BITSET_CLEAR(live, k);
+                else        read_in[d] = -1;
+            }
+            int u[4], nu = tac_uses(ins, u);
+            for (int j = 0; j < nu; j++) {
+                int k = tac_live_index(lv, u[j]);
+                if (k >= 0) BITSET_SET(live, k);
+                else        read_in[u[j]] = b;
+            }
+        }
+    }
+    free(read_in); free(live);
+    tac_compact(fn);
+}
+
+static void copy_optimize(TacFunc *fn) {
+    CopyStats st = { 0 };
+    int before = peak_live_temps(fn);
+    copy_coalesce(fn, &st);
+    copy_propagate(fn, &st);
+    int after = peak_live_temps(fn);
+    printf("[copy] %s: %d temps coalesced, %d reads forwarded, %d instructions removed, peak live temps %d -> %d\n",
+           fn->name, st.coalesced, st.propagated, st.removed, before, after);
+}
+
+//--------------------------------------------------- Dead Code Elimination
+// Cleanup after the other passes: drop blocks no path reaches (including
+// code after a return), thread jumps through jump-only blocks, delete jumps
+// to the next instruction and labels nobody targets, and remove assignments
+// whose value is never read. Repeats until nothing changes.
+
+typedef struct {
+    int unreachable;    // Blocks removed
+    int dead;           // Assignments removed
+    int jumps;          // Jumps to the fall-through label removed
+    int threaded;       // Jumps retargeted past a jump-only block
+    int labels;         // Unused labels removed
+} DCEStats;
+
+static int dce_unreachable(TacFunc *fn, DCEStats *st) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    int removed = 0;
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        if (bb->rpo >= 0 || bb->end == bb->start) continue;
+        for (int i = bb->start; i < bb->end; i++) fn->code[i].kind = TAC_NOP;
+        removed++;
+    }
+    if (removed) tac_compact(fn);
+    st->unreachable += removed;
+    return removed;
+}
+
+// Final destination of a jump to label: skip labels, follow unconditional gotos
+static int dce_final_target(const TacFunc *fn, const int *label_pos, int label) {
+    for (int hops = 0; hops < fn->count; hops++) {
+        int i = label_pos[label];
+        while (i < fn->count && fn->code[i].kind == TAC_LABEL) i++;
+        if (i >= fn->count || fn->code[i].kind != TAC_GOTO || fn->code[i].label == label) break;
+        label = fn->code[i].label;
+    }
+    return label;
+}
+
+static int dce_jumps(TacFunc *fn, DCEStats *st) {
+    int *label_pos = (int *)tac_xrealloc(NULL, sizeof(int) * tac_sym_count);
+    int *refs      = (int *)calloc(tac_sym_count, sizeof(int));
+    int  changed   = 0;
+    for (int i = 0; i < fn->count; i++)
+        if (fn->code[i].kind == TAC_LABEL) label_pos[fn->code[i].label] = i;
+
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        if (!tac_is_jump(in)) continue;
+        int target = dce_final_target(fn, label_pos, in->label);
+        if (target != in->label) {
+            in->label = target;
+            st->threaded++;
+            changed = 1;
+        }
+        // Jump to a label in the run of labels right after it
+        int j = i + 1;
+        while (j < fn->count && fn->code[j].kind == TAC_LABEL && fn->code[j].label != in->label) j++;
+        if (j < fn->count && fn->code[j].kind == TAC_LABEL) {
+            in->kind = TAC_NOP;
+            st->jumps++;
+            changed = 1;
+            continue;
+        }
+        refs[in->label]++;
+    }
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        if (in->kind == TAC_LABEL && refs[in->label] == 0) {
+            in->kind = TAC_NOP;
+            st->labels++;
+            changed = 1;
+        }
+    }
+    free(label_pos); free(refs);
+    if (changed) tac_compact(fn);
+    return changed;
+}
+
+// Backward walk per block from the live-out set; names local to the block
+// are tracked with a stamp recording the last block they were read in.
+static int dce_dead_assignments(TacFunc *fn, DCEStats *st) {
+    TacLiveness *lv  = tac_get_liveness(fn);
+    TacCFG      *cfg = tac_get_cfg(fn);
+    uint64_t *live = (uint64_t *)tac_xrealloc(NULL, sizeof(uint64_t) * (lv->words + 1));
+    int *read_in   = (int *)tac_xrealloc(NULL, sizeof(int) * tac_sym_count);
+    int  removed   = 0;
+    memset(read_in, 0xff, sizeof(int) * tac_sym_count);
+
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        memcpy(live, lv->out + (size_t)b * lv->words, sizeof(uint64_t) * lv->words);
+        for (int i = bb->end - 1; i >= bb->start; i--) {
+            TacInstr *in = &fn->code[i];
+            int d = tac_def(in);
+            if (d >= 0) {
+                int k = tac_live_index(lv, d);
+                int is_live = IS_GLOBAL(d) || (k >= 0 ? BITSET_TEST(live, k) : read_in[d] == b);
+                if (!is_live && (in->kind == TAC_COPY || tac_is_pure(in))) {
+                    in->kind = TAC_NOP;
+                    removed++;
+                    continue;
+                }
+                if (k >= 0) BITSET_CLEAR(live, k);
+                else        read_in[d] = -1;
+            }
+            int u[4], nu = tac_uses(in, u);
+            for (int j = 0; j < nu; j++) {
+                int k = tac_live_index(lv, u[j]);
+                if (k >= 0) BITSET_SET(live, k);
+                else        read_in[u[j]] = b;
+            }
+        }
+    }
+    free(live); free(read_in);
+    if (removed) tac_compact(fn);
+    st->dead += removed;
+    return removed;
+}
+
+// Give the surviving labels consecutive numbers across the whole program
+static void renumber_labels(TacProgram *prog) {
+    int *map = (int *)tac_xrealloc(NULL, sizeof(int) * tac_sym_count);
+    int  next = 0, nsyms = tac_sym_count;
+    memset(map, 0xff, sizeof(int) * nsyms);
+    for (int f = 0; f < prog->count; f++) {
+        TacFunc *fn = &prog->funcs[f];
+        for (int i = 0; i < fn->count; i++)
+            if (fn->code[i].kind == TAC_LABEL && map[fn->code[i].label] < 0) {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "L%d", next++);
+                map[fn->code[i].label] = tac_intern_label(buf);
+            }
+        for (int i = 0; i < fn->count; i++)
+            if (fn->code[i].label >= 0 && fn->code[i].label < nsyms && map[fn->code[i].label] >= 0)
+                fn->code[i].label = map[fn->code[i].label];
+        tac_changed(fn);
+    }
+    free(map);
+}
+
+static void dead_code_eliminate(TacFunc *fn) {
+    DCEStats st = { 0 };
+    int changed = 1;
+    while (changed) {
+        changed  = dce_unreachable(fn, &st);
+        changed |= dce_jumps(fn, &st);
+        changed |= dce_dead_assignments(fn, &st);
+    }
+    printf("[dce] %s: %d unreachable blocks, %d dead assignments, %d fall-through jumps, "
+           "%d jumps threaded, %d labels removed\n",
+           fn->name, st.unreachable, st.dead, st.jumps, st.threaded, st.labels);
+}
+
+//--------------------------------------------------- Dead Function Elimination
+// Phase 3 already drops functions main never calls, but inlining and
+// compile-time evaluation strand more: callees whose last call site is
+// gone. Reachability is recomputed from main once every function has been
+// optimized, and the rest are dropped from the output.
+static void remove_unreachable_functions(TacProgram *prog) {
+    const TacFunc *main_fn = tac_find_func(prog, "main");
+    if (!main_fn) return;
+    TacCallGraph *cg = tac_build_call_graph(prog);
+    char *reached = (char *)calloc(prog->count + 1, 1);
+    int  *work    = (int *)tac_xrealloc(NULL, sizeof(int) * (prog->count + 1));
+    int   nwork   = 0;
+    reached[main_fn - prog->funcs] = 1;
+    work[nwork++] = (int)(main_fn - prog->funcs);
+    while (nwork > 0) {
+        int f = work[--nwork];
+        for (int c = cg->callee_start[f]; c < cg->callee_start[f + 1]; c++) {
+            int g = cg->callees[c];
+            if (g < 0 || reached[g]) continue;
+            reached[g] = 1;
+            work[nwork++] = g;
+        }
+    }
+
+    int kept = 0, dropped = 0, removed = 0, total = 0, nfuncs = prog->count;
+    for (int f = 0; f < nfuncs; f++) {
+        total += prog->funcs[f].count;
+        if (reached[f]) {
+            prog->funcs[kept++] = prog->funcs[f];
+            continue;
+        }
+        printf("[dfe] %s: unreachable from main, %d instructions removed\n", prog->funcs[f].name, prog->funcs[f].count);
+        removed += prog->funcs[f].count;
+        dropped++;
+    }
+    prog->count = kept;
+    printf("[dfe] %d of %d functions unreachable from main, %d of %d instructions removed\n",
+           dropped, nfuncs, removed, total);
+    free(reached);
+    free(work);
+    tac_free_call_graph(cg);
+}
+
+//--------------------------------------------------- Loop Rewriting
+// Loop passes collect their edits and apply them in one rebuild: deleted
+// instructions, instructions inserted after a given position, and
+// instructions for a preheader created in front of the header label.
+
+#define IN_PREHEADER -1
+
+typedef struct {
+    int      pos;       // Insert after this instruction, or IN_PREHEADER
+    int      seq;       // Order among edits at the same position
+    TacInstr in;
+} LoopEdit;
+
+// A call may assign any global: count it as a definition of each one
+static void loop_call_defs(int *defcnt, int *def_at, int i) {
+    for (int s = 0; s < tac_sym_count; s++)
+        if (IS_GLOBAL(s)) { defcnt[s]++; def_at[s] = i; }
+}
+
+static int loop_edit_cmp(const void *x, const void *y) {
+    const LoopEdit *a = (const LoopEdit *)x, *b = (const LoopEdit *)y;
+    return a->pos != b->pos ? a->pos - b->pos : a->seq - b->seq;
+}
+
+static void loop_rewrite(TacFunc *fn, int l, const char *skip, LoopEdit *ed, int ned) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLoopInfo *li  = tac_get_loops(fn);
+    int hstart = cfg->blocks[li->loops[l].header].start;
+    int hlabel = fn->code[hstart].label;
+    int npre   = 0;
+    for (int k = 0; k < ned; k++) {
+        npre += ed[k].pos == IN_PREHEADER;
+        ed[k].seq = k;
+    }
+    qsort(ed, ned, sizeof(LoopEdit), loop_edit_cmp);
+
+    TacInstr *code = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * (fn->count + ned + 2));
+    int n = 0, k = npre, pre = npre > 0 ? tac_new_label() : -1;
+    for (int i = 0; i < fn->count; i++) {
+        if (i == hstart && npre > 0) {
+            // A loop block falling into the header must now jump over the preheader
+            if (i > 0 && tac_in_loop(li, l, cfg->block_of[i - 1]) &&
+                fn->code[i - 1].kind != TAC_GOTO && fn->code[i - 1].kind != TAC_RETURN)
+                code[n++] = tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, hlabel);
+            code[n++] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, pre);
+            for (int j = 0; j < npre; j++) code[n++] = ed[j].in;
+        }
+        if (!skip || !skip[i]) {
+            TacInstr in = fn->code[i];
+            // Entries from outside the loop go through the preheader
+            if (pre >= 0 && tac_is_jump(&in) && in.label == hlabel &&
+                !tac_in_loop(li, l, cfg->block_of[i]))
+                in.label = pre;
+            code[n++] = in;
+        }
+        while (k < ned && ed[k].pos == i) code[n++] = ed[k++].in;
+    }
+    free(fn->code);
+    fn->code = code;
+    fn->count = fn->capacity = n;
+    tac_changed(fn);
+}
+
+// Run a per-loop pass once on every loop, innermost first. Passes may edit
+// the code, so loops are recomputed and recognized by their header label.
+static void for_each_loop(TacFunc *fn, int (*pass)(TacFunc *fn, int l)) {
+    char *done = (char *)calloc(tac_sym_count + 1, 1);
+    int   ndone = tac_sym_count;
+    for (;;) {
+        TacCFG      *cfg = tac_get_cfg(fn);
+        TacLoopInfo *li  = tac_get_loops(fn);
+        int next = -1;
+        for (int l = 0; l < li->nloops && next < 0; l++) {
+            int start = cfg->blocks[li->loops[l].header].start;
+            int label = start < fn->count && fn->code[start].kind == TAC_LABEL ? fn->code[start].label : -1;
+            if (label >= 0 && label < ndone && !done[label]) {
+                done[label] = 1;
+                next = l;
+            }
+        }
+        if (next < 0) break;
+        pass(fn, next);
+    }
+    free(done);
+}
+
+//--------------------------------------------------- Loop-Invariant Code Motion
+// For each natural loop (innermost first) a pure computation is invariant
+// when every operand is a constant, is not assigned in the loop (a call
+// assigns every global), or comes from a single invariant definition in the
+// loop. It is moved into a new preheader, just before the header label, if
+//   - its destination is assigned only there and is not live into the header,
+//   - its block dominates every loop exit, or the destination is dead there,
+//   - it cannot trap: / and % are only hoisted with a nonzero constant divisor.
+
+static int licm_divisor_safe(const TacInstr *in) {
+    if (in->kind != TAC_BINARY || (in->op != OP_DIV && in->op != OP_MOD)) return 1;
+    return IS_CONST(in->b) && atof(SYM_NAME(in->b)) != 0.0;
+}
+
+// Hoist from loop l; returns the number of instructions moved
+static int licm_loop(TacFunc *fn, int l) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLoopInfo *li  = tac_get_loops(fn);
+    TacLiveness *lv  = tac_get_liveness(fn);
+    const TacLoop *lp = &li->loops[l];
+    int h = lp->header;
+    int hstart = cfg->blocks[h].start;
+    if (hstart >= fn->count || fn->code[hstart].kind != TAC_LABEL) return 0;
+    int hlabel = fn->code[hstart].label;
+
+    int nsyms = tac_sym_count;
+    int *defcnt  = (int *)calloc(nsyms, sizeof(int));
+    int *def_at  = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    char *inv    = (char *)calloc(fn->count + 1, 1);
+    int *exiting = (int *)tac_xrealloc(NULL, sizeof(int) * (lp->nblocks + 1));
+    int  nexiting = 0, hoisted = 0;
+
+    for (int k = 0; k < lp->nblocks; k++) {
+        const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            int d = tac_def(&fn->code[i]);
+            if (d >= 0) { defcnt[d]++; def_at[d] = i; }
+            if (fn->code[i].kind == TAC_CALL) loop_call_defs(defcnt, def_at, i);
+        }
+        int exits = 0;
+        for (int e = 0; e < bb->nsucc; e++)
+            if (!tac_in_loop(li, l, bb->succ[e])) exits = 1;
+        if (exits) exiting[nexiting++] = lp->blocks[k];
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int k = 0; k < lp->nblocks; k++) {
+            int b = lp->blocks[k];
+            const TacBlock *bb = &cfg->blocks[b];
+            for (int i = bb->start; i < bb->end; i++) {
+                TacInstr *in = &fn->code[i];
+                if (inv[i] || !tac_is_pure(in) || !licm_divisor_safe(in)) continue;
+                if (defcnt[in->dst] != 1 || IS_GLOBAL(in->dst) || tac_live_in(lv, h, in->dst)) continue;
+                int u[4], nu = tac_uses(in, u), ok = 1;
+                for (int j = 0; j < nu && ok; j++)
+                    ok = IS_CONST(u[j]) || defcnt[u[j]] == 0 || (defcnt[u[j]] == 1 && inv[def_at[u[j]]]);
+                if (!ok) continue;
+                // Must run on every path out of the loop, or be unobservable outside it
+                for (int e = 0; e < nexiting && ok; e++) {
+                    if (tac_dominates(cfg, b, exiting[e])) continue;
+                    const TacBlock *xb = &cfg->blocks[exiting[e]];
+                    for (int s2 = 0; s2 < xb->nsucc; s2++)
+                        if (!tac_in_loop(li, l, xb->succ[s2]) && tac_live_in(lv, xb->succ[s2], in->dst)) ok = 0;
+                }
+                if (!ok) continue;
+                inv[i] = 1;
+                hoisted++;
+                changed = 1;
+            }
+        }
+    }
+
+    if (hoisted > 0) {
+        LoopEdit *ed = (LoopEdit *)tac_xrealloc(NULL, sizeof(LoopEdit) * hoisted);
+        int ned = 0;
+        for (int k = 0; k < lp->nblocks; k++) {
+            const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+            for (int j = bb->start; j < bb->end; j++)
+                if (inv[j]) {
+                    ed[ned].pos = IN_PREHEADER;
+                    ed[ned++].in = fn->code[j];
+                }
+        }
+        loop_rewrite(fn, l, inv, ed, ned);
+        free(ed);
+    }
+    printf("[licm] %s: loop at %s (%d blocks): %d instructions hoisted\n",
+           fn->name, SYM_NAME(hlabel), lp->nblocks, hoisted);
+
+    free(defcnt); free(def_at); free(inv); free(exiting);
+    return hoisted;
+}
+
+static void loop_invariant_code_motion(TacFunc *fn) {
+    for_each_loop(fn, licm_loop);
+}
+
+//--------------------------------------------------- Induction-Variable Strength Reduction
+// A basic induction variable is assigned once in the loop, as i = i +/- c
+// or phase 4's t = i +/- c; i = t, with c an integer literal. A product
+// i * k with k a literal or loop-invariant becomes a new variable s set to
+// i * k in the preheader and advanced by c * k right after i's update, so
+// the multiply turns into a copy. When i then only feeds its own update
+// and comparisons against literals, and is dead after the loop, those
+// comparisons are rewritten against s and the update dies in DCE.
+//
+// Phase 3 gives both BinOp operands the same type and types integer
+// literals as int, so an operand next to an integer literal is an int.
+// That is what makes the shift and mask rewrites below type-safe.
+
+typedef struct {
+    long step;          // Signed constant step
+    int  update;        // Instruction assigning the variable
+    int  incr;          // Instruction computing i +/- c (same as update in direct form)
+} BasicIV;
+
+typedef struct {
+    int  iv;            // Basic IV being scaled
+    int  k;             // Multiplier symbol
+    int  s;             // Reduced variable holding iv * k
+} ReducedIV;
+
+static int log2_exact(long v) {
+    if (v <= 0 || (v & (v - 1))) return -1;
+    int k = 0;
+    while ((1L << k) < v) k++;
+    return k;
+}
+
+// i +/- literal with i the given variable; returns 1 and the signed step
+static int iv_increment(const TacInstr *in, int var, long *step) {
+    if (in->kind != TAC_BINARY || (in->op != OP_ADD && in->op != OP_SUB)) return 0;
+    if (in->a == var && tac_is_int_const(in->b)) {
+        *step = in->op == OP_ADD ? tac_const_int(in->b) : -tac_const_int(in->b);
+        return 1;
+    }
+    if (in->op == OP_ADD && in->b == var && tac_is_int_const(in->a)) {
+        *step = tac_const_int(in->a);
+        return 1;
+    }
+    return 0;
+}
+
+// Does every pass over the edge p -> x imply v >= 0? True when p ends in
+// a branch on 'v >= c' (c >= 0) or 'v > c' (c >= -1), directly or through
+// the temp it tests, and that relation holds on this edge.
+static int edge_nonneg(const TacFunc *fn, const TacCFG *cfg, int p, int x, int v) {
+    const TacBlock *pb = &cfg->blocks[p];
+    if (pb->end == pb->start || pb->nsucc != 2) return 0;
+    const TacInstr *br = &fn->code[pb->end - 1];
+    if (!tac_is_cond_branch(br)) return 0;
+    TacOp op = br->op;
+    int   lhs = br->a, rhs = br->b;
+    if (op == OP_NONE) {
+        const TacInstr *cmp = NULL;
+        for (int i = pb->end - 2; i >= pb->start && !cmp; i--)
+            if (tac_def(&fn->code[i]) == br->a) cmp = &fn->code[i];
+        if (!cmp || cmp->kind != TAC_BINARY || !tac_is_relop(cmp->op)) return 0;
+        op = cmp->op; lhs = cmp->a; rhs = cmp->b;
+    }
+    if (lhs != v || !tac_is_int_const(rhs)) return 0;
+    // succ[0] is the fall-through; v is compared with an int literal, so
+    // negating the relation for the other edge is exact
+    int taken = pb->succ[1] == x;
+    if ((br->kind == TAC_IF) != taken) op = tac_negate_relop(op);
+    long c = tac_const_int(rhs);
+    return (op == OP_GE && c >= 0) || (op == OP_GT && c >= -1);
+}
+
+// Is v >= 0 when instruction pos runs? Either v is not a parameter and every
+// definition of v is a nonnegative literal or a nonnegative step, or pos is
+// dominated by a block whose incoming edges all test v >= 0 and v is not
+// redefined in between.
+static int nonneg_at(TacFunc *fn, int v, int pos) {
+    if (tac_is_int_const(v)) return tac_const_int(v) >= 0;
+    if (!tac_is_name(v) || IS_GLOBAL(v)) return 0;
+
+    // A parameter is also defined on entry, by a caller that may pass anything
+    int monotone = 1, ndefs = 0;
+    for (int k = 0; k < fn->nparams && monotone; k++)
+        if (fn->params[k] == v) monotone = 0;
+    for (int i = 0; i < fn->count && monotone; i++) {
+        const TacInstr *in = &fn->code[i];
+        if (tac_def(in) != v) continue;
+        ndefs++;
+        long step;
+        if (in->kind == TAC_COPY && tac_is_int_const(in->a) && tac_const_int(in->a) >= 0) continue;
+        if (iv_increment(in, v, &step) && step >= 0) continue;
+        if (in->kind == TAC_COPY && IS_TEMP(in->a)) {   // v = t where t = v + c
+            int ok = 0;
+            for (int j = i - 1; j >= 0 && !ok; j--)
+                if (tac_def(&fn->code[j]) == in->a) {
+                    ok = iv_increment(&fn->code[j], v, &step) && step >= 0;
+                    break;
+                }
+            if (ok) continue;
+        }
+        monotone = 0;
+    }
+    if (monotone && ndefs > 0) return 1;
+
+    TacCFG *cfg = tac_get_cfg(fn);
+    int b = cfg->block_of[pos];
+    int found = 0;
+    char *mark = (char *)tac_xrealloc(NULL, cfg->nblocks + 1);
+    int  *work = (int *)tac_xrealloc(NULL, sizeof(int) * (cfg->nblocks + 1));
+    for (int x = b; x >= 0 && !found; x = cfg->blocks[x].idom) {
+        const TacBlock *xb = &cfg->blocks[x];
+        int guarded = xb->npred > 0;
+        for (int k = 0; k < xb->npred && guarded; k++)
+            guarded = edge_nonneg(fn, cfg, cfg->pred_list[xb->pred_start + k], x, v);
+        if (!guarded) continue;
+
+        // No redefinition of v on any path from x's entry to pos
+        int ok = 1, sp = 0;
+        memset(mark, 0, cfg->nblocks + 1);
+        for (int i = cfg->blocks[b].start; i < pos && ok; i++)
+            if (tac_def(&fn->code[i]) == v) ok = 0;
+        if (b != x) {
+            const TacBlock *bb = &cfg->blocks[b];
+            for (int k = 0; k < bb->npred; k++) {
+                int p = cfg->pred_list[bb->pred_start + k];
+                if (!mark[p]) { mark[p] = 1; work[sp++] = p; }
+            }
+        }
+        while (sp > 0 && ok) {
+            const TacBlock *yb = &cfg->blocks[work[--sp]];
+            for (int i = yb->start; i < yb->end && ok; i++)
+                if (tac_def(&fn->code[i]) == v) ok = 0;
+            if (yb == xb) continue;
+            for (int k = 0; k < yb->npred; k++) {
+                int p = cfg->pred_list[yb->pred_start + k];
+                if (!mark[p]) { mark[p] = 1; work[sp++] = p; }
+            }
+        }
+        found = ok;
+    }
+    free(mark); free(work);
+    return found;
+}
+
+static int strength_reduce_loop(TacFunc *fn, int l) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLoopInfo *li  = tac_get_loops(fn);
+    TacLiveness *lv  = tac_get_liveness(fn);
+    const TacLoop *lp = &li->loops[l];
+    int hstart = cfg->blocks[lp->header].start;
+    if (hstart >= fn->count || fn->code[hstart].kind != TAC_LABEL) return 0;
+    int header = fn->code[hstart].label;
+
+    int nsyms = tac_sym_count;
+    int *defcnt = (int *)calloc(nsyms, sizeof(int));
+    int *def_at = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    int *biv_of = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);   // Symbol -> BasicIV index
+    BasicIV   *bivs = (BasicIV *)tac_xrealloc(NULL, sizeof(BasicIV) * (fn->count + 1));
+    ReducedIV *red  = (ReducedIV *)tac_xrealloc(NULL, sizeof(ReducedIV) * (fn->count + 1));
+    LoopEdit  *ed   = (LoopEdit *)tac_xrealloc(NULL, sizeof(LoopEdit) * (fn->count * 3 + 1));
+    char      *skip = (char *)calloc(fn->count + 1, 1);
+    int nbiv = 0, nred = 0, ned = 0, reduced = 0, eliminated = 0;
+    memset(biv_of, 0xff, sizeof(int) * nsyms);
+
+    for (int k = 0; k < lp->nblocks; k++) {
+        const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            int d = tac_def(&fn->code[i]);
+            if (d >= 0) { defcnt[d]++; def_at[d] = i; }
+            if (fn->code[i].kind == TAC_CALL) loop_call_defs(defcnt, def_at, i);
+        }
+    }
+
+    // Basic induction variables
+    for (int k = 0; k < lp->nblocks; k++) {
+        const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            const TacInstr *in = &fn->code[i];
+            int d = tac_def(in);
+            long step;
+            if (d < 0 || IS_CONST(d) || IS_GLOBAL(d) || defcnt[d] != 1) continue;
+            int incr = -1;
+            if (iv_increment(in, d, &step)) {
+                incr = i;
+            } else if (in->kind == TAC_COPY && IS_TEMP(in->a) && defcnt[in->a] == 1 &&
+                       iv_increment(&fn->code[def_at[in->a]], d, &step)) {
+                incr = def_at[in->a];
+            }
+            if (incr < 0 || step == 0) continue;
+            biv_of[d] = nbiv;
+            bivs[nbiv].step = step;
+            bivs[nbiv].update = i;
+            bivs[nbiv].incr = incr;
+            nbiv++;
+        }
+    }
+
+    // Products of an induction variable and an invariant
+    for (int k = 0; k < lp->nblocks && nbiv > 0; k++) {
+        const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            TacInstr *in = &fn->code[i];
+            if (in->kind != TAC_BINARY || in->op != OP_MUL || in->type == TY_FLOAT) continue;
+            int iv = in->a, kk = in->b;
+            if (biv_of[iv] < 0 || biv_of[kk] >= 0) { iv = in->b; kk = in->a; }
+            if (biv_of[iv] < 0) continue;
+            if (!(tac_is_int_const(kk) || (tac_is_name(kk) && defcnt[kk] == 0))) continue;
+            const BasicIV *bv = &bivs[biv_of[iv]];
+
+            int r = 0;
+            while (r < nred && !(red[r].iv == iv && red[r].k == kk)) r++;
+            if (r == nred) {
+                red[nred].iv = iv;
+                red[nred].k  = kk;
+                red[nred].s  = tac_new_temp();
+                int s = red[nred].s;
+                TacOp op = bv->step > 0 ? OP_ADD : OP_SUB;
+                long  c  = bv->step > 0 ? bv->step : -bv->step;
+                int   inc;
+                ed[ned].pos = IN_PREHEADER;
+                ed[ned++].in = tac_make(TAC_BINARY, OP_MUL, s, iv, kk, -1);
+                if (tac_is_int_const(kk)) {
+                    long v = c * tac_const_int(kk);
+                    if (v < 0) { v = -v; op = op == OP_ADD ? OP_SUB : OP_ADD; }
+                    inc = tac_intern_int(v);
+                } else {
+                    inc = tac_new_temp();
+                    ed[ned].pos = IN_PREHEADER;
+                    ed[ned++].in = tac_make(TAC_BINARY, OP_MUL, inc, kk, tac_intern_int(c), -1);
+                }
+                ed[ned].pos = bv->update;
+                ed[ned++].in = tac_make(TAC_BINARY, op, s, s, inc, -1);
+                nred++;
+            }
+            *in = tac_make(TAC_COPY, OP_NONE, in->dst, red[r].s, -1, -1);
+            reduced++;
+        }
+    }
+
+    // Linear-function test replacement: compare the reduced variable instead
+    for (int v = 0; v < nsyms && nred > 0; v++) {
+        if (biv_of[v] < 0) continue;
+        const BasicIV *bv = &bivs[biv_of[v]];
+        int r = 0;
+        while (r < nred && !(red[r].iv == v && tac_is_int_const(red[r].k) && tac_const_int(red[r].k) != 0)) r++;
+        if (r == nred) continue;
+        long kv = tac_const_int(red[r].k);
+
+        int ok = 1;
+        for (int k = 0; k < lp->nblocks && ok; k++) {
+            const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+            for (int e = 0; e < bb->nsucc && ok; e++)
+                if (!tac_in_loop(li, l, bb->succ[e]) && tac_live_in(lv, bb->succ[e], v)) ok = 0;
+            for (int i = bb->start; i < bb->end && ok; i++) {
+                const TacInstr *in = &fn->code[i];
+                int u[4], nu = tac_uses(in, u), uses_v = 0;
+                for (int j = 0; j < nu; j++) uses_v |= u[j] == v;
+                if (!uses_v || i == bv->incr) continue;
+                int relop = (in->kind == TAC_BINARY || tac_is_cond_branch(in)) && tac_is_relop(in->op);
+                if (!(relop && in->a == v && tac_is_int_const(in->b))) ok = 0;
+                else if (labs(tac_const_int(in->b) * kv) > 0x7fffffffL) ok = 0;
+            }
+        }
+        if (!ok) continue;
+        for (int k = 0; k < lp->nblocks; k++) {
+            const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+            for (int i = bb->start; i < bb->end; i++) {
+                TacInstr *in = &fn->code[i];
+                if (!tac_is_relop(in->op) || in->a != v || i == bv->incr) continue;
+                in->a = red[r].s;
+                in->b = tac_intern_int(tac_const_int(in->b) * kv);
+                if (kv < 0) in->op = tac_swap_relop(in->op);
+            }
+        }
+        // The update only feeds itself around the back edge, which liveness
+        // cannot see as dead, so drop it here
+        skip[bv->update] = 1;
+        if (bv->incr != bv->update) {
+            int t = fn->code[bv->incr].dst, nuses = 0;
+            for (int i = 0; i < fn->count; i++) {
+                int u[4], nu = tac_uses(&fn->code[i], u);
+                for (int j = 0; j < nu; j++) nuses += u[j] == t;
+            }
+            if (nuses == 1) skip[bv->incr] = 1;
+        }
+        eliminated++;
+    }
+
+    if (ned > 0) loop_rewrite(fn, l, skip, ed, ned);
+    printf("[ivsr] %s: loop at %s: %d induction variables, %d multiplies reduced, %d eliminated\n",
+           fn->name, SYM_NAME(header), nbiv, reduced, eliminated);
+
+    free(defcnt); free(def_at); free(biv_of); free(bivs); free(red); free(ed); free(skip);
+    return reduced;
+}
+
+// Power-of-two multiplies, and divides/remainders of nonnegative values
+static int power_of_two_rewrite(TacFunc *fn) {
+    int count = 0;
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        if (in->kind != TAC_BINARY || in->type == TY_FLOAT) continue;
+        if (in->op == OP_MUL) {
+            if (tac_is_int_const(in->a) && !IS_CONST(in->b)) { int t = in->a; in->a = in->b; in->b = t; }
+            int k = tac_is_int_const(in->b) ? log2_exact(tac_const_int(in->b)) : -1;
+            if (k < 1 || IS_CONST(in->a)) continue;
+            in->op = OP_SHL;
+            in->b  = tac_intern_int(k);
+            count++;
+        } else if (in->op == OP_DIV || in->op == OP_MOD) {
+            int k = tac_is_int_const(in->b) ? log2_exact(tac_const_int(in->b)) : -1;
+            if (k < 1 || IS_CONST(in->a) || !nonneg_at(fn, in->a, i)) continue;
+            if (in->op == OP_DIV) {
+                in->op = OP_SHR;
+                in->b  = tac_intern_int(k);
+            } else {
+                in->op = OP_BAND;
+                in->b  = tac_intern_int((1L << k) - 1);
+            }
+            count++;
+        }
+    }
+    if (count) tac_changed(fn);
+    return count;
+}
+
+static void strength_reduce(TacFunc *fn) {
+    for_each_loop(fn, strength_reduce_loop);
+    int shifts = power_of_two_rewrite(fn);
+    printf("[ivsr] %s: %d power-of-two operations turned into shifts/masks\n", fn->name, shifts);
+}
+
+//--------------------------------------------------- Loop Unrolling
+// Counted loops in the rotated shape phase 4 emits,
+//     Lbody: body (i updated once by a literal step); if i relop N goto Lbody
+// with N a literal or loop-invariant and the bottom test the only exit.
+// A constant trip count within budget is unrolled fully. Otherwise the body
+// is replicated 'factor' times in a main loop that runs while a whole group
+// of iterations remains, and the original loop follows as the remainder:
+//     ifFalse i relop N' goto Lrem; Lu: body x factor; if i relop N' goto Lu
+//     ifFalse i relop N goto Lexit; Lrem: Lbody: ... (original loop); Lexit:
+// where N' = N -/+ (factor - 1) * |step| leaves room for the whole group.
+// When the trip count is not a constant but the loop was profiled, the
+// factor follows the average trip count measured instead: loops that ran
+// fewer than two iterations per entry are left alone.
+
+#define DEFAULT_UNROLL      4   // Unroll factor for partial unrolling (-unroll=N)
+#define MAX_UNROLL_SIZE   128   // Largest unrolled body, in instructions
+#define MAX_FULL_UNROLL    16   // Largest constant trip count unrolled fully
+
+static int unroll_factor = DEFAULT_UNROLL;
+
+// Number of body executions of the rotated loop, or -1 if not a simple count
+static long unroll_trip_count(TacOp op, long init, long bound, long step) {
+    long dist;
+    switch (op) {
+        case OP_LT: dist = bound - init;     break;
+        case OP_LE: dist = bound - init + 1; break;
+        case OP_GT: dist = init - bound;     break;
+        case OP_GE: dist = init - bound + 1; break;
+        default:    return -1;
+    }
+    long s = step > 0 ? step : -step;
+    return dist <= 0 ? 0 : (dist + s - 1) / s;
+}
+
+// Append code[from, to) to out, giving labels and iteration-local temps
+// fresh names; map translates original symbols and is identity otherwise.
+static void unroll_copy(const TacFunc *fn, int from, int to, const char *local,
+                        int *map, int nsyms, TacInstr *out, int *n) {
+    for (int i = from; i < to; i++) {
+        const TacInstr *in = &fn->code[i];
+        if (in->kind == TAC_LABEL) map[in->label] = tac_new_label();
+        int d = tac_def(in);
+        if (d >= 0 && local[d]) map[d] = tac_new_temp();
+    }
+    for (int i = from; i < to; i++) {
+        TacInstr in = fn->code[i];
+        if (in.dst >= 0 && in.dst < nsyms)     in.dst = map[in.dst];
+        if (in.a >= 0 && in.a < nsyms)         in.a = map[in.a];
+        if (in.b >= 0 && in.b < nsyms)         in.b = map[in.b];
+        if (in.label >= 0 && in.label < nsyms) in.label = map[in.label];
+        out[(*n)++] = in;
+    }
+}
+
+static int unroll_loop(TacFunc *fn, int l) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLoopInfo *li  = tac_get_loops(fn);
+    TacLiveness *lv  = tac_get_liveness(fn);
+    const TacLoop *lp = &li->loops[l];
+    int hstart = cfg->blocks[lp->header].start;
+    if (hstart >= fn->count || fn->code[hstart].kind != TAC_LABEL) return 0;
+    int header = fn->code[hstart].label;
+    const char *why = NULL;
+
+    // One contiguous run of blocks, entered at the header from the block
+    // before it and left only through the bottom test's fall-through
+    int last = lp->blocks[lp->nblocks - 1];
+    int end  = cfg->blocks[last].end;
+    TacInstr *br = &fn->code[end - 1];
+    if (lp->blocks[0] != lp->header || last - lp->header + 1 != lp->nblocks)
+        why = "blocks not contiguous";
+    else if (br->kind != TAC_IF || !tac_is_relop(br->op) || br->label != header)
+        why = "no bottom test";
+    for (int k = 0; k < lp->nblocks && !why; k++) {
+        const TacBlock *bb = &cfg->blocks[lp->blocks[k]];
+        for (int e = 0; e < bb->nsucc; e++)
+            if (!tac_in_loop(li, l, bb->succ[e]) && !(lp->blocks[k] == last && bb->succ[e] == last + 1))
+                why = "more than one exit";
+    }
+    const TacBlock *hb = &cfg->blocks[lp->header];
+    if (!why && (hb->npred != 2 || lp->header == 0 ||
+                 !tac_in_loop(li, l, cfg->pred_list[hb->pred_start]) +
+                 !tac_in_loop(li, l, cfg->pred_list[hb->pred_start + 1]) != 1))
+        why = "more than one entry";
+
+    // The test compares a basic induction variable with an invariant bound
+    int  iv = br->a, bound = br->b, ndefs = 0, bound_defs = 0, update = -1;
+    long step = 0;
+    for (int i = hstart; i < end && !why; i++) {
+        int d = tac_def(&fn->code[i]);
+        if (d == bound || (fn->code[i].kind == TAC_CALL && IS_GLOBAL(bound))) bound_defs++;
+        if (d != iv) continue;
+        ndefs++;
+        update = i;
+    }
+    if (!why) {
+        const TacInstr *up = &fn->code[update >= 0 ? update : hstart];
+        int ok = ndefs == 1 && !IS_GLOBAL(iv) && !IS_CONST(iv);
+        if (ok && !iv_increment(up, iv, &step)) {
+            ok = 0;
+            if (up->kind == TAC_COPY && IS_TEMP(up->a))
+                for (int i = update - 1; i >= hstart && !ok; i--)
+                    if (tac_def(&fn->code[i]) == up->a) {
+                        ok = iv_increment(&fn->code[i], iv, &step);
+                        break;
+                    }
+        }
+        if (!ok || step == 0)
+            why = "no basic induction variable";
+        else if (bound_defs > 0 || !(tac_is_int_const(bound) || tac_is_name(bound)))
+            why = "bound not loop-invariant";
+        else if (!(((br->op == OP_LT || br->op == OP_LE) && step > 0) ||
+                   ((br->op == OP_GT || br->op == OP_GE) && step < 0)))
+            why = "not a counted comparison";
+    }
+
+    // Constant trip count when both the bound and the entry value are literals
+    long trips = -1;
+    if (!why && tac_is_int_const(bound)) {
+        const TacBlock *pb = &cfg->blocks[lp->header - 1];
+        for (int i = pb->end - 1; i >= pb->start; i--) {
+            const TacInstr *in = &fn->code[i];
+            if (tac_def(in) != iv) continue;
+            if (in->kind == TAC_COPY && tac_is_int_const(in->a))
+                trips = unroll_trip_count(br->op, tac_const_int(in->a), tac_const_int(bound), step);
+            break;
+        }
+    }
+
+    int body = end - hstart - 2;
+    int full = 0, factor = unroll_factor;
+    long avg = 0;
+    int profiled = trips < 0 ? pgo_unroll_factor(header, &avg) : -1;
+    if (!why && profiled >= 0) {
+        if (profiled < 2) why = "profiled trip count below 2";
+        else              factor = profiled;
+    }
+    if (!why) {
+        if (trips >= 1 && trips <= MAX_FULL_UNROLL && trips * body <= MAX_UNROLL_SIZE) {
+            full = 1;
+        } else {
+            while (factor > 1 && factor * body > MAX_UNROLL_SIZE) factor /= 2;
+            if (factor < 2)                    why = "over size budget";
+            else if (trips >= 0 && trips < factor) why = "trip count below factor";
+        }
+    }
+    if (why) {
+        printf("[unroll] %s: loop at %s: not unrolled (%s)\n", fn->name, SYM_NAME(header), why);
+        return 0;
+    }
+
+    // Temps that die within an iteration get new names in every copy
+    int   nsyms = tac_sym_count;
+    char *local = (char *)calloc(nsyms, 1);
+    int  *map   = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    for (int s = 0; s < nsyms; s++) map[s] = s;
+    for (int i = hstart; i < end; i++) {
+        int d = tac_def(&fn->code[i]);
+        if (IS_TEMP(d) && !tac_live_in(lv, lp->header, d) && !tac_live_in(lv, last + 1, d)) local[d] = 1;
+    }
+
+    int copies = full ? (int)trips : factor;
+    TacInstr *code = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * (fn->count + copies * body + 12));
+    int n = 0;
+    for (int i = 0; i < hstart; i++) code[n++] = fn->code[i];
+    if (full) {
+        for (int c = 0; c < copies; c++) unroll_copy(fn, hstart + 1, end - 1, local, map, nsyms, code, &n);
+    } else {
+        long reach = (long)(factor - 1) * (step > 0 ? step : -step);
+        TacOp adjust = step > 0 ? OP_SUB : OP_ADD;
+        int limit;
+        if (tac_is_int_const(bound)) {
+            limit = tac_intern_int(adjust == OP_SUB ? tac_const_int(bound) - reach : tac_const_int(bound) + reach);
+        } else {
+            limit = tac_new_temp();
+            code[n++] = tac_make(TAC_BINARY, adjust, limit, bound, tac_intern_int(reach), -1);
+        }
+        int Lu = tac_new_label(), Lrem = tac_new_label(), Lexit = tac_new_label();
+        code[n++] = tac_make(TAC_IFFALSE, br->op, -1, iv, limit, Lrem);
+        code[n++] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lu);
+        for (int c = 0; c < copies; c++) unroll_copy(fn, hstart + 1, end - 1, local, map, nsyms, code, &n);
+        code[n++] = tac_make(TAC_IF, br->op, -1, iv, limit, Lu);
+        // The bottom-tested loop always runs once, so only the unrolled
+        // copies can leave nothing for the remainder to do
+        code[n++] = tac_make(TAC_IFFALSE, br->op, -1, iv, bound, Lexit);
+        code[n++] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lrem);
+        for (int i = hstart; i < end; i++) code[n++] = fn->code[i];
+        code[n++] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Lexit);
+    }
+    for (int i = end; i < fn->count; i++) code[n++] = fn->code[i];
+    free(fn->code);
+    fn->code = code;
+    fn->count = fn->capacity = n;
+    tac_changed(fn);
+
+    if (full)
+        printf("[unroll] %s: loop at %s: trip count %ld, fully unrolled (%d instructions)\n",
+               fn->name, SYM_NAME(header), trips, copies * body);
+    else if (trips >= 0)
+        printf("[unroll] %s: loop at %s: trip count %ld, unrolled by %d with remainder loop\n",
+               fn->name, SYM_NAME(header), trips, factor);
+    else if (profiled >= 0)
+        printf("[unroll] %s: loop at %s: profiled average trip count %ld, unrolled by %d with remainder loop\n",
+               fn->name, SYM_NAME(header), avg, factor);
+    else
+        printf("[unroll] %s: loop at %s: unknown trip count, unrolled by %d with remainder loop\n",
+               fn->name, SYM_NAME(header), factor);
+    free(local); free(map);
+    return 1;
+}
+
+static void unroll_loops(TacFunc *fn) {
+    if (unroll_factor > 1) for_each_loop(fn, unroll_loop);
+}
+
+//--------------------------------------------------- Peephole Optimization
+// Rewrite rules over windows of one or two adjacent instructions, tried at
+// every position and repeated until a sweep changes nothing. A rule gets the
+// window start and rewrites in place, leaving NOPs for tac_compact(); adding
+// one is a function and a line in peep_rules[].
+//
+// Some identities only hold for integers: x * 0 is NaN for an infinite x,
+// and x - x is 0.0 rather than 0 for floats. The operator's form tells the
+// two apart; for casts and !!a the pass first infers which names hold ints
+// (or floats) on every path.
+
+enum { PEEP_TOP, PEEP_INT, PEEP_FLOAT, PEEP_ANY };     // Value type lattice
+
+static int *peep_type;      // Symbol -> PEEP_*
+static int *peep_uses;      // Symbol -> reads left in the function
+static int  peep_nsyms;
+static int  peep_zero, peep_fzero;   // 0 and 0.0
+
+typedef struct {
+    const char *name;
+    int       (*apply)(TacFunc *fn, int i);   // Nonzero if it rewrote at code[i]
+    int         hits;
+} PeepRule;
+
+static int peep_type_of(int sym) {
+    if (sym < 0 || sym >= peep_nsyms) return PEEP_ANY;
+    if (IS_CONST(sym)) return tac_is_int_const(sym) ? PEEP_INT : PEEP_FLOAT;
+    return peep_type[sym];
+}
+
+static int peep_join(int x, int y) {
+    if (x == PEEP_TOP) return y;
+    if (y == PEEP_TOP || x == y) return x;
+    return PEEP_ANY;
+}
+
+static int peep_result_type(const TacInstr *in) {
+    int ta = peep_type_of(in->a);
+    if (in->kind == TAC_COPY) return ta;
+    if (in->kind == TAC_UNARY)
+        return in->op == OP_NEG ? ta : in->op == OP_TOFLOAT ? PEEP_FLOAT : PEEP_INT;
+    if (in->kind != TAC_BINARY) return PEEP_ANY;
+    return in->type == TY_FLOAT && !tac_is_relop(in->op) ? PEEP_FLOAT : PEEP_INT;
+}
+
+// Optimistic: names start at TOP and only widen, so loops settle on INT
+// when every definition around them is an int
+static void peep_infer_types(const TacFunc *fn) {
+    for (int s = 0; s < peep_nsyms; s++) peep_type[s] = PEEP_ANY;
+    for (int i = 0; i < fn->count; i++) {
+        int d = tac_def(&fn->code[i]);
+        if (d >= 0 && !IS_GLOBAL(d)) peep_type[d] = PEEP_TOP;
+    }
+    for (int k = 0; k < fn->nparams; k++) peep_type[fn->params[k]] = PEEP_ANY;   // Entry values unknown
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = 0; i < fn->count; i++) {
+            int d = tac_def(&fn->code[i]);
+            if (d < 0 || IS_GLOBAL(d)) continue;
+            int t = peep_join(peep_type[d], peep_result_type(&fn->code[i]));
+            if (t != peep_type[d]) { peep_type[d] = t; changed = 1; }
+        }
+    }
+}
+
+// Replace an instruction, keeping the use counts exact
+static void peep_set(TacInstr *in, TacInstr with) {
+    int u[4], n = tac_uses(in, u);
+    for (int k = 0; k < n; k++) if (u[k] < peep_nsyms) peep_uses[u[k]]--;
+    n = tac_uses(&with, u);
+    for (int k = 0; k < n; k++) if (u[k] < peep_nsyms) peep_uses[u[k]]++;
+    *in = with;
+}
+
+static void peep_copy(TacInstr *in, int src) {
+    peep_set(in, tac_make(TAC_COPY, OP_NONE, in->dst, src, -1, -1));
+}
+
+static void peep_delete(TacInstr *in) {
+    peep_set(in, tac_make(TAC_NOP, OP_NONE, -1, -1, -1, -1));
+}
+
+static int peep_is_literal(int sym, double v) {
+    return IS_CONST(sym) && strtod(SYM_NAME(sym), NULL) == v;
+}
+
+// Identity element k on either side; the operator's form fixes the type of
+// both operands, so the result is the other one unchanged
+static int peep_identity(const TacInstr *in, double k, int either_side) {
+    if (peep_is_literal(in->b, k)) return in->a;
+    if (either_side && peep_is_literal(in->a, k)) return in->b;
+    return -1;
+}
+
+// x + 0, 0 + x, x - 0  =>  x
+static int peep_add_zero(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_BINARY || (in->op != OP_ADD && in->op != OP_SUB)) return 0;
+    int x = peep_identity(in, 0.0, in->op == OP_ADD);
+    if (x < 0) return 0;
+    peep_copy(in, x);
+    return 1;
+}
+
+// x * 1, 1 * x, x / 1  =>  x
+static int peep_mul_one(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_BINARY || (in->op != OP_MUL && in->op != OP_DIV)) return 0;
+    int x = peep_identity(in, 1.0, in->op == OP_MUL);
+    if (x < 0) return 0;
+    peep_copy(in, x);
+    return 1;
+}
+
+// x * 0, 0 * x  =>  0 (ints only)
+static int peep_mul_zero(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_BINARY || in->op != OP_MUL || in->type == TY_FLOAT) return 0;
+    if (!peep_is_literal(in->a, 0.0) && !peep_is_literal(in->b, 0.0)) return 0;
+    peep_copy(in, peep_zero);
+    return 1;
+}
+
+// x - x  =>  0 (ints only)
+static int peep_sub_self(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_BINARY || in->op != OP_SUB || in->a != in->b || in->type == TY_FLOAT) return 0;
+    peep_copy(in, peep_zero);
+    return 1;
+}
+
+// t = !a; x = !t  =>  x = a != 0, or x = a !=. 0.0 for a float a
+static int peep_not_not(TacFunc *fn, int i) {
+    if (i + 1 >= fn->count) return 0;
+    TacInstr *in = &fn->code[i], *next = &fn->code[i + 1];
+    int ta = peep_type_of(in->a);
+    if (in->kind != TAC_UNARY || in->op != OP_NOT || next->kind != TAC_UNARY || next->op != OP_NOT ||
+        next->a != in->dst || in->a == in->dst || (ta != PEEP_INT && ta != PEEP_FLOAT))
+        return 0;
+    TacInstr ne = tac_make(TAC_BINARY, OP_NE, next->dst, in->a, ta == PEEP_FLOAT ? peep_fzero : peep_zero, -1);
+    ne.type = ta == PEEP_FLOAT ? TY_FLOAT : TY_TOP;
+    peep_set(next, ne);
+    return 1;
+}
+
+// t = !a; ifFalse t goto L  =>  if a goto L (and the other way round)
+static int peep_not_branch(TacFunc *fn, int i) {
+    if (i + 1 >= fn->count) return 0;
+    TacInstr *in = &fn->code[i], *next = &fn->code[i + 1];
+    if (in->kind != TAC_UNARY || in->op != OP_NOT || !tac_is_cond_branch(next) || tac_is_fused_branch(next) ||
+        next->a != in->dst || !IS_TEMP(in->dst) || peep_uses[in->dst] != 1)
+        return 0;
+    peep_set(next, tac_make(next->kind == TAC_IF ? TAC_IFFALSE : TAC_IF, OP_NONE, -1, in->a, -1, next->label));
+    peep_delete(in);
+    return 1;
+}
+
+// t = <expr>; b = t  =>  b = <expr>, when that copy was t's only reader
+static int peep_copy_chain(TacFunc *fn, int i) {
+    if (i + 1 >= fn->count) return 0;
+    TacInstr *in = &fn->code[i], *next = &fn->code[i + 1];
+    if ((in->kind != TAC_COPY && in->kind != TAC_UNARY && in->kind != TAC_BINARY) ||
+        next->kind != TAC_COPY || next->a != in->dst || !IS_TEMP(in->dst) || peep_uses[in->dst] != 1)
+        return 0;
+    TacInstr merged = *in;
+    merged.dst = next->dst;
+    peep_delete(next);
+    peep_set(in, merged);
+    return 1;
+}
+
+// x = a; y = x  =>  x = a; y = a (nothing at all when y is a or x)
+static int peep_store_reload(TacFunc *fn, int i) {
+    if (i + 1 >= fn->count) return 0;
+    TacInstr *in = &fn->code[i], *next = &fn->code[i + 1];
+    if (in->kind != TAC_COPY || next->kind != TAC_COPY || next->a != in->dst || in->a == in->dst) return 0;
+    if (next->dst == in->a || next->dst == in->dst) peep_delete(next);
+    else                                           peep_copy(next, in->a);
+    return 1;
+}
+
+// (int)x with x an int, (float)x with x a float  =>  x
+static int peep_cast(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_UNARY) return 0;
+    if (!(in->op == OP_TOINT && peep_type_of(in->a) == PEEP_INT) &&
+        !(in->op == OP_TOFLOAT && peep_type_of(in->a) == PEEP_FLOAT))
+        return 0;
+    peep_copy(in, in->a);
+    return 1;
+}
+
+// t = <expr> with t never read  =>  nothing (divisions stay: they may trap)
+static int peep_dead_temp(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if ((in->kind != TAC_COPY && in->kind != TAC_UNARY && in->kind != TAC_BINARY) ||
+        !IS_TEMP(in->dst) || peep_uses[in->dst] != 0 ||
+        (in->kind == TAC_BINARY && (in->op == OP_DIV || in->op == OP_MOD)))
+        return 0;
+    peep_delete(in);
+    return 1;
+}
+
+// x = x  =>  nothing
+static int peep_self_copy(TacFunc *fn, int i) {
+    TacInstr *in = &fn->code[i];
+    if (in->kind != TAC_COPY || in->dst != in->a) return 0;
+    peep_delete(in);
+    return 1;
+}
+
+static PeepRule peep_rules[] = {
+    { "add-zero",    peep_add_zero,     0 },
+    { "mul-one",     peep_mul_one,      0 },
+    { "mul-zero",    peep_mul_zero,     0 },
+    { "sub-self",    peep_sub_self,     0 },
+    { "not-not",     peep_not_not,      0 },
+    { "not-branch",  peep_not_branch,   0 },
+    { "cast",        peep_cast,         0 },
+    { "copy-chain",  peep_copy_chain,   0 },
+    { "store-reload", peep_store_reload, 0 },
+    { "self-copy",   peep_self_copy,    0 },
+    { "dead-temp",   peep_dead_temp,    0 },
+};
+
+#define NUM_PEEP_RULES ((int)(sizeof(peep_rules) / sizeof(peep_rules[0])))
+
+static void peephole(TacFunc *fn) {
+    peep_zero  = tac_intern_int(0);
+    peep_fzero = tac_intern("0.0");
+    peep_nsyms = tac_sym_count;
+    peep_type  = (int *)tac_xrealloc(NULL, sizeof(int) * peep_nsyms);
+    peep_uses  = (int *)calloc(peep_nsyms, sizeof(int));
+    peep_infer_types(fn);
+    for (int i = 0; i < fn->count; i++) {
+        int u[4], n = tac_uses(&fn->code[i], u);
+        for (int k = 0; k < n; k++) peep_uses[u[k]]++;
+    }
+
+    int total = 0, sweeps = 0;
+    for (int r = 0; r < NUM_PEEP_RULES; r++) peep_rules[r].hits = 0;
+    for (int changed = 1; changed; sweeps++) {
+        changed = 0;
+        for (int i = 0; i < fn->count; i++)
+            for (int r = 0; r < NUM_PEEP_RULES; r++)
+                if (fn->code[i].kind != TAC_NOP && peep_rules[r].apply(fn, i)) {
+                    peep_rules[r].hits++;
+                    changed = 1;
+                }
+        if (changed) tac_compact(fn);
+    }
+    for (int r = 0; r < NUM_PEEP_RULES; r++) total += peep_rules[r].hits;
+
+    printf("[peep] %s: %d rewrites in %d sweeps:", fn->name, total, sweeps);
+    for (int r = 0; r < NUM_PEEP_RULES; r++)
+        printf("%s %s %d", r ? "," : "", peep_rules[r].name, peep_rules[r].hits);
+    printf("\n");
+    free(peep_type); free(peep_uses);
+}
+
+//--------------------------------------------------- Register Allocation
+// Linear scan (Poletto & Sarkar) over live intervals of temps in the final
+// instruction order. An interval spans every use and definition and is
+// widened to whole blocks where liveness says the temp is live in or out,
+// so values carried around a loop keep their register for the whole loop.
+// When all registers are busy the interval ending last goes to a stack slot.
+// Int and float temps are scanned separately into their own registers
+// (%rN, %fN) and slots (%sN, %fsN): the backends give every name one type,
+// so a location must never hold both.
+
+typedef struct {
+    int sym;            // Temp being allocated
+    int start, end;     // Instruction positions, inclusive
+    int is_float;       // Register class
+    int loc;            // Register number, or -(slot+1) when spilled
+} LiveInterval;
+
+typedef struct {
+    int temps, peak, spills, nslots;
+} ScanStats;
+
+static int interval_cmp(const void *x, const void *y) {
+    const LiveInterval *a = (const LiveInterval *)x, *b = (const LiveInterval *)y;
+    return a->start != b->start ? a->start - b->start : a->sym - b->sym;
+}
+
+static void interval_touch(LiveInterval *iv, int *index_of, int *n, int sym, int pos) {
+    if (!IS_TEMP(sym)) return;
+    if (index_of[sym] < 0) {
+        index_of[sym] = *n;
+        iv[*n].sym = sym;
+        iv[*n].start = iv[*n].end = pos;
+        (*n)++;
+        return;
+    }
+    LiveInterval *v = &iv[index_of[sym]];
+    if (pos < v->start) v->start = pos;
+    if (pos > v->end)   v->end = pos;
+}
+
+static int loc_symbol(int loc, int is_float) {
+    char buf[32];
+    if (loc >= 0) snprintf(buf, sizeof(buf), "%s%d", is_float ? "%f" : "%r", loc);
+    else          snprintf(buf, sizeof(buf), "%s%d", is_float ? "%fs" : "%s", -loc - 1);
+    return tac_intern(buf);
+}
+
+// Scan the intervals of one class, sorted by start, into nregs registers
+static void linear_scan(LiveInterval *iv, int n, int is_float, int nregs, ScanStats *st) {
+    // Active intervals sorted by increasing end; free registers as a stack
+    int *active    = (int *)tac_xrealloc(NULL, sizeof(int) * (nregs + 1));
+    int *free_regs = (int *)tac_xrealloc(NULL, sizeof(int) * (nregs + 1));
+    int *slot_end  = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    int  nactive = 0, nfree = nregs, live_now = 0;
+    int *ends = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));   // Min-heap of live ends, for pressure
+    for (int r = 0; r < nregs; r++) free_regs[r] = nregs - 1 - r;
+    memset(st, 0, sizeof(*st));
+
+    for (int i = 0; i < n; i++) {
+        LiveInterval *cur = &iv[i];
+        if (cur->is_float != is_float) continue;
+        st->temps++;
+        // Expire intervals that end no later than this start: an operand
+        // read by the defining instruction can hand its register over.
+        while (nactive > 0 && iv[active[0]].end <= cur->start) {
+            free_regs[nfree++] = iv[active[0]].loc;
+            memmove(active, active + 1, sizeof(int) * --nactive);
+        }
+        while (live_now > 0 && ends[0] <= cur->start) {       // Pop heap minimum
+            int x = ends[--live_now], h = 0;
+            for (;;) {
+                int c = h * 2 + 1;
+                if (c >= live_now) break;
+                if (c + 1 < live_now && ends[c + 1] < ends[c]) c++;
+                if (ends[c] >= x) break;
+                ends[h] = ends[c]; h = c;
+            }
+            if (live_now > 0) ends[h] = x;
+        }
+        int h = live_now++;                                    // Push cur->end
+        while (h > 0 && ends[(h - 1) / 2] > cur->end) { ends[h] = ends[(h - 1) / 2]; h = (h - 1) / 2; }
+        ends[h] = cur->end;
+        if (live_now > st->peak) st->peak = live_now;
+
+        int spill = -1;                 // Interval that goes to memory
+        if (nfree > 0) {
+            cur->loc = free_regs[--nfree];
+        } else if (nactive > 0 && iv[active[nactive - 1]].end > cur->end) {
+            spill = active[--nactive];  // Steal the register of the longest-lived
+            cur->loc = iv[spill].loc;
+        } else {
+            spill = i;
+        }
+        if (spill != i) {
+            int pos = nactive;
+            while (pos > 0 && iv[active[pos - 1]].end > cur->end) pos--;
+            memmove(active + pos + 1, active + pos, sizeof(int) * (nactive - pos));
+            active[pos] = i;
+            nactive++;
+        }
+        if (spill >= 0) {
+            int slot = 0;
+            while (slot < st->nslots && slot_end[slot] >= iv[spill].start) slot++;
+            if (slot == st->nslots) st->nslots++;
+            slot_end[slot] = iv[spill].end;
+            iv[spill].loc = -(slot + 1);
+            st->spills++;
+        }
+    }
+    free(active); free(free_regs); free(slot_end); free(ends);
+}
+
+static void register_allocate(TacFunc *fn, int nregs, const TacTypes *ty, int f) {
+    TacCFG      *cfg = tac_get_cfg(fn);
+    TacLiveness *lv  = tac_get_liveness(fn);
+    int nsyms = tac_sym_count;
+    int *index_of = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    LiveInterval *iv = (LiveInterval *)tac_xrealloc(NULL, sizeof(LiveInterval) * (fn->count * 3 + 1));
+    int n = 0;
+    memset(index_of, 0xff, sizeof(int) * nsyms);
+
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        for (int i = bb->start; i < bb->end; i++) {
+            int u[4], nu = tac_uses(&fn->code[i], u);
+            for (int k = 0; k < nu; k++) interval_touch(iv, index_of, &n, u[k], i);
+            interval_touch(iv, index_of, &n, tac_def(&fn->code[i]), i);
+        }
+        if (bb->end == bb->start) continue;
+        for (int k = 0; k < lv->nnames; k++) {
+            int sym = lv->names[k];
+            if (!IS_TEMP(sym)) continue;
+            if (BITSET_TEST(lv->in + (size_t)b * lv->words, k))  interval_touch(iv, index_of, &n, sym, bb->start);
+            if (BITSET_TEST(lv->out + (size_t)b * lv->words, k)) interval_touch(iv, index_of, &n, sym, bb->end - 1);
+        }
+    }
+    for (int i = 0; i < n; i++) iv[i].is_float = tac_type(ty, f, iv[i].sym) == TY_FLOAT;
+    qsort(iv, n, sizeof(LiveInterval), interval_cmp);
+    ScanStats si, sf;
+    linear_scan(iv, n, 0, nregs, &si);
+    linear_scan(iv, n, 1, nregs, &sf);
+
+    // Rewrite temps with their locations
+    int *loc_of = index_of;
+    for (int i = 0; i < n; i++) loc_of[iv[i].sym] = loc_symbol(iv[i].loc, iv[i].is_float);
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        if (IS_TEMP(in->dst)) in->dst = loc_of[in->dst];
+        if (IS_TEMP(in->a))   in->a   = loc_of[in->a];
+        if (IS_TEMP(in->b))   in->b   = loc_of[in->b];
+    }
+    tac_changed(fn);
+
+    printf("[regalloc] %s: %d int and %d float temps, peak pressure %d/%d, %d registers each, "
+           "%d spilled to %d stack slots\n",
+           fn->name, si.temps, sf.temps, si.peak, sf.peak, nregs, si.spills + sf.spills, si.nslots + sf.nslots);
+    free(iv); free(index_of);
+}
+
+//--------------------------------------------------- main
+int main(int argc, char **argv) {
+    int nregs = DEFAULT_REGS;
+    const char *profile = NULL, *input = INPUT_FILE, *output = OUTPUT_FILE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-') {
+            input = argv[i];
+        } else if (strncmp(argv[i], "-regs=", 6) == 0) {
+            nregs = atoi(argv[i] + 6);
+        } else if (strncmp(argv[i], "-unroll=", 8) == 0) {
+            unroll_factor = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "-profile=", 9) == 0) {
+            profile = argv[i] + 9;
+        } else {
+            fprintf(stderr, "Usage: %s [-regs=N] [-unroll=N] [-profile=FILE] [-o out.txt] [file.txt]   "
+                    "(0 disables either; default %s -> %s)\n", argv[0], INPUT_FILE, OUTPUT_FILE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    TacProgram prog = { 0 };
+    tac_load(&prog, input);
+    if (profile) pgo_apply(&prog, profile);
+
+    fold_graph = tac_build_call_graph(&prog);
+    for (int i = 0; i < prog.count; i++) {
+        eliminate_tail_recursion(&prog.funcs[i]);
+        sccp(&prog.funcs[i]);
+        if (fold_pure_calls(&prog, &prog.funcs[i])) sccp(&prog.funcs[i]);
+        value_number(&prog.funcs[i]);
+        copy_optimize(&prog.funcs[i]);
+        loop_invariant_code_motion(&prog.funcs[i]);
+        strength_reduce(&prog.funcs[i]);
+        unroll_loops(&prog.funcs[i]);
+        sccp(&prog.funcs[i]);               // Again, for unrolled copies of constant loops
+        peephole(&prog.funcs[i]);
+        dead_code_eliminate(&prog.funcs[i]);
+    }
+    printf("[pure] %d of %d functions pure, %d of %d calls with literal arguments evaluated at compile time\n",
+           fold_graph->npure, prog.count, fold_done, fold_sites);
+    tac_free_call_graph(fold_graph);
+    printf("[tail] %d self tail calls in %d functions turned into loops\n", tail_done, tail_funcs);
+    remove_unreachable_functions(&prog);
+    renumber_labels(&prog);
+    if (nregs > 0) {
+        TacTypes *ty = tac_infer_types(&prog);
+        for (int i = 0; i < prog.count; i++) register_allocate(&prog.funcs[i], nregs, ty, i);
+        tac_free_types(&prog, ty);
+    }
+
+    FILE *out = fopen(output, "w");
+    if (!out) {
+        perror("Error opening TAC output for write");
+        return EXIT_FAILURE;
+    }
+    tac_print_program(out, &prog);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,726 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define INPUT_FILE    "tac_opt.txt"
+#define VM_STACK_SIZE (1 << 20)     // Value slots shared by all active frames
+#define VM_MAX_ARGS   4096          // Arguments pushed by param and not yet consumed
+
+// Dispatch uses computed goto (direct threading) where the compiler has
+// labels as values; build with -DVM_SWITCH_DISPATCH for the portable switch.
+#if !defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_SWITCH_DISPATCH
+#endif
+
+//--------------------------------------------------- Decoded Program
+// Every function is decoded once into a compact instruction array. Names
+// and constants become slots of a frame: locals (parameters, variables,
+// temps, registers, stack slots) first, then the constants, which are
+// copied in from a template on entry. Jump targets are instruction indices
+// and calls name the callee by index, so nothing is looked up while running.
+// Globals live in vm_globals and get a frame slot in each function that
+// uses them; they are loaded on entry and after a call, and stored before a
+// call and on return, the only points where another function can see them.
+// Arithmetic, relations and fused branches come in an int and a float form
+// that read no type tags, chosen by the TAC operator: the float form for
+// "a *. b", the int form for "a * b". The remaining operators run
+// tag-checking handlers.
+//
+// With -profile every basic block starts with a counter, and the taken edge
+// of each conditional branch goes through a counting jump appended after the
+// code, so block and edge counts come out of the same run. The counts are
+// written as a profile (see tac_ir.h) for the TAC file that was run.
+
+typedef enum {
+    VM_MOV,
+    VM_MOD,
+    VM_AND, VM_OR, VM_SHL, VM_SHR, VM_BAND,
+    VM_NOT, VM_NEG, VM_TOINT, VM_TOFLOAT,
+    VM_JMP, VM_JT, VM_JF,
+    VM_PARAM, VM_CALL, VM_RET, VM_RET0,
+    VM_IADD, VM_ISUB, VM_IMUL, VM_IDIV,                     // Int forms
+    VM_ILT, VM_IGT, VM_ILE, VM_IGE, VM_IEQ, VM_INE,
+    VM_IJLT, VM_IJGT, VM_IJLE, VM_IJGE, VM_IJEQ, VM_IJNE,
+    VM_IJNLT, VM_IJNGT, VM_IJNLE, VM_IJNGE, VM_IJNEQ, VM_IJNNE,
+    VM_FADD, VM_FSUB, VM_FMUL, VM_FDIV,                     // Float forms
+    VM_FLT, VM_FGT, VM_FLE, VM_FGE, VM_FEQ, VM_FNE,
+    VM_FJLT, VM_FJGT, VM_FJLE, VM_FJGE, VM_FJEQ, VM_FJNE,
+    VM_FJNLT, VM_FJNGT, VM_FJNLE, VM_FJNGE, VM_FJNEQ, VM_FJNNE,
+    VM_PROFILE, VM_PROFILE_JMP,                             // Bump counter b (and jump)
+    VM_COUNT
+} VMOp;
+
+typedef struct {
+    union { long i; double f; };
+    int is_float;
+} VMValue;
+
+typedef struct {
+    const void *handler;    // Label address of the opcode (computed goto)
+    int op;                 // VMOp
+    int dst, a, b;          // Frame slots, -1 if unused; b is the argument count of a call
+    int target;             // Instruction index of a jump, function index of a call
+} VMInstr;
+
+typedef struct {
+    const char *name;
+    VMInstr    *code;
+    int         count;
+    int         nslots;     // Locals followed by constants
+    int         nlocals;
+    VMValue    *consts;     // Initial values of the constant slots
+    int        *param_slot;
+    int         nparams;
+    int        *gslot;      // Frame slot and vm_globals index of each global used
+    int        *gindex;
+    int         nglobals;
+    long       *counters;   // With -profile: one per block, then one per conditional branch
+    int         ncounters;
+    TacCFG     *cfg;        // With -profile: the blocks counted
+    int        *taken;      // With -profile: per block, counter of its branch's taken edge or -1
+} VMFunc;
+
+static VMFunc  *vm_funcs;
+static int      vm_func_count;
+static VMValue *vm_globals;
+static VMValue  vm_stack[VM_STACK_SIZE];
+static int      vm_sp = 0;
+static VMValue  vm_args[VM_MAX_ARGS];
+static int      vm_nargs = 0;
+static int      vm_depth = 0;
+static long     vm_executed = 0, vm_calls = 0;
+static int      vm_profile = 0;     // Decode with block and edge counters
+static const void **vm_handlers;    // Label addresses by VMOp, filled by vm_exec(NULL, NULL)
+
+static const int vm_binary_op[OP_COUNT] = {
+    [OP_MOD] = VM_MOD,
+    [OP_AND] = VM_AND, [OP_OR] = VM_OR, [OP_SHL] = VM_SHL, [OP_SHR] = VM_SHR, [OP_BAND] = VM_BAND,
+    [OP_NOT] = VM_NOT, [OP_NEG] = VM_NEG, [OP_TOINT] = VM_TOINT, [OP_TOFLOAT] = VM_TOFLOAT
+};
+
+// Typed forms, [op][0] int and [op][1] float; VM_MOV (0) for operators
+// without a float form, which take vm_binary_op
+static const int vm_typed_op[OP_COUNT][2] = {
+    [OP_ADD] = { VM_IADD, VM_FADD }, [OP_SUB] = { VM_ISUB, VM_FSUB },
+    [OP_MUL] = { VM_IMUL, VM_FMUL }, [OP_DIV] = { VM_IDIV, VM_FDIV },
+    [OP_LT] = { VM_ILT, VM_FLT }, [OP_GT] = { VM_IGT, VM_FGT }, [OP_LE] = { VM_ILE, VM_FLE },
+    [OP_GE] = { VM_IGE, VM_FGE }, [OP_EQ] = { VM_IEQ, VM_FEQ }, [OP_NE] = { VM_INE, VM_FNE }
+};
+
+// Typed fused branches, [op][if][float]
+static const int vm_typed_branch_op[OP_COUNT][2][2] = {
+    [OP_LT] = { { VM_IJNLT, VM_FJNLT }, { VM_IJLT, VM_FJLT } },
+    [OP_GT] = { { VM_IJNGT, VM_FJNGT }, { VM_IJGT, VM_FJGT } },
+    [OP_LE] = { { VM_IJNLE, VM_FJNLE }, { VM_IJLE, VM_FJLE } },
+    [OP_GE] = { { VM_IJNGE, VM_FJNGE }, { VM_IJGE, VM_FJGE } },
+    [OP_EQ] = { { VM_IJNEQ, VM_FJNEQ }, { VM_IJEQ, VM_FJEQ } },
+    [OP_NE] = { { VM_IJNNE, VM_FJNNE }, { VM_IJNE, VM_FJNE } }
+};
+
+static VMValue vm_value(TacValue v) {
+    VMValue r;
+    r.is_float = v.is_float;
+    if (v.is_float) r.f = v.f;
+    else            r.i = v.i;
+    return r;
+}
+
+//--------------------------------------------------- Decoder
+static int vm_func_index(const TacProgram *prog, int sym) {
+    for (int f = 0; f < prog->count; f++)
+        if (strcmp(prog->funcs[f].name, SYM_NAME(sym)) == 0) return f;
+    fprintf(stderr, "Error: call to undefined function '%s'\n", SYM_NAME(sym));
+    exit(EXIT_FAILURE);
+}
+
+// Give sym a slot: pass 0 numbers the locals, pass 1 the constants
+static void vm_slot(VMFunc *vf, int *slot_of, int sym, int pass) {
+    if (sym < 0 || slot_of[sym] >= 0 || IS_CONST(sym) != pass) return;
+    slot_of[sym] = vf->nslots++;
+}
+
+static void vm_decode_func(const TacProgram *prog, int f, VMFunc *vf,
+                           int *slot_of, const int *global_of) {
+    const TacFunc *fn = &prog->funcs[f];
+    int *label_pc = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    vf->name = fn->name;
+    vf->nslots = vf->count = 0;
+    TacCFG *cfg = vm_profile ? tac_build_cfg(fn) : NULL;
+    int nbranches = 0;
+    for (int i = 0; i < fn->count; i++) {
+        int counted = cfg && cfg->blocks[cfg->block_of[i]].start == i;
+        vf->count += counted;
+        if (fn->code[i].kind == TAC_LABEL) label_pc[fn->code[i].label] = vf->count - counted;
+        else if (fn->code[i].kind != TAC_NOP) vf->count++;
+        if (cfg && tac_is_cond_branch(&fn->code[i])) nbranches++;
+    }
+
+    // Slots: parameters first, then the other locals, then constants
+    for (int k = 0; k < fn->nparams; k++) vm_slot(vf, slot_of, fn->params[k], 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < fn->count; i++) {
+            const TacInstr *in = &fn->code[i];
+            vm_slot(vf, slot_of, in->dst, pass);
+            vm_slot(vf, slot_of, in->a, pass);
+            if (in->kind != TAC_CALL) vm_slot(vf, slot_of, in->b, pass);
+        }
+        if (pass == 0) vf->nlocals = vf->nslots;
+    }
+    vf->consts     = (VMValue *)tac_xrealloc(NULL, sizeof(VMValue) * (vf->nslots - vf->nlocals + 1));
+    vf->param_slot = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->nparams + 1));
+    vf->gslot      = (int *)tac_xrealloc(NULL, sizeof(int) * (prog->nglobals + 1));
+    vf->gindex     = (int *)tac_xrealloc(NULL, sizeof(int) * (prog->nglobals + 1));
+    vf->nparams    = fn->nparams;
+    vf->nglobals   = 0;
+    for (int k = 0; k < fn->nparams; k++) vf->param_slot[k] = slot_of[fn->params[k]];
+    for (int g = 0; g < prog->nglobals; g++) {
+        int s = prog->globals[g].sym;
+        if (slot_of[s] < 0) continue;
+        vf->gslot[vf->nglobals]    = slot_of[s];
+        vf->gindex[vf->nglobals++] = global_of[s];
+    }
+
+    // One VM instruction per TAC instruction, plus a return at the end and,
+    // when profiling, the block counters and a counting jump per branch
+    vf->code = (VMInstr *)tac_xrealloc(NULL, sizeof(VMInstr) * (vf->count + nbranches + 1));
+    int *branch_at = (int *)tac_xrealloc(NULL, sizeof(int) * (nbranches + 1));
+    int n = 0, typed[2] = { 0, 0 };
+    nbranches = 0;
+    if (cfg) {
+        vf->taken = (int *)tac_xrealloc(NULL, sizeof(int) * cfg->nblocks);
+        for (int b = 0; b < cfg->nblocks; b++) vf->taken[b] = -1;
+    }
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        if (cfg && cfg->blocks[cfg->block_of[i]].start == i) {
+            VMInstr *c = &vf->code[n++];
+            c->op = VM_PROFILE;
+            c->dst = c->a = c->target = -1;
+            c->b = cfg->block_of[i];
+        }
+        if (in->kind == TAC_LABEL || in->kind == TAC_NOP) continue;
+        VMInstr *out = &vf->code[n++];
+        out->dst    = in->dst >= 0 ? slot_of[in->dst] : -1;
+        out->a      = in->a >= 0 ? slot_of[in->a] : -1;
+        out->b      = in->b >= 0 && in->kind != TAC_CALL ? slot_of[in->b] : -1;
+        out->target = -1;
+        switch (in->kind) {
+            case TAC_COPY:   out->op = VM_MOV; break;
+            case TAC_UNARY:  out->op = vm_binary_op[in->op]; break;
+            case TAC_BINARY: {
+                int form = in->type == TY_FLOAT;
+                out->op = vm_typed_op[in->op][form] ? vm_typed_op[in->op][form] : vm_binary_op[in->op];
+                if (out->op != vm_binary_op[in->op]) typed[form]++;
+                break;
+            }
+            case TAC_GOTO:   out->op = VM_JMP; break;
+            case TAC_IF:
+            case TAC_IFFALSE: {
+                int form = in->type == TY_FLOAT;
+                if (in->op == OP_NONE) out->op = in->kind == TAC_IF ? VM_JT : VM_JF;
+                else {
+                    out->op = vm_typed_branch_op[in->op][in->kind == TAC_IF][form];
+                    typed[form]++;
+                }
+                break;
+            }
+            case TAC_RETURN: out->op = in->a >= 0 ? VM_RET : VM_RET0; break;
+            case TAC_PARAM:  out->op = VM_PARAM; break;
+            case TAC_CALL:
+                out->op     = VM_CALL;
+                out->b      = (int)tac_const_int(in->b);
+                out->target = vm_func_index(prog, in->label);
+                if (out->b != prog->funcs[out->target].nparams) {
+                    fprintf(stderr, "Error: %s calls %s with %d arguments\n", fn->name, SYM_NAME(in->label), out->b);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                fprintf(stderr, "Error: cannot decode instruction in function '%s'\n", fn->name);
+                exit(EXIT_FAILURE);
+        }
+        if (tac_is_jump(in)) out->target = label_pc[in->label];
+        if (cfg && tac_is_cond_branch(in)) {
+            vf->taken[cfg->block_of[i]] = cfg->nblocks + nbranches;
+            branch_at[nbranches++] = n - 1;
+        }
+    }
+    vf->code[n].op = VM_RET0;
+    vf->code[n].dst = vf->code[n].a = vf->code[n].b = vf->code[n].target = -1;
+    vf->count = n + 1;
+    for (int k = 0; k < nbranches; k++) {
+        VMInstr *c = &vf->code[vf->count++], *br = &vf->code[branch_at[k]];
+        c->op = VM_PROFILE_JMP;
+        c->dst = c->a = -1;
+        c->b = cfg->nblocks + k;
+        c->target = br->target;
+        br->target = vf->count - 1;
+    }
+    if (cfg) {
+        vf->cfg       = cfg;
+        vf->ncounters = cfg->nblocks + nbranches;
+        vf->counters  = (long *)calloc(vf->ncounters + 1, sizeof(long));
+    }
+    free(branch_at);
+    for (int k = 0; k < vf->count; k++) vf->code[k].handler = vm_handlers ? vm_handlers[vf->code[k].op] : NULL;
+
+    for (int s = 0; s < tac_sym_count; s++) {
+        if (slot_of[s] < 0) continue;
+        if (slot_of[s] >= vf->nlocals) vf->consts[slot_of[s] - vf->nlocals] = vm_value(tac_const_value(s));
+        slot_of[s] = -1;
+    }
+    printf("[vm] %s: %d instructions decoded, %d slots (%d locals, %d constants), %d globals, "
+           "%d int and %d float forms\n",
+           vf->name, vf->count, vf->nslots, vf->nlocals, vf->nslots - vf->nlocals, vf->nglobals,
+           typed[0], typed[1]);
+    free(label_pc);
+}
+
+static void vm_decode(const TacProgram *prog) {
+    int *slot_of   = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    int *global_of = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    memset(slot_of, 0xff, sizeof(int) * (tac_sym_count + 1));
+    for (int g = 0; g < prog->nglobals; g++) global_of[prog->globals[g].sym] = g;
+    vm_func_count = prog->count;
+    vm_funcs = (VMFunc *)calloc(prog->count + 1, sizeof(VMFunc));
+    // The typed handlers trust the operator forms: reject a program whose
+    // names disagree with them
+    tac_free_types(prog, tac_infer_types(prog));
+    for (int f = 0; f < prog->count; f++)
+        vm_decode_func(prog, f, &vm_funcs[f], slot_of, global_of);
+    vm_globals = (VMValue *)calloc(prog->nglobals + 1, sizeof(VMValue));
+    free(slot_of); free(global_of);
+}
+
+static void vm_reset_globals(const TacProgram *prog) {
+    for (int g = 0; g < prog->nglobals; g++)
+        vm_globals[g] = prog->globals[g].init >= 0 ? vm_value(tac_const_value(prog->globals[g].init))
+                                                   : vm_value(tac_int_value(0));
+}
+
+//--------------------------------------------------- Profile
+// Returns the counter instructions executed, which are not part of the
+// program's own instruction count
+static long vm_reset_counters() {
+    long hits = 0;
+    for (int f = 0; f < vm_func_count; f++)
+        for (int k = 0; k < vm_funcs[f].ncounters; k++) {
+            hits += vm_funcs[f].counters[k];
+            vm_funcs[f].counters[k] = 0;
+        }
+    return hits;
+}
+
+// A branch's fall-through edge is taken whenever its taken edge is not
+static void vm_write_profile(const TacProgram *prog, const char *filename) {
+    TacProfile *prof = (TacProfile *)calloc(1, sizeof(TacProfile));
+    for (int f = 0; f < vm_func_count; f++) {
+        const VMFunc  *vf  = &vm_funcs[f];
+        const TacFunc *fn  = &prog->funcs[f];
+        const TacCFG  *cfg = vf->cfg;
+        TacProfileFunc *pf = tac_profile_add(prof, fn->name, tac_func_hash(fn), cfg->nblocks);
+        int *label_block = tac_label_blocks(fn, cfg);
+        for (int b = 0; b < cfg->nblocks; b++) {
+            const TacBlock *bb = &cfg->blocks[b];
+            long n = vf->counters[b];
+            pf->count[b] = n;
+            if (vf->taken[b] >= 0) {
+                long taken = vf->counters[vf->taken[b]];
+                tac_profile_add_edge(pf, b, label_block[fn->code[bb->end - 1].label], taken);
+                if (b + 1 < cfg->nblocks) tac_profile_add_edge(pf, b, b + 1, n - taken);
+            } else if (bb->nsucc == 1) {
+                tac_profile_add_edge(pf, b, bb->succ[0], n);
+            }
+        }
+        free(label_block);
+    }
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        perror("Error opening profile for write");
+        exit(EXIT_FAILURE);
+    }
+    tac_write_profile(out, prof);
+    fclose(out);
+    tac_free_profile(prof);
+}
+
+//--------------------------------------------------- Interpreter
+// Operators follow tac_eval(); the typed forms skip its tag checks.
+
+#define VM_FLOAT(v) ((v)->is_float ? (v)->f : (double)(v)->i)
+
+#ifdef VM_SWITCH_DISPATCH
+#define VM_OP(op)   case op:
+#define VM_NEXT()   goto dispatch
+#else
+#define VM_OP(op)   do_##op:
+#define VM_NEXT()   do { executed++; goto *pc->handler; } while (0)
+#endif
+
+#define VM_INT_ONLY(op, OPER)                                                   \
+    VM_OP(op) {                                                                 \
+        const VMValue *x = &fp[pc->a], *y = &fp[pc->b];                         \
+        if (x->is_float | y->is_float) tac_runtime_error("integer operator applied to a float", f->name); \
+        fp[pc->dst].i = x->i OPER y->i;                                         \
+        fp[pc->dst].is_float = 0;                                               \
+        pc++;                                                                   \
+        VM_NEXT();                                                              \
+    }
+
+#define VM_TRUE(v) ((v)->is_float ? (v)->f != 0.0 : (v)->i != 0)
+
+// Typed forms: field is i or f, and the decoder has vouched for the tags
+#define VM_TYPED_ARITH(op, field, OPER, float_result)                          \
+    VM_OP(op) {                                                                 \
+        VMValue *d = &fp[pc->dst];                                              \
+        d->field = fp[pc->a].field OPER fp[pc->b].field;                        \
+        d->is_float = float_result;                                             \
+        pc++;                                                                   \
+        VM_NEXT();                                                              \
+    }
+
+#define VM_TYPED_COMPARE(op, field, OPER)                                       \
+    VM_OP(op) {                                                                 \
+        long r = fp[pc->a].field OPER fp[pc->b].field;                          \
+        fp[pc->dst].i = r;                                                      \
+        fp[pc->dst].is_float = 0;                                               \
+        pc++;                                                                   \
+        VM_NEXT();                                                              \
+    }
+
+#define VM_TYPED_BRANCH(op, field, OPER, sense)                                 \
+    VM_OP(op) {                                                                 \
+        pc = (fp[pc->a].field OPER fp[pc->b].field) == sense ? code + pc->target : pc + 1; \
+        VM_NEXT();                                                              \
+    }
+
+// Run f with its arguments in args; vm_exec(NULL, NULL) only publishes
+// the handler addresses for the decoder.
+static VMValue vm_exec(const VMFunc *f, const VMValue *args) {
+#ifndef VM_SWITCH_DISPATCH
+    static const void *labels[VM_COUNT] = {
+        [VM_MOV] = &&do_VM_MOV,
+        [VM_MOD] = &&do_VM_MOD,
+        [VM_AND] = &&do_VM_AND, [VM_OR] = &&do_VM_OR, [VM_SHL] = &&do_VM_SHL,
+        [VM_SHR] = &&do_VM_SHR, [VM_BAND] = &&do_VM_BAND,
+        [VM_NOT] = &&do_VM_NOT, [VM_NEG] = &&do_VM_NEG, [VM_TOINT] = &&do_VM_TOINT,
+        [VM_TOFLOAT] = &&do_VM_TOFLOAT,
+        [VM_JMP] = &&do_VM_JMP, [VM_JT] = &&do_VM_JT, [VM_JF] = &&do_VM_JF,
+        [VM_PARAM] = &&do_VM_PARAM, [VM_CALL] = &&do_VM_CALL,
+        [VM_RET] = &&do_VM_RET, [VM_RET0] = &&do_VM_RET0,
+        [VM_IADD] = &&do_VM_IADD, [VM_ISUB] = &&do_VM_ISUB, [VM_IMUL] = &&do_VM_IMUL,
+        [VM_IDIV] = &&do_VM_IDIV,
+        [VM_ILT] = &&do_VM_ILT, [VM_IGT] = &&do_VM_IGT, [VM_ILE] = &&do_VM_ILE,
+        [VM_IGE] = &&do_VM_IGE, [VM_IEQ] = &&do_VM_IEQ, [VM_INE] = &&do_VM_INE,
+        [VM_IJLT] = &&do_VM_IJLT, [VM_IJGT] = &&do_VM_IJGT, [VM_IJLE] = &&do_VM_IJLE,
+        [VM_IJGE] = &&do_VM_IJGE, [VM_IJEQ] = &&do_VM_IJEQ, [VM_IJNE] = &&do_VM_IJNE,
+        [VM_IJNLT] = &&do_VM_IJNLT, [VM_IJNGT] = &&do_VM_IJNGT, [VM_IJNLE] = &&do_VM_IJNLE,
+        [VM_IJNGE] = &&do_VM_IJNGE, [VM_IJNEQ] = &&do_VM_IJNEQ, [VM_IJNNE] = &&do_VM_IJNNE,
+        [VM_FADD] = &&do_VM_FADD, [VM_FSUB] = &&do_VM_FSUB, [VM_FMUL] = &&do_VM_FMUL,
+        [VM_FDIV] = &&do_VM_FDIV,
+        [VM_FLT] = &&do_VM_FLT, [VM_FGT] = &&do_VM_FGT, [VM_FLE] = &&do_VM_FLE,
+        [VM_FGE] = &&do_VM_FGE, [VM_FEQ] = &&do_VM_FEQ, [VM_FNE] = &&do_VM_FNE,
+        [VM_FJLT] = &&do_VM_FJLT, [VM_FJGT] = &&do_VM_FJGT, [VM_FJLE] = &&do_VM_FJLE,
+        [VM_FJGE] = &&do_VM_FJGE, [VM_FJEQ] = &&do_VM_FJEQ, [VM_FJNE] = &&do_VM_FJNE,
+        [VM_FJNLT] = &&do_VM_FJNLT, [VM_FJNGT] = &&do_VM_FJNGT, [VM_FJNLE] = &&do_VM_FJNLE,
+        [VM_FJNGE] = &&do_VM_FJNGE, [VM_FJNEQ] = &&do_VM_FJNEQ, [VM_FJNNE] = &&do_VM_FJNNE,
+        [VM_PROFILE] = &&do_VM_PROFILE, [VM_PROFILE_JMP] = &&do_VM_PROFILE_JMP
+    };
+#endif
+    if (!f) {
+#ifndef VM_SWITCH_DISPATCH
+        vm_handlers = labels;
+#endif
+        return vm_value(tac_int_value(0));
+    }
+    if (++vm_depth > TAC_MAX_CALL_DEPTH) tac_runtime_error("call stack overflow", f->name);
+    if (vm_sp + f->nslots > VM_STACK_SIZE) tac_runtime_error("VM stack overflow", f->name);
+
+    VMValue *fp = vm_stack + vm_sp;
+    vm_sp += f->nslots;
+    memset(fp, 0, sizeof(VMValue) * f->nlocals);
+    memcpy(fp + f->nlocals, f->consts, sizeof(VMValue) * (f->nslots - f->nlocals));
+    for (int k = 0; k < f->nparams; k++) fp[f->param_slot[k]] = args[k];
+    for (int k = 0; k < f->nglobals; k++) fp[f->gslot[k]] = vm_globals[f->gindex[k]];
+
+    const VMInstr *code = f->code, *pc = code;
+    long executed = 0;
+    VMValue ret;
+
+#ifdef VM_SWITCH_DISPATCH
+dispatch:
+    executed++;
+    switch (pc->op) {
+#else
+    VM_NEXT();
+#endif
+
+    VM_OP(VM_MOV)
+        fp[pc->dst] = fp[pc->a];
+        pc++;
+        VM_NEXT();
+
+    VM_OP(VM_MOD) {
+        const VMValue *x = &fp[pc->a], *y = &fp[pc->b];
+        if (x->is_float | y->is_float) tac_runtime_error("integer operator applied to a float", f->name);
+        if (y->i == 0) tac_runtime_error("division by zero", f->name);
+        fp[pc->dst].i = x->i % y->i;
+        fp[pc->dst].is_float = 0;
+        pc++;
+        VM_NEXT();
+    }
+
+    VM_INT_ONLY(VM_SHL, <<)
+    VM_INT_ONLY(VM_SHR, >>)
+    VM_INT_ONLY(VM_BAND, &)
+
+    VM_OP(VM_AND) {
+        long r = VM_TRUE(&fp[pc->a]) && VM_TRUE(&fp[pc->b]);
+        fp[pc->dst].i = r;
+        fp[pc->dst].is_float = 0;
+        pc++;
+        VM_NEXT();
+    }
+    VM_OP(VM_OR) {
+        long r = VM_TRUE(&fp[pc->a]) || VM_TRUE(&fp[pc->b]);
+        fp[pc->dst].i = r;
+        fp[pc->dst].is_float = 0;
+        pc++;
+        VM_NEXT();
+    }
+    VM_OP(VM_NOT) {
+        long r = !VM_TRUE(&fp[pc->a]);
+        fp[pc->dst].i = r;
+        fp[pc->dst].is_float = 0;
+        pc++;
+        VM_NEXT();
+    }
+    VM_OP(VM_NEG) {
+        const VMValue *x = &fp[pc->a];
+        VMValue *d = &fp[pc->dst];
+        if (x->is_float) d->f = -x->f;
+        else             d->i = -x->i;
+        d->is_float = x->is_float;
+        pc++;
+        VM_NEXT();
+    }
+    VM_OP(VM_TOINT) {
+        const VMValue *x = &fp[pc->a];
+        VMValue *d = &fp[pc->dst];
+        d->i = x->is_float ? (long)x->f : x->i;
+        d->is_float = 0;
+        pc++;
+        VM_NEXT();
+    }
+    VM_OP(VM_TOFLOAT) {
+        const VMValue *x = &fp[pc->a];
+        VMValue *d = &fp[pc->dst];
+        d->f = VM_FLOAT(x);
+        d->is_float = 1;
+        pc++;
+        VM_NEXT();
+    }
+
+    VM_OP(VM_JMP)
+        pc = code + pc->target;
+        VM_NEXT();
+    VM_OP(VM_JT)
+        pc = VM_TRUE(&fp[pc->a]) ? code + pc->target : pc + 1;
+        VM_NEXT();
+    VM_OP(VM_JF)
+        pc = VM_TRUE(&fp[pc->a]) ? pc + 1 : code + pc->target;
+        VM_NEXT();
+
+    VM_TYPED_ARITH(VM_IADD, i, +, 0)
+    VM_TYPED_ARITH(VM_ISUB, i, -, 0)
+    VM_TYPED_ARITH(VM_IMUL, i, *, 0)
+    VM_OP(VM_IDIV) {
+        if (fp[pc->b].i == 0) tac_runtime_error("division by zero", f->name);
+        fp[pc->dst].i = fp[pc->a].i / fp[pc->b].i;
+        fp[pc->dst].is_float = 0;
+        pc++;
+        VM_NEXT();
+    }
+    VM_TYPED_COMPARE(VM_ILT, i, <)
+    VM_TYPED_COMPARE(VM_IGT, i, >)
+    VM_TYPED_COMPARE(VM_ILE, i, <=)
+    VM_TYPED_COMPARE(VM_IGE, i, >=)
+    VM_TYPED_COMPARE(VM_IEQ, i, ==)
+    VM_TYPED_COMPARE(VM_INE, i, !=)
+    VM_TYPED_BRANCH(VM_IJLT, i, <, 1)
+    VM_TYPED_BRANCH(VM_IJGT, i, >, 1)
+    VM_TYPED_BRANCH(VM_IJLE, i, <=, 1)
+    VM_TYPED_BRANCH(VM_IJGE, i, >=, 1)
+    VM_TYPED_BRANCH(VM_IJEQ, i, ==, 1)
+    VM_TYPED_BRANCH(VM_IJNE, i, !=, 1)
+    VM_TYPED_BRANCH(VM_IJNLT, i, <, 0)
+    VM_TYPED_BRANCH(VM_IJNGT, i, >, 0)
+    VM_TYPED_BRANCH(VM_IJNLE, i, <=, 0)
+    VM_TYPED_BRANCH(VM_IJNGE, i, >=, 0)
+    VM_TYPED_BRANCH(VM_IJNEQ, i, ==, 0)
+    VM_TYPED_BRANCH(VM_IJNNE, i, !=, 0)
+
+    VM_TYPED_ARITH(VM_FADD, f, +, 1)
+    VM_TYPED_ARITH(VM_FSUB, f, -, 1)
+    VM_TYPED_ARITH(VM_FMUL, f, *, 1)
+    VM_TYPED_ARITH(VM_FDIV, f, /, 1)
+    VM_TYPED_COMPARE(VM_FLT, f, <)
+    VM_TYPED_COMPARE(VM_FGT, f, >)
+    VM_TYPED_COMPARE(VM_FLE, f, <=)
+    VM_TYPED_COMPARE(VM_FGE, f, >=)
+    VM_TYPED_COMPARE(VM_FEQ, f, ==)
+    VM_TYPED_COMPARE(VM_FNE, f, !=)
+    VM_TYPED_BRANCH(VM_FJLT, f, <, 1)
+    VM_TYPED_BRANCH(VM_FJGT, f, >, 1)
+    VM_TYPED_BRANCH(VM_FJLE, f, <=, 1)
+    VM_TYPED_BRANCH(VM_FJGE, f, >=, 1)
+    VM_TYPED_BRANCH(VM_FJEQ, f, ==, 1)
+    VM_TYPED_BRANCH(VM_FJNE, f, !=, 1)
+    VM_TYPED_BRANCH(VM_FJNLT, f, <, 0)
+    VM_TYPED_BRANCH(VM_FJNGT, f, >, 0)
+    VM_TYPED_BRANCH(VM_FJNLE, f, <=, 0)
+    VM_TYPED_BRANCH(VM_FJNGE, f, >=, 0)
+    VM_TYPED_BRANCH(VM_FJNEQ, f, ==, 0)
+    VM_TYPED_BRANCH(VM_FJNNE, f, !=, 0)
+
+    VM_OP(VM_PROFILE)
+        f->counters[pc->b]++;
+        pc++;
+        VM_NEXT();
+    VM_OP(VM_PROFILE_JMP)
+        f->counters[pc->b]++;
+        pc = code + pc->target;
+        VM_NEXT();
+
+    VM_OP(VM_PARAM)
+        if (vm_nargs >= VM_MAX_ARGS) tac_runtime_error("too many pending arguments", f->name);
+        vm_args[vm_nargs++] = fp[pc->a];
+        pc++;
+        VM_NEXT();
+
+    VM_OP(VM_CALL) {
+        for (int k = 0; k < f->nglobals; k++) vm_globals[f->gindex[k]] = fp[f->gslot[k]];
+        vm_nargs -= pc->b;
+        vm_calls++;
+        VMValue r = vm_exec(&vm_funcs[pc->target], vm_args + vm_nargs);
+        for (int k = 0; k < f->nglobals; k++) fp[f->gslot[k]] = vm_globals[f->gindex[k]];
+        if (pc->dst >= 0) fp[pc->dst] = r;
+        pc++;
+        VM_NEXT();
+    }
+
+    VM_OP(VM_RET)
+        ret = fp[pc->a];
+        goto leave;
+    VM_OP(VM_RET0)
+        ret = vm_value(tac_int_value(0));
+        goto leave;
+
+#ifdef VM_SWITCH_DISPATCH
+        default:
+            tac_runtime_error("bad opcode", f->name);
+    }
+#endif
+
+leave:
+    for (int k = 0; k < f->nglobals; k++) vm_globals[f->gindex[k]] = fp[f->gslot[k]];
+    vm_sp -= f->nslots;
+    vm_depth--;
+    vm_executed += executed;
+    return ret;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------- main
+int main(int argc, char **argv) {
+    const char *input = INPUT_FILE, *profile = NULL;
+    int runs = 1, check = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = atoi(argv[i] + 6);
+        } else if (strcmp(argv[i], "-check") == 0) {
+            check = 1;
+        } else if (strncmp(argv[i], "-profile=", 9) == 0) {
+            profile = argv[i] + 9;
+        } else if (argv[i][0] != '-') {
+            input = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-runs=N] [-check] [-profile=FILE] [file.txt]   (default %s)\n",
+                    argv[0], INPUT_FILE);
+            return EXIT_FAILURE;
+        }
+    }
+    if (runs < 1) runs = 1;
+
+    TacProgram prog = { 0 };
+    tac_load(&prog, input);
+    const TacFunc *main_fn = tac_find_func(&prog, "main");
+    if (!main_fn) {
+        fprintf(stderr, "Error: %s has no function 'main'\n", input);
+        return EXIT_FAILURE;
+    }
+    vm_exec(NULL, NULL);
+    vm_profile = profile != NULL;
+    double t0 = now_sec();
+    vm_decode(&prog);
+    double t1 = now_sec();
+    const VMFunc *entry = &vm_funcs[main_fn - prog.funcs];
+
+    VMValue r = vm_value(tac_int_value(0));
+    double best = 0.0;
+    long executed = 0, calls = 0;
+    for (int k = 0; k < runs; k++) {
+        vm_reset_globals(&prog);
+        vm_reset_counters();
+        vm_executed = vm_calls = 0;
+        double s0 = now_sec();
+        r = vm_exec(entry, NULL);
+        double s = now_sec() - s0;
+        if (k == 0 || s < best) best = s;
+        executed = vm_executed;
+        calls = vm_calls;
+    }
+    if (profile) {
+        vm_write_profile(&prog, profile);
+        long hits = vm_reset_counters();
+        executed -= hits;
+        printf("[vm] profile: wrote %s (%d functions, %ld counter hits)\n", profile, prog.count, hits);
+    }
+
+#ifdef VM_SWITCH_DISPATCH
+    const char *dispatch = "switch";
+#else
+    const char *dispatch = "computed-goto";
+#endif
+    if (r.is_float) printf("[vm] main returned %g\n", r.f);
+    else            printf("[vm] main returned %ld\n", r.i);
+    printf("[vm] %s dispatch: %ld instructions executed, %ld calls, decode %.3f ms, "
+           "best of %d runs %.3f ms, %.2f ns/instruction\n",
+           dispatch, executed, calls, (t1 - t0) * 1e3, runs, best * 1e3,
+           executed ? best * 1e9 / executed : 0.0);
+
+    // Same program on the reference interpreter: result and count must match
+    if (check) {
+        TacValue  *env = tac_env_new(&prog);
+        TacRunStats st = { 0 };
+        TacValue   ref = tac_run(&prog, main_fn, env, &st);
+        int same = ref.is_float == r.is_float && (ref.is_float ? ref.f == r.f : ref.i == r.i);
+        if (!same || st.executed != executed) {
+            fprintf(stderr, "Error: reference interpreter returned %g after %ld instructions\n",
+                    ref.is_float ? ref.f : (double)ref.i, st.executed);
+            return EXIT_FAILURE;
+        }
+        printf("[vm] check: reference interpreter agrees (%ld instructions)\n", st.executed);
+        free(env);
+    }
+    return 0;
+}
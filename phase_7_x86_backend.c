@@ -0,0 +1,1189 @@
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define INPUT_FILE  "tac_opt.txt"
+#define OUTPUT_FILE "out.s"
+#define OBJECT_FILE "out.o"
+
+//--------------------------------------------------- Helpers
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------- Types
+// Static int/float types of every name, inferred over the whole program
+static TacTypes *x86_types;
+
+static int x86_type(int f, int sym) {
+    return tac_type(x86_types, f, sym);
+}
+
+//--------------------------------------------------- Machine Instructions
+// Instruction selection produces a list of x86-64 instructions per function
+// with symbolic labels, data references and callees. The assembly printer
+// below writes it as GNU assembler text.
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Condition codes, numbered as in the Jcc/SETcc encodings
+enum { CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A, CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G };
+
+typedef enum {
+    X_LABEL,                    // Pseudo: target label defined here
+    X_MOV, X_MOVABS,
+    X_ADD, X_SUB, X_IMUL, X_AND, X_OR, X_XOR, X_CMP, X_TEST,
+    X_NEG, X_SAL, X_SAR,        // Shifts by %cl
+    X_CQO, X_IDIV,
+    X_SETCC, X_MOVZB,           // setcc %al; movzbq %al, %rax
+    X_JMP, X_JCC, X_CALL, X_TAIL, X_RET, X_PUSH, X_LEAVE,   // X_TAIL: jmp to a function
+    X_MOVSD, X_ADDSD, X_SUBSD, X_MULSD, X_DIVSD, X_UCOMISD, X_XORPD,
+    X_CVTSI2SD, X_CVTTSD2SI,
+    X_COUNT
+} X86Mnemonic;
+
+typedef enum { XO_NONE, XO_REG, XO_XMM, XO_IMM, XO_MEM, XO_DATA } X86OperandKind;
+
+typedef struct {
+    X86OperandKind kind;
+    int  reg;           // Register; base register of XO_MEM
+    long val;           // Immediate, displacement, or data symbol index
+} X86Operand;
+
+typedef struct {
+    X86Mnemonic mn;
+    int         cc;         // Condition of X_JCC/X_SETCC
+    X86Operand  dst, src;   // Operands in Intel order; the printer swaps them
+    int         target;     // Label of a jump or X_LABEL, function of a call
+} X86Instr;
+
+typedef struct {
+    const char *name;
+    X86Instr   *code;
+    int         count, capacity;
+    int         nlabels;
+    int         frame;      // Bytes below %rbp
+    int         tac_count;  // TAC instructions lowered
+    int         tail_calls; // Calls lowered to jumps
+    int         offset;     // Position of the encoded function in the text
+    int         size;       // Encoded bytes
+    double      sec;        // Time spent selecting and encoding
+} X86Func;
+
+// Data the code refers to: globals, float literals and the sign mask
+typedef struct {
+    char     name[72];
+    uint64_t bits[2];
+    int      words;         // 1, or 2 for the 16-byte aligned sign mask
+    int      is_global;     // Program global: exported, lives in .data
+} X86Data;
+
+static X86Func *x86_funcs;
+static int      x86_nfuncs;
+static X86Data *x86_data;
+static int      x86_ndata, x86_data_cap;
+static int     *x86_data_of;        // Symbol -> data index, -1 if none
+static int      x86_negmask = -1;
+
+static X86Operand x86_reg(int r)  { X86Operand o = { XO_REG, r, 0 };      return o; }
+static X86Operand x86_xmm(int r)  { X86Operand o = { XO_XMM, r, 0 };      return o; }
+static X86Operand x86_imm(long v) { X86Operand o = { XO_IMM, -1, v };     return o; }
+static X86Operand x86_none()      { X86Operand o = { XO_NONE, -1, 0 };    return o; }
+static X86Operand x86_data_ref(int d) { X86Operand o = { XO_DATA, -1, d }; return o; }
+static X86Operand x86_mem(int base, long disp) { X86Operand o = { XO_MEM, base, disp }; return o; }
+
+static X86Instr *x86_emit(X86Func *xf, X86Mnemonic mn, X86Operand dst, X86Operand src) {
+    if (xf->count >= xf->capacity) {
+        xf->capacity = xf->capacity ? xf->capacity * 2 : 64;
+        xf->code = (X86Instr *)tac_xrealloc(xf->code, sizeof(X86Instr) * xf->capacity);
+    }
+    X86Instr *in = &xf->code[xf->count++];
+    in->mn = mn;
+    in->cc = -1;
+    in->dst = dst;
+    in->src = src;
+    in->target = -1;
+    return in;
+}
+
+static void x86_jump(X86Func *xf, X86Mnemonic mn, int cc, int label) {
+    X86Instr *in = x86_emit(xf, mn, x86_none(), x86_none());
+    in->cc = cc;
+    in->target = label;
+}
+
+static int x86_add_data(const char *name, uint64_t bits, int is_global) {
+    if (x86_ndata >= x86_data_cap) {
+        x86_data_cap = x86_data_cap ? x86_data_cap * 2 : 32;
+        x86_data = (X86Data *)tac_xrealloc(x86_data, sizeof(X86Data) * x86_data_cap);
+    }
+    X86Data *d = &x86_data[x86_ndata];
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    d->bits[0] = bits;
+    d->bits[1] = 0;
+    d->words = 1;
+    d->is_global = is_global;
+    return x86_ndata++;
+}
+
+static uint64_t x86_double_bits(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+// Data symbol holding the value of a float literal or a global
+static int x86_data_for(int sym) {
+    if (x86_data_of[sym] < 0) {
+        char name[32];
+        snprintf(name, sizeof(name), ".LC%d", x86_ndata);
+        x86_data_of[sym] = x86_add_data(name, x86_double_bits(strtod(SYM_NAME(sym), NULL)), 0);
+    }
+    return x86_data_of[sym];
+}
+
+//--------------------------------------------------- Instruction Selection
+// Every local name lives in a stack slot below %rbp; an instruction loads
+// its operands into %rax/%rcx (ints) or %xmm0/%xmm1 (floats), computes and
+// stores the result. Calls follow the System V ABI: the first six int
+// arguments in %rdi..%r9, the first eight floats in %xmm0..%xmm7, the rest
+// on the stack, results in %rax or %xmm0.
+
+static const int x86_int_args[6] = { RDI, RSI, RDX, RCX, R8, R9 };
+
+static int *x86_slot_of;            // Symbol -> frame offset (negative), 0 if none
+static int *x86_label_of;           // TAC label symbol -> machine label
+
+static X86Operand x86_home(int sym) {
+    if (IS_GLOBAL(sym)) return x86_data_ref(x86_data_of[sym]);
+    return x86_mem(RBP, x86_slot_of[sym]);
+}
+
+// Load sym as an int into GPR r
+static void x86_load_int(X86Func *xf, int f, int r, int sym) {
+    if (IS_CONST(sym) && tac_is_int_const(sym)) {
+        long v = tac_const_int(sym);
+        if (v == (int32_t)v) x86_emit(xf, X_MOV, x86_reg(r), x86_imm(v));
+        else                 x86_emit(xf, X_MOVABS, x86_reg(r), x86_imm(v));
+    } else if (x86_type(f, sym) == TY_FLOAT) {
+        X86Operand src = IS_CONST(sym) ? x86_data_ref(x86_data_for(sym)) : x86_home(sym);
+        x86_emit(xf, X_CVTTSD2SI, x86_reg(r), src);
+    } else {
+        x86_emit(xf, X_MOV, x86_reg(r), x86_home(sym));
+    }
+}
+
+// Load sym as a float into XMM register x (ints are converted)
+static void x86_load_float(X86Func *xf, int f, int x, int sym) {
+    if (x86_type(f, sym) == TY_FLOAT) {
+        x86_emit(xf, X_MOVSD, x86_xmm(x), IS_CONST(sym) ? x86_data_ref(x86_data_for(sym)) : x86_home(sym));
+    } else {
+        x86_load_int(xf, f, RAX, sym);
+        x86_emit(xf, X_CVTSI2SD, x86_xmm(x), x86_reg(RAX));
+    }
+}
+
+// Store a value of type t held in %rax or %xmm0 into sym, converting to its type
+static void x86_store(X86Func *xf, int f, int sym, int t) {
+    int want = x86_type(f, sym);
+    if (want == TY_FLOAT && t != TY_FLOAT) x86_emit(xf, X_CVTSI2SD, x86_xmm(0), x86_reg(RAX));
+    if (want != TY_FLOAT && t == TY_FLOAT) x86_emit(xf, X_CVTTSD2SI, x86_reg(RAX), x86_xmm(0));
+    if (want == TY_FLOAT) x86_emit(xf, X_MOVSD, x86_home(sym), x86_xmm(0));
+    else                  x86_emit(xf, X_MOV, x86_home(sym), x86_reg(RAX));
+}
+
+// Int condition codes by relation; floats compare unsigned-style after
+// ucomisd with the operands arranged so "below" means unordered-or-less
+static int x86_int_cc(TacOp op) {
+    static const int cc[OP_COUNT] = {
+        [OP_LT] = CC_L, [OP_GT] = CC_G, [OP_LE] = CC_LE, [OP_GE] = CC_GE, [OP_EQ] = CC_E, [OP_NE] = CC_NE
+    };
+    return cc[op];
+}
+
+// Evaluate the relation a op b into %al (0 or 1), comparing floats for the
+// float form of the operator and ints otherwise
+static void x86_relation(X86Func *xf, int f, const TacInstr *in) {
+    TacOp op = in->op;
+    int a = in->a, b = in->b;
+    if (in->type != TY_FLOAT) {
+        x86_load_int(xf, f, RAX, a);
+        x86_load_int(xf, f, RCX, b);
+        x86_emit(xf, X_CMP, x86_reg(RAX), x86_reg(RCX));
+        x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = x86_int_cc(op);
+        return;
+    }
+    x86_load_float(xf, f, 0, a);
+    x86_load_float(xf, f, 1, b);
+    switch (op) {
+        case OP_LT:     // b > a: false when unordered
+        case OP_LE:
+            x86_emit(xf, X_UCOMISD, x86_xmm(1), x86_xmm(0));
+            x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = op == OP_LT ? CC_A : CC_AE;
+            break;
+        case OP_GT:
+        case OP_GE:
+            x86_emit(xf, X_UCOMISD, x86_xmm(0), x86_xmm(1));
+            x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = op == OP_GT ? CC_A : CC_AE;
+            break;
+        default:        // == needs ZF and no parity, != either
+            x86_emit(xf, X_UCOMISD, x86_xmm(0), x86_xmm(1));
+            x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = op == OP_EQ ? CC_E : CC_NE;
+            x86_emit(xf, X_SETCC, x86_reg(RCX), x86_none())->cc = op == OP_EQ ? CC_NP : CC_P;
+            x86_emit(xf, op == OP_EQ ? X_AND : X_OR, x86_reg(RAX), x86_reg(RCX));
+            break;
+    }
+}
+
+// Truth of sym into the flags: ZF set when it is zero
+static void x86_test(X86Func *xf, int f, int sym) {
+    if (x86_type(f, sym) == TY_FLOAT) {
+        x86_load_float(xf, f, 0, sym);
+        x86_emit(xf, X_XORPD, x86_xmm(1), x86_xmm(1));
+        x86_emit(xf, X_UCOMISD, x86_xmm(0), x86_xmm(1));
+        x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = CC_NE;
+        x86_emit(xf, X_SETCC, x86_reg(RCX), x86_none())->cc = CC_P;
+        x86_emit(xf, X_OR, x86_reg(RAX), x86_reg(RCX));
+        x86_emit(xf, X_MOVZB, x86_reg(RAX), x86_none());
+    } else {
+        x86_load_int(xf, f, RAX, sym);
+    }
+    x86_emit(xf, X_TEST, x86_reg(RAX), x86_reg(RAX));
+}
+
+static void x86_binary(X86Func *xf, int f, const TacInstr *in) {
+    TacOp op = in->op;
+    if (tac_is_relop(op)) {
+        x86_relation(xf, f, in);
+        x86_emit(xf, X_MOVZB, x86_reg(RAX), x86_none());
+        x86_store(xf, f, in->dst, TY_INT);
+        return;
+    }
+    if (op == OP_AND || op == OP_OR) {
+        x86_test(xf, f, in->b);
+        x86_emit(xf, X_SETCC, x86_reg(RDX), x86_none())->cc = CC_NE;
+        x86_test(xf, f, in->a);
+        x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = CC_NE;
+        x86_emit(xf, op == OP_AND ? X_AND : X_OR, x86_reg(RAX), x86_reg(RDX));
+        x86_emit(xf, X_MOVZB, x86_reg(RAX), x86_none());
+        x86_store(xf, f, in->dst, TY_INT);
+        return;
+    }
+    if (in->type == TY_FLOAT) {
+        static const X86Mnemonic fop[OP_COUNT] = {
+            [OP_ADD] = X_ADDSD, [OP_SUB] = X_SUBSD, [OP_MUL] = X_MULSD, [OP_DIV] = X_DIVSD
+        };
+        x86_load_float(xf, f, 0, in->a);
+        x86_load_float(xf, f, 1, in->b);
+        x86_emit(xf, fop[op], x86_xmm(0), x86_xmm(1));
+        x86_store(xf, f, in->dst, TY_FLOAT);
+        return;
+    }
+    x86_load_int(xf, f, RAX, in->a);
+    x86_load_int(xf, f, RCX, in->b);
+    switch (op) {
+        case OP_ADD:  x86_emit(xf, X_ADD, x86_reg(RAX), x86_reg(RCX)); break;
+        case OP_SUB:  x86_emit(xf, X_SUB, x86_reg(RAX), x86_reg(RCX)); break;
+        case OP_MUL:  x86_emit(xf, X_IMUL, x86_reg(RAX), x86_reg(RCX)); break;
+        case OP_BAND: x86_emit(xf, X_AND, x86_reg(RAX), x86_reg(RCX)); break;
+        case OP_SHL:  x86_emit(xf, X_SAL, x86_reg(RAX), x86_none()); break;
+        case OP_SHR:  x86_emit(xf, X_SAR, x86_reg(RAX), x86_none()); break;
+        case OP_DIV:
+        case OP_MOD:
+            x86_emit(xf, X_CQO, x86_none(), x86_none());
+            x86_emit(xf, X_IDIV, x86_reg(RCX), x86_none());
+            if (op == OP_MOD) x86_emit(xf, X_MOV, x86_reg(RAX), x86_reg(RDX));
+            break;
+        default:
+            fprintf(stderr, "Error: no x86 lowering for operator '%s'\n", tac_op_names[op]);
+            exit(EXIT_FAILURE);
+    }
+    x86_store(xf, f, in->dst, TY_INT);
+}
+
+static void x86_unary(X86Func *xf, int f, const TacInstr *in) {
+    switch (in->op) {
+        case OP_NOT:
+            x86_test(xf, f, in->a);
+            x86_emit(xf, X_SETCC, x86_reg(RAX), x86_none())->cc = CC_E;
+            x86_emit(xf, X_MOVZB, x86_reg(RAX), x86_none());
+            x86_store(xf, f, in->dst, TY_INT);
+            break;
+        case OP_NEG:
+            if (x86_type(f, in->a) == TY_FLOAT) {
+                if (x86_negmask < 0) {
+                    x86_negmask = x86_add_data(".LCneg", (uint64_t)1 << 63, 0);
+                    x86_data[x86_negmask].words = 2;
+                }
+                x86_load_float(xf, f, 0, in->a);
+                x86_emit(xf, X_XORPD, x86_xmm(0), x86_data_ref(x86_negmask));
+                x86_store(xf, f, in->dst, TY_FLOAT);
+            } else {
+                x86_load_int(xf, f, RAX, in->a);
+                x86_emit(xf, X_NEG, x86_reg(RAX), x86_none());
+                x86_store(xf, f, in->dst, TY_INT);
+            }
+            break;
+        case OP_TOINT:
+            x86_load_int(xf, f, RAX, in->a);
+            x86_store(xf, f, in->dst, TY_INT);
+            break;
+        case OP_TOFLOAT:
+            x86_load_float(xf, f, 0, in->a);
+            x86_store(xf, f, in->dst, TY_FLOAT);
+            break;
+        default:
+            fprintf(stderr, "Error: no x86 lowering for operator '%s'\n", tac_op_names[in->op]);
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Conditional branch: jump to label when the condition is (kind == TAC_IF)
+static void x86_branch(X86Func *xf, int f, const TacInstr *in) {
+    int sense = in->kind == TAC_IF, label = x86_label_of[in->label];
+    if (in->op == OP_NONE) {
+        x86_test(xf, f, in->a);
+        x86_jump(xf, X_JCC, sense ? CC_NE : CC_E, label);
+    } else if (in->type != TY_FLOAT) {
+        // Compare and branch on the flags directly; the condition codes
+        // come in pairs whose low bit negates them
+        x86_load_int(xf, f, RAX, in->a);
+        x86_load_int(xf, f, RCX, in->b);
+        x86_emit(xf, X_CMP, x86_reg(RAX), x86_reg(RCX));
+        x86_jump(xf, X_JCC, x86_int_cc(in->op) ^ !sense, label);
+    } else {
+        x86_relation(xf, f, in);
+        x86_emit(xf, X_MOVZB, x86_reg(RAX), x86_none());
+        x86_emit(xf, X_TEST, x86_reg(RAX), x86_reg(RAX));
+        x86_jump(xf, X_JCC, sense ? CC_NE : CC_E, label);
+    }
+}
+
+// Does function f return its result in %xmm0? main always returns an int
+static int x86_returns_float(const TacProgram *prog, int f) {
+    return x86_types->ret[f] == TY_FLOAT && strcmp(prog->funcs[f].name, "main") != 0;
+}
+
+// A call at i whose result is returned straight away can end the caller:
+// it pops its own frame and jumps, and the callee returns to the caller's
+// caller. Every argument must travel in a register, since stack arguments
+// would be written into the frame being popped, and the result must come
+// back in the register and type the caller returns it in.
+static int x86_tail_call(const TacProgram *prog, int f, int i) {
+    const TacFunc  *fn = &prog->funcs[f];
+    const TacInstr *in = &fn->code[i];
+    const TacFunc  *callee = tac_find_func(prog, SYM_NAME(in->label));
+    int c = (int)(callee - prog->funcs), n = (int)tac_const_int(in->b), j = i + 1;
+    if (in->dst < 0) return 0;
+    while (j < fn->count && fn->code[j].kind == TAC_LABEL) j++;
+    if (j >= fn->count || fn->code[j].kind != TAC_RETURN || fn->code[j].a != in->dst) return 0;
+    int nint = 0, nfloat = 0;
+    for (int k = 0; k < n; k++) {
+        if (x86_types->param[c][k] == TY_FLOAT) nfloat++;
+        else                                    nint++;
+    }
+    if (nint > 6 || nfloat > 8) return 0;
+    int result_float = x86_returns_float(prog, c);
+    return result_float == x86_returns_float(prog, f) && result_float == (x86_type(f, in->dst) == TY_FLOAT);
+}
+
+// Arguments are the operands of the n params before the call; a tail call
+// (see above) leaves the frame and jumps instead
+static void x86_call(X86Func *xf, const TacProgram *prog, int f, const TacInstr *in, const int *args, int tail) {
+    const TacFunc *callee = tac_find_func(prog, SYM_NAME(in->label));
+    int c = (int)(callee - prog->funcs), n = (int)tac_const_int(in->b);
+    int nint = 0, nfloat = 0, nstack = 0;
+    int *on_stack = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    for (int k = 0; k < n; k++) {
+        if (x86_types->param[c][k] == TY_FLOAT ? nfloat++ >= 8 : nint++ >= 6) on_stack[nstack++] = k;
+    }
+    // Stack arguments right to left, keeping %rsp 16-byte aligned at the call
+    int pad = nstack % 2 ? 8 : 0;
+    if (pad) x86_emit(xf, X_SUB, x86_reg(RSP), x86_imm(pad));
+    for (int s = nstack - 1; s >= 0; s--) {
+        int k = on_stack[s];
+        if (x86_types->param[c][k] == TY_FLOAT) {
+            x86_load_float(xf, f, 0, args[k]);
+            x86_emit(xf, X_SUB, x86_reg(RSP), x86_imm(8));
+            x86_emit(xf, X_MOVSD, x86_mem(RSP, 0), x86_xmm(0));
+        } else {
+            x86_load_int(xf, f, RAX, args[k]);
+            x86_emit(xf, X_PUSH, x86_reg(RAX), x86_none());
+        }
+    }
+    // Floats first: loading an int argument never touches %xmm0..%xmm7
+    nint = nfloat = 0;
+    for (int k = 0; k < n; k++)
+        if (x86_types->param[c][k] == TY_FLOAT && nfloat < 8) x86_load_float(xf, f, nfloat++, args[k]);
+    for (int k = 0; k < n; k++)
+        if (x86_types->param[c][k] != TY_FLOAT && nint < 6) x86_load_int(xf, f, x86_int_args[nint++], args[k]);
+    if (tail) {
+        x86_emit(xf, X_LEAVE, x86_none(), x86_none());
+        x86_emit(xf, X_TAIL, x86_none(), x86_none())->target = c;
+        xf->tail_calls++;
+        free(on_stack);
+        return;
+    }
+    x86_emit(xf, X_CALL, x86_none(), x86_none())->target = c;
+    if (nstack || pad) x86_emit(xf, X_ADD, x86_reg(RSP), x86_imm(8 * nstack + pad));
+    if (in->dst >= 0) x86_store(xf, f, in->dst, x86_types->ret[c]);
+    free(on_stack);
+}
+
+static void x86_return(X86Func *xf, int f, int sym) {
+    int is_main = strcmp(xf->name, "main") == 0;
+    if (sym < 0)                                         x86_emit(xf, X_XOR, x86_reg(RAX), x86_reg(RAX));
+    else if (x86_types->ret[f] == TY_FLOAT && !is_main)       x86_load_float(xf, f, 0, sym);
+    else                                                 x86_load_int(xf, f, RAX, sym);
+    x86_emit(xf, X_LEAVE, x86_none(), x86_none());
+    x86_emit(xf, X_RET, x86_none(), x86_none());
+}
+
+static void x86_select(const TacProgram *prog, int f, X86Func *xf) {
+    const TacFunc *fn = &prog->funcs[f];
+    memset(xf, 0, sizeof(*xf));
+    xf->name = fn->name;
+    xf->tac_count = fn->count;
+
+    // Frame slots for every local name, parameters first
+    int frame = 0;
+    for (int k = 0; k < fn->nparams; k++)
+        if (!x86_slot_of[fn->params[k]]) x86_slot_of[fn->params[k]] = -(frame += 8);
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        int syms[3] = { in->dst, in->a, in->kind == TAC_CALL ? -1 : in->b };
+        for (int k = 0; k < 3; k++)
+            if (tac_is_name(syms[k]) && !IS_GLOBAL(syms[k]) && !x86_slot_of[syms[k]])
+                x86_slot_of[syms[k]] = -(frame += 8);
+        if (in->kind == TAC_LABEL) x86_label_of[in->label] = xf->nlabels++;
+    }
+    xf->frame = (frame + 15) & ~15;
+
+    // Prologue: save the incoming arguments in their slots
+    x86_emit(xf, X_PUSH, x86_reg(RBP), x86_none());
+    x86_emit(xf, X_MOV, x86_reg(RBP), x86_reg(RSP));
+    if (xf->frame) x86_emit(xf, X_SUB, x86_reg(RSP), x86_imm(xf->frame));
+    int nint = 0, nfloat = 0, nstack = 0;
+    for (int k = 0; k < fn->nparams; k++) {
+        X86Operand home = x86_mem(RBP, x86_slot_of[fn->params[k]]);
+        if (x86_types->param[f][k] == TY_FLOAT) {
+            if (nfloat < 8) {
+                x86_emit(xf, X_MOVSD, home, x86_xmm(nfloat++));
+                continue;
+            }
+            x86_emit(xf, X_MOVSD, x86_xmm(0), x86_mem(RBP, 16 + 8 * nstack++));
+            x86_emit(xf, X_MOVSD, home, x86_xmm(0));
+        } else {
+            if (nint < 6) {
+                x86_emit(xf, X_MOV, home, x86_reg(x86_int_args[nint++]));
+                continue;
+            }
+            x86_emit(xf, X_MOV, x86_reg(RAX), x86_mem(RBP, 16 + 8 * nstack++));
+            x86_emit(xf, X_MOV, home, x86_reg(RAX));
+        }
+    }
+
+    // Names that may be read before they are assigned start out as 0, as
+    // in the interpreter (0.0 has the same bits)
+    TacCFG *cfg = tac_build_cfg(fn);
+    if (cfg->nblocks > 0) {
+        TacLiveness *lv = tac_build_liveness(fn, cfg);
+        for (int k = 0; k < lv->nnames; k++) {
+            int sym = lv->names[k], is_param = 0;
+            for (int p = 0; p < fn->nparams; p++) is_param |= fn->params[p] == sym;
+            if (!is_param && !IS_GLOBAL(sym) && tac_live_in(lv, 0, sym))
+                x86_emit(xf, X_MOV, x86_home(sym), x86_imm(0));
+        }
+        tac_free_liveness(lv);
+    }
+    tac_free_cfg(cfg);
+
+    int *args = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    int nargs = 0;
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        switch (in->kind) {
+            case TAC_LABEL:
+                x86_emit(xf, X_LABEL, x86_none(), x86_none())->target = x86_label_of[in->label];
+                break;
+            case TAC_COPY:
+                if (x86_type(f, in->dst) == TY_FLOAT) {
+                    x86_load_float(xf, f, 0, in->a);
+                    x86_store(xf, f, in->dst, TY_FLOAT);
+                } else {
+                    x86_load_int(xf, f, RAX, in->a);
+                    x86_store(xf, f, in->dst, TY_INT);
+                }
+                break;
+            case TAC_UNARY:   x86_unary(xf, f, in); break;
+            case TAC_BINARY:  x86_binary(xf, f, in); break;
+            case TAC_GOTO:    x86_jump(xf, X_JMP, -1, x86_label_of[in->label]); break;
+            case TAC_IF:
+            case TAC_IFFALSE: x86_branch(xf, f, in); break;
+            case TAC_RETURN:  x86_return(xf, f, in->a); break;
+            case TAC_PARAM:   args[nargs++] = in->a; break;
+            case TAC_CALL: {
+                int n = (int)tac_const_int(in->b);
+                nargs -= n;
+                x86_call(xf, prog, f, in, args + nargs, x86_tail_call(prog, f, i));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    // Falling off the end returns 0
+    if (xf->count == 0 || xf->code[xf->count - 1].mn != X_RET) x86_return(xf, f, -1);
+
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        int syms[3] = { in->dst, in->a, in->b };
+        for (int k = 0; k < 3; k++) if (syms[k] >= 0) x86_slot_of[syms[k]] = 0;
+    }
+    for (int k = 0; k < fn->nparams; k++) x86_slot_of[fn->params[k]] = 0;
+    free(args);
+}
+
+static void x86_compile(const TacProgram *prog) {
+    x86_types = tac_infer_types(prog);
+    x86_slot_of  = (int *)calloc(tac_sym_count + 1, sizeof(int));
+    x86_label_of = (int *)calloc(tac_sym_count + 1, sizeof(int));
+    x86_data_of  = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    memset(x86_data_of, 0xff, sizeof(int) * (tac_sym_count + 1));
+    for (int g = 0; g < prog->nglobals; g++) {
+        const TacGlobal *gl = &prog->globals[g];
+        uint64_t bits = 0;
+        if (gl->init >= 0)
+            bits = x86_types->global[gl->sym] == TY_FLOAT ? x86_double_bits(strtod(SYM_NAME(gl->init), NULL))
+                                                  : (uint64_t)strtol(SYM_NAME(gl->init), NULL, 10);
+        x86_data_of[gl->sym] = x86_add_data(SYM_NAME(gl->sym), bits, 1);
+    }
+    x86_nfuncs = prog->count;
+    x86_funcs = (X86Func *)calloc(prog->count + 1, sizeof(X86Func));
+    for (int f = 0; f < prog->count; f++) {
+        double t0 = now_sec();
+        x86_select(prog, f, &x86_funcs[f]);
+        x86_funcs[f].sec = now_sec() - t0;
+        if (x86_funcs[f].tail_calls)
+            printf("[tail] %s: %d tail calls turned into jumps\n", x86_funcs[f].name, x86_funcs[f].tail_calls);
+    }
+}
+
+//--------------------------------------------------- Assembly Printer
+static const char *x86_reg_names[16] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+static const char *x86_byte_names[16] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+};
+static const char *x86_cc_names[16] = {
+    "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"
+};
+static const char *x86_mnemonics[X_COUNT] = {
+    "", "movq", "movabsq", "addq", "subq", "imulq", "andq", "orq", "xorq", "cmpq", "testq",
+    "negq", "salq", "sarq", "cqto", "idivq", "set", "movzbq", "jmp", "j", "call", "jmp", "ret",
+    "pushq", "leave", "movsd", "addsd", "subsd", "mulsd", "divsd", "ucomisd", "xorpd",
+    "cvtsi2sdq", "cvttsd2siq"
+};
+
+static void x86_print_operand(FILE *out, X86Operand o) {
+    switch (o.kind) {
+        case XO_REG:  fprintf(out, "%%%s", x86_reg_names[o.reg]); break;
+        case XO_XMM:  fprintf(out, "%%xmm%d", o.reg); break;
+        case XO_IMM:  fprintf(out, "$%ld", o.val); break;
+        case XO_MEM:  fprintf(out, "%ld(%%%s)", o.val, x86_reg_names[o.reg]); break;
+        case XO_DATA: fprintf(out, "%s(%%rip)", x86_data[o.val].name); break;
+        default:      break;
+    }
+}
+
+// Returns the number of instructions written (labels excluded)
+static int x86_print_func(FILE *out, const X86Func *xf, int f) {
+    int n = 0;
+    fprintf(out, "\n\t.globl %s\n\t.type %s, @function\n%s:\n", xf->name, xf->name, xf->name);
+    for (int i = 0; i < xf->count; i++) {
+        const X86Instr *in = &xf->code[i];
+        switch (in->mn) {
+            case X_LABEL:
+                fprintf(out, ".L%d_%d:\n", f, in->target);
+                continue;
+            case X_JMP:
+                fprintf(out, "\tjmp .L%d_%d\n", f, in->target);
+                break;
+            case X_JCC:
+                fprintf(out, "\tj%s .L%d_%d\n", x86_cc_names[in->cc], f, in->target);
+                break;
+            case X_CALL:
+            case X_TAIL:
+                fprintf(out, "\t%s %s\n", x86_mnemonics[in->mn], x86_funcs[in->target].name);
+                break;
+            case X_SETCC:
+                fprintf(out, "\tset%s %%%s\n", x86_cc_names[in->cc], x86_byte_names[in->dst.reg]);
+                break;
+            case X_MOVZB:
+                fprintf(out, "\tmovzbq %%al, %%rax\n");
+                break;
+            case X_SAL:
+            case X_SAR:
+                fprintf(out, "\t%s %%cl, %%rax\n", x86_mnemonics[in->mn]);
+                break;
+            default:
+                // AT&T order: source first
+                fprintf(out, "\t%s", x86_mnemonics[in->mn]);
+                if (in->src.kind != XO_NONE) {
+                    fprintf(out, " ");
+                    x86_print_operand(out, in->src);
+                    fprintf(out, ",");
+                }
+                if (in->dst.kind != XO_NONE) {
+                    fprintf(out, " ");
+                    x86_print_operand(out, in->dst);
+                }
+                fprintf(out, "\n");
+                break;
+        }
+        n++;
+    }
+    fprintf(out, "\t.size %s, .-%s\n", xf->name, xf->name);
+    return n;
+}
+
+static void x86_print_program(FILE *out, const char *source) {
+    fprintf(out, "# Generated from %s\n", source);
+    fprintf(out, "\t.text\n");
+    for (int f = 0; f < x86_nfuncs; f++) {
+        int n = x86_print_func(out, &x86_funcs[f], f);
+        printf("[x86] %s: %d TAC instructions -> %d machine instructions, frame %d bytes\n",
+               x86_funcs[f].name, x86_funcs[f].tac_count, n, x86_funcs[f].frame);
+    }
+    for (int d = 0; d < x86_ndata; d++) {
+        const X86Data *x = &x86_data[d];
+        if (x->is_global) fprintf(out, "\n\t.data\n\t.globl %s\n\t.align 8\n%s:\n", x->name, x->name);
+        else              fprintf(out, "\n\t.section .rodata\n\t.align %d\n%s:\n", 8 * x->words, x->name);
+        for (int w = 0; w < x->words; w++) fprintf(out, "\t.quad 0x%016llx\n", (unsigned long long)x->bits[w]);
+    }
+    fprintf(out, "\t.section .note.GNU-stack,\"\",@progbits\n");
+}
+
+//--------------------------------------------------- Machine Code Encoder
+// Encodes the instruction lists into one x86-64 text buffer. Jumps are
+// resolved within each function (always rel32); calls and %rip-relative
+// data references become relocations for the JIT or object writer to patch.
+
+enum { XR_CALL, XR_DATA };
+
+typedef struct {
+    int offset;         // Position of the rel32 field in the text
+    int kind;           // XR_CALL or XR_DATA
+    int target;         // Function or data index
+} X86Reloc;
+
+static unsigned char *x86_text;
+static int            x86_text_size, x86_text_cap;
+static X86Reloc      *x86_relocs;
+static int            x86_nrelocs, x86_reloc_cap;
+
+static void x86_byte(int b) {
+    if (x86_text_size >= x86_text_cap) {
+        x86_text_cap = x86_text_cap ? x86_text_cap * 2 : 4096;
+        x86_text = (unsigned char *)tac_xrealloc(x86_text, x86_text_cap);
+    }
+    x86_text[x86_text_size++] = (unsigned char)b;
+}
+
+static void x86_word32(uint32_t v) {
+    for (int k = 0; k < 4; k++) x86_byte((v >> (8 * k)) & 0xff);
+}
+
+static void x86_put32(int at, uint32_t v) {
+    for (int k = 0; k < 4; k++) x86_text[at + k] = (v >> (8 * k)) & 0xff;
+}
+
+// Placeholder rel32 field, patched once the target's address is known
+static void x86_reloc(int kind, int target) {
+    if (x86_nrelocs >= x86_reloc_cap) {
+        x86_reloc_cap = x86_reloc_cap ? x86_reloc_cap * 2 : 64;
+        x86_relocs = (X86Reloc *)tac_xrealloc(x86_relocs, sizeof(X86Reloc) * x86_reloc_cap);
+    }
+    X86Reloc *r = &x86_relocs[x86_nrelocs++];
+    r->offset = x86_text_size;
+    r->kind = kind;
+    r->target = target;
+    x86_word32(0);
+}
+
+// [prefix] [REX] opcode ModRM [SIB] [disp]: reg goes in ModRM.reg, the
+// operand rm in ModRM.rm. Memory operands are based on %rbp or %rsp.
+static void x86_modrm(int prefix, int w, const char *opcode, int reg, X86Operand rm) {
+    int base = rm.kind == XO_DATA ? 0 : rm.reg;
+    int rex = 0x40 | w << 3 | (reg >= 8) << 2 | (base >= 8);
+    if (prefix) x86_byte(prefix);
+    if (rex != 0x40) x86_byte(rex);
+    for (const char *c = opcode; *c; c++) x86_byte((unsigned char)*c);
+    switch (rm.kind) {
+        case XO_REG:
+        case XO_XMM:
+            x86_byte(0xc0 | (reg & 7) << 3 | (rm.reg & 7));
+            break;
+        case XO_MEM: {
+            int disp8 = rm.val == (int8_t)rm.val;
+            x86_byte((disp8 ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7));
+            if ((base & 7) == RSP) x86_byte(0x24);
+            if (disp8) x86_byte((int)rm.val & 0xff);
+            else       x86_word32((uint32_t)rm.val);
+            break;
+        }
+        case XO_DATA:
+            x86_byte(0x05 | (reg & 7) << 3);
+            x86_reloc(XR_DATA, (int)rm.val);
+            break;
+        default:
+            fprintf(stderr, "Error: bad operand in x86 encoder\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Two-operand integer ALU instructions: opcode of "op r/m, reg" and the
+// ModRM extension of the immediate form
+static const struct { int opcode, ext; } x86_alu[X_COUNT] = {
+    [X_ADD] = { 0x01, 0 }, [X_OR]  = { 0x09, 1 }, [X_AND] = { 0x21, 4 },
+    [X_SUB] = { 0x29, 5 }, [X_XOR] = { 0x31, 6 }, [X_CMP] = { 0x39, 7 },
+};
+
+// Scalar double instructions as F2/66 0F <op> xmm, xmm/m64
+static const struct { int prefix, op; } x86_sse[X_COUNT] = {
+    [X_ADDSD] = { 0xf2, 0x58 }, [X_MULSD] = { 0xf2, 0x59 }, [X_SUBSD] = { 0xf2, 0x5c },
+    [X_DIVSD] = { 0xf2, 0x5e }, [X_UCOMISD] = { 0x66, 0x2e }, [X_XORPD] = { 0x66, 0x57 },
+};
+
+static void x86_encode_func(X86Func *xf) {
+    int *label_at = (int *)tac_xrealloc(NULL, sizeof(int) * (xf->nlabels + 1));
+    int *jump_at  = (int *)tac_xrealloc(NULL, sizeof(int) * (xf->count + 1));
+    int *jump_to  = (int *)tac_xrealloc(NULL, sizeof(int) * (xf->count + 1));
+    int  njumps = 0;
+    xf->offset = x86_text_size;
+    for (int i = 0; i < xf->count; i++) {
+        const X86Instr *in = &xf->code[i];
+        char op[3] = { 0 };
+        switch (in->mn) {
+            case X_LABEL:
+                label_at[in->target] = x86_text_size;
+                break;
+            case X_MOV:
+                if (in->src.kind == XO_IMM) {
+                    x86_modrm(0, 1, "\xc7", 0, in->dst);
+                    x86_word32((uint32_t)in->src.val);
+                } else if (in->dst.kind == XO_REG && in->src.kind != XO_REG) {
+                    x86_modrm(0, 1, "\x8b", in->dst.reg, in->src);
+                } else {
+                    x86_modrm(0, 1, "\x89", in->src.reg, in->dst);
+                }
+                break;
+            case X_MOVABS:
+                x86_byte(0x48 | (in->dst.reg >= 8));
+                x86_byte(0xb8 + (in->dst.reg & 7));
+                x86_word32((uint32_t)in->src.val);
+                x86_word32((uint32_t)((uint64_t)in->src.val >> 32));
+                break;
+            case X_ADD: case X_SUB: case X_AND: case X_OR: case X_XOR: case X_CMP:
+                if (in->src.kind == XO_IMM) {
+                    int imm8 = in->src.val == (int8_t)in->src.val;
+                    x86_modrm(0, 1, imm8 ? "\x83" : "\x81", x86_alu[in->mn].ext, in->dst);
+                    if (imm8) x86_byte((int)in->src.val & 0xff);
+                    else      x86_word32((uint32_t)in->src.val);
+                } else {
+                    op[0] = (char)x86_alu[in->mn].opcode;
+                    x86_modrm(0, 1, op, in->src.reg, in->dst);
+                }
+                break;
+            case X_TEST: x86_modrm(0, 1, "\x85", in->src.reg, in->dst); break;
+            case X_IMUL: x86_modrm(0, 1, "\x0f\xaf", in->dst.reg, in->src); break;
+            case X_NEG:  x86_modrm(0, 1, "\xf7", 3, in->dst); break;
+            case X_IDIV: x86_modrm(0, 1, "\xf7", 7, in->dst); break;
+            case X_SAL:  x86_modrm(0, 1, "\xd3", 4, in->dst); break;
+            case X_SAR:  x86_modrm(0, 1, "\xd3", 7, in->dst); break;
+            case X_CQO:
+                x86_byte(0x48);
+                x86_byte(0x99);
+                break;
+            case X_SETCC:
+                op[0] = 0x0f;
+                op[1] = (char)(0x90 + in->cc);
+                x86_modrm(0, 0, op, 0, in->dst);
+                break;
+            case X_MOVZB:
+                x86_modrm(0, 1, "\x0f\xb6", RAX, x86_reg(RAX));
+                break;
+            case X_JMP:
+            case X_JCC:
+                if (in->mn == X_JMP) {
+                    x86_byte(0xe9);
+                } else {
+                    x86_byte(0x0f);
+                    x86_byte(0x80 + in->cc);
+                }
+                jump_at[njumps] = x86_text_size;
+                jump_to[njumps++] = in->target;
+                x86_word32(0);
+                break;
+            case X_CALL:
+            case X_TAIL:
+                x86_byte(in->mn == X_CALL ? 0xe8 : 0xe9);
+                x86_reloc(XR_CALL, in->target);
+                break;
+            case X_RET:   x86_byte(0xc3); break;
+            case X_LEAVE: x86_byte(0xc9); break;
+            case X_PUSH:
+                if (in->dst.reg >= 8) x86_byte(0x41);
+                x86_byte(0x50 + (in->dst.reg & 7));
+                break;
+            case X_MOVSD:
+                if (in->dst.kind == XO_XMM) x86_modrm(0xf2, 0, "\x0f\x10", in->dst.reg, in->src);
+                else                        x86_modrm(0xf2, 0, "\x0f\x11", in->src.reg, in->dst);
+                break;
+            case X_ADDSD: case X_SUBSD: case X_MULSD: case X_DIVSD: case X_UCOMISD: case X_XORPD:
+                op[0] = 0x0f;
+                op[1] = (char)x86_sse[in->mn].op;
+                x86_modrm(x86_sse[in->mn].prefix, 0, op, in->dst.reg, in->src);
+                break;
+            case X_CVTSI2SD:  x86_modrm(0xf2, 1, "\x0f\x2a", in->dst.reg, in->src); break;
+            case X_CVTTSD2SI: x86_modrm(0xf2, 1, "\x0f\x2c", in->dst.reg, in->src); break;
+            default:
+                fprintf(stderr, "Error: no encoding for x86 instruction %d\n", in->mn);
+                exit(EXIT_FAILURE);
+        }
+    }
+    for (int j = 0; j < njumps; j++) x86_put32(jump_at[j], (uint32_t)(label_at[jump_to[j]] - (jump_at[j] + 4)));
+    xf->size = x86_text_size - xf->offset;
+    while (x86_text_size % 16) x86_byte(0xcc);     // Pad to the next function with int3
+    free(label_at);
+    free(jump_at);
+    free(jump_to);
+}
+
+static void x86_encode_program() {
+    for (int f = 0; f < x86_nfuncs; f++) {
+        double t0 = now_sec();
+        x86_encode_func(&x86_funcs[f]);
+        x86_funcs[f].sec += now_sec() - t0;
+    }
+}
+
+// Offset of every data item from the start of the data, aligned to its
+// size; returns the total size
+static size_t x86_layout_data(size_t *at) {
+    size_t size = 0;
+    for (int d = 0; d < x86_ndata; d++) {
+        size_t align = 8 * x86_data[d].words;
+        size = (size + align - 1) & ~(align - 1);
+        at[d] = size;
+        size += 8 * x86_data[d].words;
+    }
+    return size;
+}
+
+//--------------------------------------------------- ELF Object Writer
+// Writes the encoded program as an ELF64 relocatable object: functions in
+// .text, program globals in .data, float literals and the sign mask in
+// .rodata. Functions and globals are global symbols; calls get PLT32 and
+// data references PC32 relocations, the .rodata ones against the section
+// symbol as the assembler does for local labels.
+
+typedef struct {
+    unsigned char *bytes;
+    size_t         size, cap;
+} X86Buffer;
+
+static size_t x86_buf_add(X86Buffer *b, const void *p, size_t n) {
+    if (b->size + n > b->cap) {
+        while (b->size + n > b->cap) b->cap = b->cap ? b->cap * 2 : 256;
+        b->bytes = (unsigned char *)tac_xrealloc(b->bytes, b->cap);
+    }
+    size_t at = b->size;
+    if (p) memcpy(b->bytes + at, p, n);
+    else   memset(b->bytes + at, 0, n);
+    b->size += n;
+    return at;
+}
+
+static void x86_buf_align(X86Buffer *b, size_t align) {
+    while (b->size % align) x86_buf_add(b, NULL, 1);
+}
+
+static size_t x86_buf_str(X86Buffer *b, const char *s) {
+    return x86_buf_add(b, s, strlen(s) + 1);
+}
+
+// Section indices in the header table
+enum { SEC_NULL, SEC_TEXT, SEC_DATA, SEC_RODATA, SEC_SYMTAB, SEC_STRTAB, SEC_RELA, SEC_SHSTRTAB, SEC_NOTE, SEC_COUNT };
+
+static void x86_write_object(const char *path) {
+    X86Buffer data = { 0 }, rodata = { 0 }, syms = { 0 }, strs = { 0 }, rela = { 0 }, shstrs = { 0 };
+    size_t *data_at = (size_t *)tac_xrealloc(NULL, sizeof(size_t) * (x86_ndata + 1));
+    int *data_sym   = (int *)tac_xrealloc(NULL, sizeof(int) * (x86_ndata + 1));
+    int *func_sym   = (int *)tac_xrealloc(NULL, sizeof(int) * (x86_nfuncs + 1));
+    for (int d = 0; d < x86_ndata; d++) {
+        X86Buffer *sec = x86_data[d].is_global ? &data : &rodata;
+        x86_buf_align(sec, 8 * x86_data[d].words);
+        data_at[d] = x86_buf_add(sec, x86_data[d].bits, 8 * x86_data[d].words);
+    }
+
+    // Symbols: the null symbol and the .rodata section symbol are local,
+    // then functions and globals
+    Elf64_Sym sym = { 0 };
+    x86_buf_str(&strs, "");
+    x86_buf_add(&syms, &sym, sizeof(sym));
+    sym.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    sym.st_shndx = SEC_RODATA;
+    x86_buf_add(&syms, &sym, sizeof(sym));
+    int first_global = 2, nsyms = 2;
+    for (int f = 0; f < x86_nfuncs; f++) {
+        memset(&sym, 0, sizeof(sym));
+        sym.st_name = (Elf64_Word)x86_buf_str(&strs, x86_funcs[f].name);
+        sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        sym.st_shndx = SEC_TEXT;
+        sym.st_value = x86_funcs[f].offset;
+        sym.st_size = x86_funcs[f].size;
+        x86_buf_add(&syms, &sym, sizeof(sym));
+        func_sym[f] = nsyms++;
+    }
+    for (int d = 0; d < x86_ndata; d++) {
+        data_sym[d] = 1;
+        if (!x86_data[d].is_global) continue;
+        memset(&sym, 0, sizeof(sym));
+        sym.st_name = (Elf64_Word)x86_buf_str(&strs, x86_data[d].name);
+        sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+        sym.st_shndx = SEC_DATA;
+        sym.st_value = data_at[d];
+        sym.st_size = 8;
+        x86_buf_add(&syms, &sym, sizeof(sym));
+        data_sym[d] = nsyms++;
+    }
+
+    // rel32 counts from the end of the field, hence the -4
+    for (int r = 0; r < x86_nrelocs; r++) {
+        const X86Reloc *rl = &x86_relocs[r];
+        Elf64_Rela ra = { 0 };
+        ra.r_offset = rl->offset;
+        if (rl->kind == XR_CALL) {
+            ra.r_info = ELF64_R_INFO(func_sym[rl->target], R_X86_64_PLT32);
+            ra.r_addend = -4;
+        } else {
+            ra.r_info = ELF64_R_INFO(data_sym[rl->target], R_X86_64_PC32);
+            ra.r_addend = (x86_data[rl->target].is_global ? 0 : (Elf64_Sxword)data_at[rl->target]) - 4;
+        }
+        x86_buf_add(&rela, &ra, sizeof(ra));
+    }
+
+    // File: header, section contents, then the section header table
+    static const char *names[SEC_COUNT] = {
+        "", ".text", ".data", ".rodata", ".symtab", ".strtab", ".rela.text", ".shstrtab", ".note.GNU-stack"
+    };
+    Elf64_Shdr sh[SEC_COUNT];
+    memset(sh, 0, sizeof(sh));
+    for (int s = 0; s < SEC_COUNT; s++) sh[s].sh_name = (Elf64_Word)x86_buf_str(&shstrs, names[s]);
+    struct { int sec, type, flags, align; const void *bytes; size_t size; } layout[] = {
+        { SEC_TEXT,     SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16, x86_text,     (size_t)x86_text_size },
+        { SEC_DATA,     SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,      8, data.bytes,   data.size },
+        { SEC_RODATA,   SHT_PROGBITS, SHF_ALLOC,                 16, rodata.bytes, rodata.size },
+        { SEC_SYMTAB,   SHT_SYMTAB,   0,                          8, syms.bytes,   syms.size },
+        { SEC_STRTAB,   SHT_STRTAB,   0,                          1, strs.bytes,   strs.size },
+        { SEC_RELA,     SHT_RELA,     SHF_INFO_LINK,              8, rela.bytes,   rela.size },
+        { SEC_SHSTRTAB, SHT_STRTAB,   0,                          1, shstrs.bytes, shstrs.size },
+        { SEC_NOTE,     SHT_PROGBITS, 0,                          1, NULL,         0 },
+    };
+    X86Buffer file = { 0 };
+    Elf64_Ehdr eh = { 0 };
+    x86_buf_add(&file, &eh, sizeof(eh));
+    for (int k = 0; k < (int)(sizeof(layout) / sizeof(layout[0])); k++) {
+        Elf64_Shdr *s = &sh[layout[k].sec];
+        x86_buf_align(&file, layout[k].align);
+        s->sh_type = layout[k].type;
+        s->sh_flags = layout[k].flags;
+        s->sh_addralign = layout[k].align;
+        s->sh_offset = file.size;
+        s->sh_size = layout[k].size;
+        if (layout[k].size) x86_buf_add(&file, layout[k].bytes, layout[k].size);
+    }
+    sh[SEC_SYMTAB].sh_link = SEC_STRTAB;
+    sh[SEC_SYMTAB].sh_info = first_global;
+    sh[SEC_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+    sh[SEC_RELA].sh_link = SEC_SYMTAB;
+    sh[SEC_RELA].sh_info = SEC_TEXT;
+    sh[SEC_RELA].sh_entsize = sizeof(Elf64_Rela);
+    x86_buf_align(&file, 8);
+    size_t shoff = x86_buf_add(&file, sh, sizeof(sh));
+
+    memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS] = ELFCLASS64;
+    eh.e_ident[EI_DATA] = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    eh.e_type = ET_REL;
+    eh.e_machine = EM_X86_64;
+    eh.e_version = EV_CURRENT;
+    eh.e_shoff = shoff;
+    eh.e_ehsize = sizeof(Elf64_Ehdr);
+    eh.e_shentsize = sizeof(Elf64_Shdr);
+    eh.e_shnum = SEC_COUNT;
+    eh.e_shstrndx = SEC_SHSTRTAB;
+    memcpy(file.bytes, &eh, sizeof(eh));
+
+    FILE *out = fopen(path, "wb");
+    if (!out || fwrite(file.bytes, 1, file.size, out) != file.size) {
+        perror("Error writing object file");
+        exit(EXIT_FAILURE);
+    }
+    fclose(out);
+    printf("[elf] %s: %d bytes of text, %zu of data, %zu of rodata, %d symbols, %d relocations, %zu bytes\n",
+           path, x86_text_size, data.size, rodata.size, nsyms, x86_nrelocs, file.size);
+    free(data.bytes); free(rodata.bytes); free(syms.bytes); free(strs.bytes);
+    free(rela.bytes); free(shstrs.bytes); free(file.bytes);
+    free(data_at); free(data_sym); free(func_sym);
+}
+
+//--------------------------------------------------- JIT
+// The text and the data share one anonymous mapping so every rel32 reaches:
+// the text pages come first and turn read+execute once the relocations are
+// patched; the data pages after them stay read+write for the globals.
+
+static unsigned char *x86_jit_base;
+static size_t         x86_jit_size;
+
+static unsigned char *x86_jit_load() {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t *data_at = (size_t *)tac_xrealloc(NULL, sizeof(size_t) * (x86_ndata + 1));
+    size_t text_size = ((size_t)x86_text_size + page - 1) & ~(page - 1);
+    size_t data_size = (x86_layout_data(data_at) + page - 1) & ~(page - 1);
+    x86_jit_size = text_size + data_size;
+    x86_jit_base = (unsigned char *)mmap(NULL, x86_jit_size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (x86_jit_base == MAP_FAILED) {
+        perror("Error mapping JIT memory");
+        exit(EXIT_FAILURE);
+    }
+    unsigned char *data = x86_jit_base + text_size;
+    memcpy(x86_jit_base, x86_text, x86_text_size);
+    for (int d = 0; d < x86_ndata; d++) memcpy(data + data_at[d], x86_data[d].bits, 8 * x86_data[d].words);
+
+    // rel32 counts from the end of the field
+    for (int r = 0; r < x86_nrelocs; r++) {
+        const X86Reloc *rl = &x86_relocs[r];
+        unsigned char *field = x86_jit_base + rl->offset;
+        unsigned char *target = rl->kind == XR_CALL ? x86_jit_base + x86_funcs[rl->target].offset
+                                                    : data + data_at[rl->target];
+        int32_t rel = (int32_t)(target - (field + 4));
+        memcpy(field, &rel, sizeof(rel));
+    }
+    if (mprotect(x86_jit_base, text_size, PROT_READ | PROT_EXEC) != 0) {
+        perror("Error making JIT code executable");
+        exit(EXIT_FAILURE);
+    }
+    free(data_at);
+    return x86_jit_base;
+}
+
+// Compile, load and run main in-process; with check, compare the result
+// against the reference interpreter
+static int x86_jit_run(const TacProgram *prog, const char *input, int check) {
+    const TacFunc *main_fn = tac_find_func(prog, "main");
+    if (!main_fn) {
+        fprintf(stderr, "Error: %s has no function 'main'\n", input);
+        return EXIT_FAILURE;
+    }
+    x86_encode_program();
+    double t0 = now_sec();
+    unsigned char *base = x86_jit_load();
+    double load = now_sec() - t0;
+    double total = load;
+    for (int f = 0; f < x86_nfuncs; f++) {
+        const X86Func *xf = &x86_funcs[f];
+        printf("[jit] %s: %d TAC instructions -> %d bytes of code, compiled in %.3f ms\n",
+               xf->name, xf->tac_count, xf->size, xf->sec * 1e3);
+        total += xf->sec;
+    }
+
+    long (*entry)(void);
+    void *addr = base + x86_funcs[main_fn - prog->funcs].offset;
+    memcpy(&entry, &addr, sizeof(entry));
+    t0 = now_sec();
+    long r = entry();
+    double run = now_sec() - t0;
+    printf("[jit] main returned %ld\n", r);
+    printf("[jit] %d bytes of code, %d relocations, compile %.3f ms (load %.3f ms), run %.3f ms\n",
+           x86_text_size, x86_nrelocs, total * 1e3, load * 1e3, run * 1e3);
+
+    // main returns an int natively, so a float result is truncated first
+    if (check) {
+        TacValue  *env = tac_env_new(prog);
+        TacRunStats st = { 0 };
+        TacValue   ref = tac_run(prog, main_fn, env, &st);
+        long want = ref.is_float ? (long)ref.f : ref.i;
+        if (want != r) {
+            fprintf(stderr, "Error: reference interpreter returned %ld\n", want);
+            return EXIT_FAILURE;
+        }
+        printf("[jit] check: reference interpreter agrees (%ld instructions)\n", st.executed);
+        free(env);
+    }
+    munmap(x86_jit_base, x86_jit_size);
+    return 0;
+}
+
+//--------------------------------------------------- main
+int main(int argc, char **argv) {
+    const char *input = INPUT_FILE, *output = NULL;
+    int jit = 0, check = 0, object = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            object = 1;
+        } else if (strcmp(argv[i], "-jit") == 0) {
+            jit = 1;
+        } else if (strcmp(argv[i], "-check") == 0) {
+            check = 1;
+        } else if (argv[i][0] != '-') {
+            input = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-c] [-o out.s|out.o | -jit [-check]] [file.txt]   (default %s -> %s)\n",
+                    argv[0], INPUT_FILE, OUTPUT_FILE);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!output) output = object ? OBJECT_FILE : OUTPUT_FILE;
+
+    TacProgram prog = { 0 };
+    tac_load(&prog, input);
+    x86_compile(&prog);
+    if (jit) return x86_jit_run(&prog, input, check);
+
+    double t0 = now_sec();
+    if (object) {
+        x86_encode_program();
+        x86_write_object(output);
+        printf("[elf] wrote %s in %.3f ms: link with \"gcc %s -o program\"\n", output, (now_sec() - t0) * 1e3, output);
+        return 0;
+    }
+    FILE *out = fopen(output, "w");
+    if (!out) {
+        perror("Error opening assembly output for write");
+        return EXIT_FAILURE;
+    }
+    x86_print_program(out, input);
+    fclose(out);
+    printf("[x86] wrote %s in %.3f ms: assemble and link with \"gcc %s -o program\"\n", output, (now_sec() - t0) * 1e3, output);
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tac_ir.h"
+
+//--------------------------------------------------- Defines
+#define INPUT_FILE  "tac_opt.txt"
+#define OUTPUT_FILE "out.c"
+
+//--------------------------------------------------- Names
+// Every TAC function becomes a C function and every name a C variable of
+// its inferred type: ints are long, floats double. TAC names may contain
+// characters C does not allow ("%r0", "x.1"), so they are escaped with a
+// prefix per kind that also keeps them clear of C keywords and libc:
+// '_' -> "__", '.' -> "_d", '%' -> "_p", anything else -> "_xHH".
+
+static TacTypes *c_types;
+
+static const char *c_mangle(char *buf, size_t size, const char *prefix, const char *name) {
+    size_t n = (size_t)snprintf(buf, size, "%s", prefix);
+    for (const char *p = name; *p && n + 5 < size; p++) {
+        if (*p == '_')                                n += (size_t)snprintf(buf + n, size - n, "__");
+        else if (*p == '.')                           n += (size_t)snprintf(buf + n, size - n, "_d");
+        else if (*p == '%')                           n += (size_t)snprintf(buf + n, size - n, "_p");
+        else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9'))
+                                                      buf[n++] = *p;
+        else                                          n += (size_t)snprintf(buf + n, size - n, "_x%02x", (unsigned char)*p);
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+static const char *c_type_name(int t) {
+    return t == TY_FLOAT ? "double" : "long";
+}
+
+// A name, or a constant spelled so C gives it the TAC type
+static void c_operand(FILE *out, int sym) {
+    char buf[TAC_MAX_LINE_LEN];
+    if (IS_CONST(sym)) {
+        if (tac_is_int_const(sym)) {
+            fprintf(out, "%ldL", tac_const_int(sym));
+            return;
+        }
+        snprintf(buf, sizeof(buf), "%.17g", strtod(SYM_NAME(sym), NULL));
+        fprintf(out, "%s%s", buf, strpbrk(buf, ".eni") ? "" : ".0");
+        return;
+    }
+    fprintf(out, "%s", c_mangle(buf, sizeof(buf), IS_GLOBAL(sym) ? "g_" : "v_", SYM_NAME(sym)));
+}
+
+static void c_label(FILE *out, int label) {
+    char buf[TAC_MAX_LINE_LEN];
+    fprintf(out, "%s", c_mangle(buf, sizeof(buf), "l_", SYM_NAME(label)));
+}
+
+//--------------------------------------------------- Statements
+static void c_expression(FILE *out, const TacInstr *in) {
+    switch (in->kind) {
+        case TAC_COPY:
+            c_operand(out, in->a);
+            break;
+        case TAC_UNARY:
+            if (in->op == OP_TOINT)        fprintf(out, "(long)");
+            else if (in->op == OP_TOFLOAT) fprintf(out, "(double)");
+            else                           fprintf(out, "%s", tac_op_names[in->op]);
+            fprintf(out, "(");      // "-(-1L)", never "--1L"
+            c_operand(out, in->a);
+            fprintf(out, ")");
+            break;
+        default:
+            // tac_infer_types has checked that both operands have the type
+            // of the operator's form, so C's own conversions never apply
+            c_operand(out, in->a);
+            fprintf(out, " %s ", tac_op_names[in->op]);
+            c_operand(out, in->b);
+            break;
+    }
+}
+
+// Returns the number of C statements written
+static int c_function(FILE *out, const TacProgram *prog, int f, int *seen) {
+    const TacFunc *fn = &prog->funcs[f];
+    char buf[TAC_MAX_LINE_LEN];
+    int lines = 0;
+    int ret = c_types->ret[f];
+    fprintf(out, "\nstatic %s %s(", c_type_name(ret), c_mangle(buf, sizeof(buf), "f_", fn->name));
+    for (int k = 0; k < fn->nparams; k++) {
+        fprintf(out, "%s%s ", k ? ", " : "", c_type_name(c_types->param[f][k]));
+        c_operand(out, fn->params[k]);
+        seen[fn->params[k]] = f + 1;
+    }
+    fprintf(out, "%s) {\n", fn->nparams ? "" : "void");
+
+    // Locals start at 0, matching the interpreter
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        int syms[3] = { in->dst, in->a, in->kind == TAC_CALL ? -1 : in->b };
+        for (int k = 0; k < 3; k++) {
+            int s = syms[k];
+            if (!tac_is_name(s) || IS_GLOBAL(s) || seen[s] == f + 1) continue;
+            seen[s] = f + 1;
+            fprintf(out, "    %s ", c_type_name(tac_type(c_types, f, s)));
+            c_operand(out, s);
+            fprintf(out, " = 0;\n");
+            lines++;
+        }
+    }
+
+    int *args = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    int nargs = 0;
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        switch (in->kind) {
+            case TAC_LABEL:
+                c_label(out, in->label);
+                fprintf(out, ":;\n");
+                continue;
+            case TAC_COPY:
+            case TAC_UNARY:
+            case TAC_BINARY:
+                fprintf(out, "    ");
+                c_operand(out, in->dst);
+                fprintf(out, " = ");
+                c_expression(out, in);
+                fprintf(out, ";\n");
+                break;
+            case TAC_GOTO:
+                fprintf(out, "    goto ");
+                c_label(out, in->label);
+                fprintf(out, ";\n");
+                break;
+            case TAC_IF:
+            case TAC_IFFALSE:
+                fprintf(out, "    if (%s", in->kind == TAC_IFFALSE ? "!(" : "");
+                c_operand(out, in->a);
+                if (in->op != OP_NONE) {
+                    fprintf(out, " %s ", tac_op_names[in->op]);
+                    c_operand(out, in->b);
+                }
+                fprintf(out, "%s) goto ", in->kind == TAC_IFFALSE ? ")" : "");
+                c_label(out, in->label);
+                fprintf(out, ";\n");
+                break;
+            case TAC_RETURN:
+                fprintf(out, "    return ");
+                if (in->a >= 0) c_operand(out, in->a);
+                else            fprintf(out, "0");
+                fprintf(out, ";\n");
+                break;
+            case TAC_PARAM:
+                args[nargs++] = in->a;
+                continue;
+            case TAC_CALL: {
+                const TacFunc *callee = tac_find_func(prog, SYM_NAME(in->label));
+                int n = (int)tac_const_int(in->b);
+                nargs -= n;
+                fprintf(out, "    ");
+                if (in->dst >= 0) {
+                    c_operand(out, in->dst);
+                    fprintf(out, " = ");
+                }
+                fprintf(out, "%s(", c_mangle(buf, sizeof(buf), "f_", callee->name));
+                for (int k = 0; k < n; k++) {
+                    if (k) fprintf(out, ", ");
+                    c_operand(out, args[nargs + k]);
+                }
+                fprintf(out, ");\n");
+                break;
+            }
+            default:
+                continue;
+        }
+        lines++;
+    }
+    // Falling off the end returns 0
+    if (fn->count == 0 || fn->code[fn->count - 1].kind != TAC_RETURN) {
+        fprintf(out, "    return 0;\n");
+        lines++;
+    }
+    fprintf(out, "}\n");
+    free(args);
+    return lines;
+}
+
+//--------------------------------------------------- Program
+static void c_program(FILE *out, const TacProgram *prog, const char *source) {
+    char buf[TAC_MAX_LINE_LEN];
+    c_types = tac_infer_types(prog);
+    fprintf(out, "// Generated from %s\n", source);
+    for (int g = 0; g < prog->nglobals; g++) {
+        const TacGlobal *gl = &prog->globals[g];
+        fprintf(out, "%s %s = ", c_type_name(c_types->global[gl->sym]), c_mangle(buf, sizeof(buf), "g_", SYM_NAME(gl->sym)));
+        if (gl->init >= 0) c_operand(out, gl->init);
+        else               fprintf(out, "0");
+        fprintf(out, ";\n");
+    }
+
+    // Prototypes, so functions can appear in TAC order
+    fprintf(out, "\n");
+    for (int f = 0; f < prog->count; f++) {
+        const TacFunc *fn = &prog->funcs[f];
+        fprintf(out, "static %s %s(", c_type_name(c_types->ret[f]), c_mangle(buf, sizeof(buf), "f_", fn->name));
+        for (int k = 0; k < fn->nparams; k++) fprintf(out, "%s%s", k ? ", " : "", c_type_name(c_types->param[f][k]));
+        fprintf(out, "%s);\n", fn->nparams ? "" : "void");
+    }
+
+    int *seen = (int *)calloc(tac_sym_count + 1, sizeof(int));
+    for (int f = 0; f < prog->count; f++) {
+        int lines = c_function(out, prog, f, seen);
+        printf("[c] %s: %d TAC instructions -> %d C statements\n", prog->funcs[f].name, prog->funcs[f].count, lines);
+    }
+    free(seen);
+
+    // The process exit status is main's result, as with the x86 backend
+    fprintf(out, "\nint main(void) {\n    return (int)(long)f_main();\n}\n");
+    tac_free_types(prog, c_types);
+}
+
+//--------------------------------------------------- main
+int main(int argc, char **argv) {
+    const char *input = INPUT_FILE, *output = OUTPUT_FILE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-') {
+            input = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-o out.c] [file.txt]   (default %s -> %s)\n", argv[0], INPUT_FILE, OUTPUT_FILE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    TacProgram prog = { 0 };
+    tac_load(&prog, input);
+    if (!tac_find_func(&prog, "main")) {
+        fprintf(stderr, "Error: %s has no function 'main'\n", input);
+        return EXIT_FAILURE;
+    }
+    FILE *out = fopen(output, "w");
+    if (!out) {
+        perror("Error opening C output for write");
+        return EXIT_FAILURE;
+    }
+    c_program(out, &prog, input);
+    fclose(out);
+    printf("[c] wrote %s: compile with \"cc -O2 %s -o program\"\n", output, output);
+    return 0;
+}
@@ -0,0 +1,2122 @@
+#ifndef TAC_IR_H
+#define TAC_IR_H
+
+// Header-only: every function is static inline, so a tool that includes it
+// builds without unused-function warnings for the parts it does not call.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+//--------------------------------------------------- Defines
+#define TAC_MAX_LINE_LEN 512      // Maximum length of each TAC line
+#define TAC_MAX_CALL_DEPTH 10000  // Nested calls the reference interpreter allows
+
+//--------------------------------------------------- Symbols
+// Every operand, variable, temp, constant and label is interned once and
+// referred to by its integer id everywhere else in the IR. Registers (%rN,
+// %fN for floats) and stack slots (%sN, %fsN) only appear after register
+// allocation.
+typedef enum { SYM_VAR, SYM_TEMP, SYM_CONST, SYM_LABEL, SYM_REG, SYM_SLOT } SymKind;
+
+typedef struct {
+    char   *name;       // Symbol text as printed in TAC
+    SymKind kind;       // What the symbol names
+    int     is_global;  // Declared with "global": visible beyond the function
+    int     ssa_base;   // For an SSA version x.N, the symbol x; -1 otherwise
+    int     ssa_versions;   // Versions of this symbol created so far
+} TacSym;
+
+static TacSym *tac_syms        = NULL;
+static int     tac_sym_count   = 0;
+static int     tac_sym_cap     = 0;
+static int    *tac_sym_buckets = NULL;   // Open-addressing hash: id+1, 0 = empty
+static int     tac_sym_nbuckets = 0;
+
+static inline void *tac_xrealloc(void *p, size_t size) {
+    void *q = realloc(p, size ? size : 1);
+    if (!q) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return q;
+}
+
+static inline unsigned tac_hash_str(const char *s) {
+    unsigned h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+static inline int tac_numbered(const char *name, const char *prefix) {
+    size_t n = strlen(prefix);
+    if (strncmp(name, prefix, n) != 0 || !isdigit((unsigned char)name[n])) return 0;
+    const char *p = name + n;
+    while (isdigit((unsigned char)*p)) p++;
+    return *p == '\0';
+}
+
+static inline SymKind tac_classify(const char *name) {
+    if (tac_numbered(name, "t"))  return SYM_TEMP;
+    if (tac_numbered(name, "%r") || tac_numbered(name, "%f"))  return SYM_REG;
+    if (tac_numbered(name, "%s") || tac_numbered(name, "%fs")) return SYM_SLOT;
+    if (isdigit((unsigned char)name[0]) || name[0] == '.' ||
+        (name[0] == '-' && (isdigit((unsigned char)name[1]) || name[1] == '.')))
+        return SYM_CONST;
+    return SYM_VAR;
+}
+
+static inline void tac_sym_rehash(int nbuckets) {
+    free(tac_sym_buckets);
+    tac_sym_buckets  = (int *)calloc(nbuckets, sizeof(int));
+    tac_sym_nbuckets = nbuckets;
+    if (!tac_sym_buckets) tac_xrealloc(NULL, 0);
+    for (int i = 0; i < tac_sym_count; i++) {
+        unsigned h = tac_hash_str(tac_syms[i].name) & (nbuckets - 1);
+        while (tac_sym_buckets[h]) h = (h + 1) & (nbuckets - 1);
+        tac_sym_buckets[h] = i + 1;
+    }
+}
+
+// Intern a name and return its symbol id (kind inferred from spelling)
+static inline int tac_intern(const char *name) {
+    if (tac_sym_count * 2 >= tac_sym_nbuckets)
+        tac_sym_rehash(tac_sym_nbuckets ? tac_sym_nbuckets * 2 : 1024);
+    unsigned h = tac_hash_str(name) & (tac_sym_nbuckets - 1);
+    while (tac_sym_buckets[h]) {
+        int id = tac_sym_buckets[h] - 1;
+        if (strcmp(tac_syms[id].name, name) == 0) return id;
+        h = (h + 1) & (tac_sym_nbuckets - 1);
+    }
+    if (tac_sym_count >= tac_sym_cap) {
+        tac_sym_cap = tac_sym_cap ? tac_sym_cap * 2 : 256;
+        tac_syms = (TacSym *)tac_xrealloc(tac_syms, sizeof(TacSym) * tac_sym_cap);
+    }
+    tac_syms[tac_sym_count].name = strdup(name);
+    tac_syms[tac_sym_count].kind = tac_classify(name);
+    tac_syms[tac_sym_count].is_global = 0;
+    tac_syms[tac_sym_count].ssa_base = -1;
+    tac_syms[tac_sym_count].ssa_versions = 0;
+    tac_sym_buckets[h] = tac_sym_count + 1;
+    return tac_sym_count++;
+}
+
+static int tac_label_counter = 0;  // Next free label number (above any interned one)
+
+static inline int tac_intern_label(const char *name) {
+    int id = tac_intern(name);
+    tac_syms[id].kind = SYM_LABEL;
+    if (tac_numbered(name, "L")) {
+        int n = atoi(name + 1);
+        if (n >= tac_label_counter) tac_label_counter = n + 1;
+    }
+    return id;
+}
+
+static inline int tac_new_label() {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "L%d", tac_label_counter);
+    return tac_intern_label(buf);
+}
+
+#define SYM_NAME(id)  (tac_syms[id].name)
+#define IS_TEMP(id)   ((id) >= 0 && tac_syms[id].kind == SYM_TEMP)
+#define IS_CONST(id)  ((id) >= 0 && tac_syms[id].kind == SYM_CONST)
+#define IS_GLOBAL(id) ((id) >= 0 && tac_syms[id].is_global)
+
+//--------------------------------------------------- Instructions
+typedef enum {
+    TAC_NOP,        // Deleted instruction (removed by tac_compact)
+    TAC_LABEL,      // L:
+    TAC_COPY,       // dst = a
+    TAC_UNARY,      // dst = op a
+    TAC_BINARY,     // dst = a op b
+    TAC_GOTO,       // goto L
+    TAC_IFFALSE,    // ifFalse a goto L, or fused: ifFalse a relop b goto L
+    TAC_IF,         // if a goto L, or fused: if a relop b goto L
+    TAC_RETURN,     // return [a]
+    TAC_PARAM,      // param a: next argument of the following call
+    TAC_CALL,       // [dst =] call f, n: label is the function, b the literal argument count
+    TAC_PHI         // dst = phi(...): SSA only, arguments in fn->phi_args[a .. a+b)
+} TacKind;
+
+typedef enum {
+    OP_NONE,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+    OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ, OP_NE,
+    OP_AND, OP_OR,
+    OP_SHL, OP_SHR, OP_BAND,
+    OP_NOT, OP_NEG,
+    OP_TOINT, OP_TOFLOAT,   // Conversions: "t = (int)a", "t = (float)a"
+    OP_COUNT
+} TacOp;
+
+static const char *tac_op_names[OP_COUNT] = {
+    "", "+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=", "&&", "||",
+    "<<", ">>", "&", "!", "-", "(int)", "(float)"
+};
+
+// Value types, see Static Types below. Arithmetic and relations have two
+// forms: on floats the TY_FLOAT form, written with a '.': "t = a *. b",
+// "ifFalse a <. b goto L", and on ints the plain one, "t = a * b". Phase 4
+// converts operands first, so consumers take the form from the instruction
+// and never look at the operands. Every other instruction is TY_TOP.
+enum { TY_TOP, TY_INT, TY_FLOAT };
+
+typedef struct {
+    TacKind kind;
+    TacOp   op;
+    int     dst;        // Defined symbol, -1 if none
+    int     a, b;       // Operand symbols, -1 if unused
+    int     label;      // Label symbol for LABEL/GOTO/IF/IFFALSE, -1 otherwise
+    int     type;       // TY_FLOAT for the float form of an operator, else TY_TOP (the int form)
+} TacInstr;
+
+static inline int tac_is_relop(TacOp op) {
+    return op >= OP_LT && op <= OP_NE;
+}
+
+// Operators that have a float form
+static inline int tac_has_float_form(TacOp op) {
+    return (op >= OP_ADD && op <= OP_DIV) || tac_is_relop(op);
+}
+
+static inline const char *tac_type_suffix(const TacInstr *in) {
+    return in->type == TY_FLOAT ? "." : "";
+}
+
+// Relation with the operands exchanged: a < b is b > a
+static inline TacOp tac_swap_relop(TacOp op) {
+    static const TacOp swapped[OP_COUNT] = {
+        [OP_LT] = OP_GT, [OP_GT] = OP_LT, [OP_LE] = OP_GE, [OP_GE] = OP_LE, [OP_EQ] = OP_EQ, [OP_NE] = OP_NE
+    };
+    return swapped[op];
+}
+
+// Logical negation of a relation; exact for ints, not for NaN operands
+static inline TacOp tac_negate_relop(TacOp op) {
+    static const TacOp negated[OP_COUNT] = {
+        [OP_LT] = OP_GE, [OP_GT] = OP_LE, [OP_LE] = OP_GT, [OP_GE] = OP_LT, [OP_EQ] = OP_NE, [OP_NE] = OP_EQ
+    };
+    return negated[op];
+}
+
+static inline int tac_op_commutative(TacOp op) {
+    return op == OP_ADD || op == OP_MUL || op == OP_EQ || op == OP_NE ||
+           op == OP_AND || op == OP_OR || op == OP_BAND;
+}
+
+// Integer literal (no decimal point); phase 3 types these as int
+static inline int tac_is_int_const(int sym) {
+    return IS_CONST(sym) && strchr(SYM_NAME(sym), '.') == NULL;
+}
+
+static inline long tac_const_int(int sym) {
+    return strtol(SYM_NAME(sym), NULL, 10);
+}
+
+static inline int tac_intern_int(long v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%ld", v);
+    return tac_intern(buf);
+}
+
+static inline int tac_is_cond_branch(const TacInstr *in) {
+    return in->kind == TAC_IFFALSE || in->kind == TAC_IF;
+}
+
+// Conditional branch testing a relation directly instead of a temp
+static inline int tac_is_fused_branch(const TacInstr *in) {
+    return tac_is_cond_branch(in) && in->op != OP_NONE;
+}
+
+// Instructions carrying a label operand that names a jump target
+static inline int tac_is_jump(const TacInstr *in) {
+    return in->kind == TAC_GOTO || tac_is_cond_branch(in);
+}
+
+// Branches and returns end a basic block
+static inline int tac_is_terminator(const TacInstr *in) {
+    return tac_is_jump(in) || in->kind == TAC_RETURN;
+}
+
+// Pure computations: result depends only on operands, no side effects
+static inline int tac_is_pure(const TacInstr *in) {
+    return in->kind == TAC_BINARY || in->kind == TAC_UNARY;
+}
+
+// Symbols read by an instruction (variables, temps and constants); returns
+// count. Phi arguments are not included, see the SSA section.
+static inline int tac_uses(const TacInstr *in, int *uses) {
+    int n = 0;
+    if (in->kind == TAC_PHI) return 0;
+    if (in->a >= 0) uses[n++] = in->a;
+    if (in->b >= 0) uses[n++] = in->b;
+    return n;
+}
+
+// Symbol written by an instruction, -1 if none
+static inline int tac_def(const TacInstr *in) {
+    return in->kind == TAC_NOP ? -1 : in->dst;
+}
+
+//--------------------------------------------------- Functions and Program
+struct TacCFG;
+struct TacLiveness;
+struct TacLoopInfo;
+
+typedef struct {
+    char     *name;       // Function name
+    int      *params;     // Parameter symbols, bound by the caller in order
+    int       nparams;
+    TacInstr *code;       // Instruction array
+    int       count;      // Number of instructions
+    int       capacity;   // Allocated instructions
+    int       version;    // Bumped by tac_changed(); stale analyses are rebuilt
+    struct TacCFG      *cfg;    // Cached analyses, see tac_get_cfg/tac_get_liveness
+    struct TacLiveness *live;
+    struct TacLoopInfo *loops;
+    int      *phi_args;   // Phi arguments while in SSA form
+    int       nphi_args;
+    int       phi_cap;
+} TacFunc;
+
+typedef struct {
+    int sym;            // Global variable
+    int init;           // Constant initializer, -1 if none
+} TacGlobal;
+
+typedef struct {
+    TacFunc   *funcs;
+    int        count;
+    int        capacity;
+    TacGlobal *globals;
+    int        nglobals;
+} TacProgram;
+
+static inline TacInstr *tac_emit(TacFunc *fn, TacInstr in) {
+    if (fn->count >= fn->capacity) {
+        fn->capacity = fn->capacity ? fn->capacity * 2 : 64;
+        fn->code = (TacInstr *)tac_xrealloc(fn->code, sizeof(TacInstr) * fn->capacity);
+    }
+    fn->code[fn->count] = in;
+    return &fn->code[fn->count++];
+}
+
+static inline TacInstr tac_make(TacKind kind, TacOp op, int dst, int a, int b, int label) {
+    TacInstr in = { kind, op, dst, a, b, label, TY_TOP };
+    return in;
+}
+
+// Every pass that edits fn->code must call this so cached analyses go stale
+static inline void tac_changed(TacFunc *fn) {
+    fn->version++;
+}
+
+// Drop TAC_NOP instructions left behind by passes
+static inline void tac_compact(TacFunc *fn) {
+    int j = 0;
+    for (int i = 0; i < fn->count; i++)
+        if (fn->code[i].kind != TAC_NOP) fn->code[j++] = fn->code[i];
+    fn->count = j;
+    tac_changed(fn);
+}
+
+static int tac_temp_counter = 0;   // Next free temp number (above any loaded one)
+
+static inline int tac_new_temp() {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "t%d", tac_temp_counter++);
+    return tac_intern(buf);
+}
+
+//--------------------------------------------------- TAC Loading
+static inline TacOp tac_parse_op(const char *s, int unary) {
+    if (unary) {
+        if (strcmp(s, "!") == 0) return OP_NOT;
+        if (strcmp(s, "-") == 0) return OP_NEG;
+        if (strcmp(s, "(int)") == 0)   return OP_TOINT;
+        if (strcmp(s, "(float)") == 0) return OP_TOFLOAT;
+        return OP_NONE;
+    }
+    for (int op = OP_ADD; op < OP_NOT; op++)
+        if (strcmp(s, tac_op_names[op]) == 0) return (TacOp)op;
+    return OP_NONE;
+}
+
+// Binary operator, "*." being the float form of "*"; sets *type
+static inline TacOp tac_parse_binop(const char *s, int *type) {
+    size_t n = strlen(s);
+    *type = TY_TOP;
+    if (n < 2 || n > 3 || s[n - 1] != '.') return tac_parse_op(s, 0);
+    char base[4];
+    snprintf(base, sizeof(base), "%.*s", (int)(n - 1), s);
+    TacOp op = tac_parse_op(base, 0);
+    if (!tac_has_float_form(op)) return OP_NONE;
+    *type = TY_FLOAT;
+    return op;
+}
+
+static inline void tac_parse_error(int lineno, const char *msg, const char *text) {
+    fprintf(stderr, "TAC Error [line %d]: %s: '%s'\n", lineno, msg, text);
+    exit(EXIT_FAILURE);
+}
+
+static inline void tac_note_temp(int id) {
+    if (IS_TEMP(id)) {
+        int n = atoi(SYM_NAME(id) + 1);
+        if (n >= tac_temp_counter) tac_temp_counter = n + 1;
+    }
+}
+
+// Parse one instruction line (already trimmed) into fn
+static inline void tac_parse_instr(TacFunc *fn, char *text, int lineno) {
+    char *tok[8];
+    int   ntok = 0;
+    char  copy[TAC_MAX_LINE_LEN];
+    strncpy(copy, text, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    for (char *p = strtok(copy, " \t"); p && ntok < 8; p = strtok(NULL, " \t"))
+        tok[ntok++] = p;
+    if (ntok == 0) return;
+
+    size_t len = strlen(tok[0]);
+    if (ntok == 1 && len > 1 && tok[0][len - 1] == ':') {
+        tok[0][len - 1] = '\0';
+        tac_emit(fn, tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, tac_intern_label(tok[0])));
+        return;
+    }
+    if (strcmp(tok[0], "goto") == 0 && ntok == 2) {
+        tac_emit(fn, tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, tac_intern_label(tok[1])));
+        return;
+    }
+    if (strcmp(tok[0], "ifFalse") == 0 || strcmp(tok[0], "if") == 0) {
+        TacKind kind = tok[0][2] ? TAC_IFFALSE : TAC_IF;
+        if (ntok == 4 && strcmp(tok[2], "goto") == 0) {
+            tac_emit(fn, tac_make(kind, OP_NONE, -1, tac_intern(tok[1]), -1, tac_intern_label(tok[3])));
+            return;
+        }
+        if (ntok == 6 && strcmp(tok[4], "goto") == 0) {
+            int type;
+            TacOp op = tac_parse_binop(tok[2], &type);
+            if (!tac_is_relop(op)) tac_parse_error(lineno, "expected a relational operator", text);
+            tac_emit(fn, tac_make(kind, op, -1, tac_intern(tok[1]), tac_intern(tok[3]),
+                                  tac_intern_label(tok[5])))->type = type;
+            return;
+        }
+    }
+    if (strcmp(tok[0], "param") == 0 && ntok == 2) {
+        tac_emit(fn, tac_make(TAC_PARAM, OP_NONE, -1, tac_intern(tok[1]), -1, -1));
+        return;
+    }
+    // call f, n  or  t = call f, n
+    int call_at = -1;
+    if (strcmp(tok[0], "call") == 0) call_at = 0;
+    else if (ntok > 2 && strcmp(tok[1], "=") == 0 && strcmp(tok[2], "call") == 0) call_at = 2;
+    if (call_at >= 0) {
+        if (ntok != call_at + 3) tac_parse_error(lineno, "expected 'call f, n'", text);
+        char *f = tok[call_at + 1];
+        size_t flen = strlen(f);
+        if (flen > 1 && f[flen - 1] == ',') f[flen - 1] = '\0';
+        int dst = call_at ? tac_intern(tok[0]) : -1;
+        if (dst >= 0) tac_note_temp(dst);
+        tac_emit(fn, tac_make(TAC_CALL, OP_NONE, dst, -1, tac_intern(tok[call_at + 2]), tac_intern(f)));
+        return;
+    }
+    if (strcmp(tok[0], "return") == 0 && ntok <= 2) {
+        tac_emit(fn, tac_make(TAC_RETURN, OP_NONE, -1, ntok == 2 ? tac_intern(tok[1]) : -1, -1, -1));
+        return;
+    }
+    if (ntok >= 3 && strcmp(tok[1], "=") == 0) {
+        int dst = tac_intern(tok[0]);
+        tac_note_temp(dst);
+        if (ntok == 3) {
+            char *src = tok[2];
+            // Unary forms are written without a space: "!a", "-a", "(int)a"
+            char *close = src[0] == '(' ? strchr(src, ')') : NULL;
+            if (close && close[1] != '\0') {
+                char opstr[16];
+                snprintf(opstr, sizeof(opstr), "%.*s", (int)(close - src + 1), src);
+                TacOp op = tac_parse_op(opstr, 1);
+                if (op == OP_NONE) tac_parse_error(lineno, "unknown conversion", text);
+                tac_emit(fn, tac_make(TAC_UNARY, op, dst, tac_intern(close + 1), -1, -1));
+            } else if ((src[0] == '!' || (src[0] == '-' && !isdigit((unsigned char)src[1]) && src[1] != '.'))
+                && src[1] != '\0') {
+                char opstr[2] = { src[0], '\0' };
+                tac_emit(fn, tac_make(TAC_UNARY, tac_parse_op(opstr, 1), dst, tac_intern(src + 1), -1, -1));
+            } else {
+                tac_emit(fn, tac_make(TAC_COPY, OP_NONE, dst, tac_intern(src), -1, -1));
+            }
+            return;
+        }
+        if (ntok == 5) {
+            int type;
+            TacOp op = tac_parse_binop(tok[3], &type);
+            if (op == OP_NONE) tac_parse_error(lineno, "unknown operator", text);
+            tac_emit(fn, tac_make(TAC_BINARY, op, dst, tac_intern(tok[2]), tac_intern(tok[4]), -1))->type = type;
+            return;
+        }
+    }
+    tac_parse_error(lineno, "malformed instruction", text);
+}
+
+static inline TacFunc *tac_add_func(TacProgram *prog, const char *name) {
+    if (prog->count >= prog->capacity) {
+        prog->capacity = prog->capacity ? prog->capacity * 2 : 8;
+        prog->funcs = (TacFunc *)tac_xrealloc(prog->funcs, sizeof(TacFunc) * prog->capacity);
+    }
+    TacFunc *fn = &prog->funcs[prog->count++];
+    memset(fn, 0, sizeof(*fn));
+    fn->name = strdup(name);
+    return fn;
+}
+
+static inline TacFunc *tac_find_func(const TacProgram *prog, const char *name) {
+    for (int i = 0; prog && i < prog->count; i++)
+        if (strcmp(prog->funcs[i].name, name) == 0) return &prog->funcs[i];
+    return NULL;
+}
+
+// Load a whole TAC file as produced by phase 4
+static inline void tac_load(TacProgram *prog, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Error opening TAC file");
+        exit(EXIT_FAILURE);
+    }
+    char buf[TAC_MAX_LINE_LEN];
+    int lineno = 0;
+    TacFunc *fn = NULL;
+    while (fgets(buf, sizeof(buf), fp)) {
+        lineno++;
+        buf[strcspn(buf, "\r\n")] = '\0';
+        char *text = buf;
+        while (*text == ' ' || *text == '\t') text++;
+        if (*text == '\0') continue;
+
+        if (strncmp(text, "func ", 5) == 0) {
+            // func name:  or  func name(a, b):
+            char name[64];
+            sscanf(text + 5, "%63[^:(]", name);
+            fn = tac_add_func(prog, name);
+            char *p = strchr(text, '(');
+            while (p && *p != ')') {
+                char param[64];
+                p++;
+                while (*p == ' ') p++;
+                if (sscanf(p, "%63[^,) ]", param) != 1) break;
+                fn->params = (int *)tac_xrealloc(fn->params, sizeof(int) * (fn->nparams + 1));
+                fn->params[fn->nparams++] = tac_intern(param);
+                p += strcspn(p, ",)");
+            }
+            continue;
+        }
+        if (strcmp(text, "endfunc") == 0) {
+            fn = NULL;
+            continue;
+        }
+        if (!fn && strncmp(text, "global ", 7) == 0) {
+            char name[64], init[64];
+            int  n = sscanf(text + 7, "%63s = %63s", name, init);
+            if (n < 1) tac_parse_error(lineno, "malformed global", text);
+            prog->globals = (TacGlobal *)tac_xrealloc(prog->globals, sizeof(TacGlobal) * (prog->nglobals + 1));
+            TacGlobal *g = &prog->globals[prog->nglobals++];
+            g->sym  = tac_intern(name);
+            g->init = n == 2 ? tac_intern(init) : -1;
+            tac_syms[g->sym].is_global = 1;
+            continue;
+        }
+        if (!fn) tac_parse_error(lineno, "instruction outside of a function", text);
+        tac_parse_instr(fn, text, lineno);
+    }
+    fclose(fp);
+}
+
+//--------------------------------------------------- TAC Printing
+static inline void tac_print_instr(FILE *out, const TacFunc *fn, const TacInstr *in) {
+    switch (in->kind) {
+        case TAC_NOP:
+            break;
+        case TAC_LABEL:
+            fprintf(out, "%s:\n", SYM_NAME(in->label));
+            break;
+        case TAC_COPY:
+            fprintf(out, "%s = %s\n", SYM_NAME(in->dst), SYM_NAME(in->a));
+            break;
+        case TAC_UNARY:
+            fprintf(out, "%s = %s%s\n", SYM_NAME(in->dst), tac_op_names[in->op], SYM_NAME(in->a));
+            break;
+        case TAC_BINARY:
+            fprintf(out, "%s = %s %s%s %s\n", SYM_NAME(in->dst), SYM_NAME(in->a),
+                    tac_op_names[in->op], tac_type_suffix(in), SYM_NAME(in->b));
+            break;
+        case TAC_GOTO:
+            fprintf(out, "goto %s\n", SYM_NAME(in->label));
+            break;
+        case TAC_IFFALSE:
+        case TAC_IF:
+            fprintf(out, "%s %s", in->kind == TAC_IF ? "if" : "ifFalse", SYM_NAME(in->a));
+            if (in->op != OP_NONE) fprintf(out, " %s%s %s", tac_op_names[in->op], tac_type_suffix(in), SYM_NAME(in->b));
+            fprintf(out, " goto %s\n", SYM_NAME(in->label));
+            break;
+        case TAC_RETURN:
+            if (in->a >= 0) fprintf(out, "return %s\n", SYM_NAME(in->a));
+            else            fprintf(out, "return\n");
+            break;
+        case TAC_PARAM:
+            fprintf(out, "param %s\n", SYM_NAME(in->a));
+            break;
+        case TAC_CALL:
+            if (in->dst >= 0) fprintf(out, "%s = ", SYM_NAME(in->dst));
+            fprintf(out, "call %s, %s\n", SYM_NAME(in->label), SYM_NAME(in->b));
+            break;
+        case TAC_PHI:
+            fprintf(out, "%s = phi(", SYM_NAME(in->dst));
+            for (int k = 0; k < in->b; k++)
+                fprintf(out, "%s%s", k ? ", " : "", SYM_NAME(fn->phi_args[in->a + k]));
+            fprintf(out, ")\n");
+            break;
+    }
+}
+
+static inline void tac_print_func(FILE *out, const TacFunc *fn) {
+    fprintf(out, "func %s", fn->name);
+    for (int k = 0; k < fn->nparams; k++) fprintf(out, "%s%s", k ? ", " : "(", SYM_NAME(fn->params[k]));
+    fprintf(out, "%s:\n", fn->nparams ? ")" : "");
+    for (int i = 0; i < fn->count; i++) tac_print_instr(out, fn, &fn->code[i]);
+    fprintf(out, "endfunc\n\n");
+}
+
+static inline void tac_print_program(FILE *out, const TacProgram *prog) {
+    for (int i = 0; i < prog->nglobals; i++) {
+        if (prog->globals[i].init >= 0)
+            fprintf(out, "global %s = %s\n", SYM_NAME(prog->globals[i].sym), SYM_NAME(prog->globals[i].init));
+        else
+            fprintf(out, "global %s\n", SYM_NAME(prog->globals[i].sym));
+    }
+    for (int i = 0; i < prog->count; i++) tac_print_func(out, &prog->funcs[i]);
+}
+
+//--------------------------------------------------- Control-Flow Graph
+typedef struct {
+    int start, end;     // Instruction range [start, end)
+    int succ[2];        // Successor blocks, -1 if absent
+    int nsucc;
+    int pred_start;     // Predecessors are pred_list[pred_start .. pred_start+npred)
+    int npred;
+    int rpo;            // Reverse-postorder number, -1 if unreachable
+    int idom;           // Immediate dominator, -1 for entry/unreachable
+} TacBlock;
+
+typedef struct TacCFG {
+    int       version;      // fn->version this was built from
+    TacBlock *blocks;
+    int       nblocks;
+    int      *block_of;     // Instruction index -> block
+    int      *pred_list;
+    int      *rpo_order;    // Reachable blocks in reverse postorder
+    int       nrpo;
+    int      *dom_child_start;  // Dominator tree children (CSR): nblocks+1 entries
+    int      *dom_children;
+} TacCFG;
+
+// Map label symbol -> block that starts with it (sized to symbol table)
+static inline int *tac_label_blocks(const TacFunc *fn, const TacCFG *cfg) {
+    int *map = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    for (int i = 0; i < fn->count; i++)
+        if (fn->code[i].label >= 0) map[fn->code[i].label] = -1;
+    for (int i = 0; i < fn->count; i++)
+        if (fn->code[i].kind == TAC_LABEL) map[fn->code[i].label] = cfg->block_of[i];
+    return map;
+}
+
+static inline void tac_compute_rpo(TacCFG *cfg) {
+    int n = cfg->nblocks;
+    int *stack = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    int *next  = (int *)calloc(n + 1, sizeof(int));
+    int *post  = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    int  npost = 0, sp = 0;
+    for (int b = 0; b < n; b++) cfg->blocks[b].rpo = -1;
+    if (n > 0) {
+        stack[sp++] = 0;
+        cfg->blocks[0].rpo = 0;      // Mark visited
+    }
+    while (sp > 0) {
+        int b = stack[sp - 1];
+        if (next[b] < cfg->blocks[b].nsucc) {
+            int s = cfg->blocks[b].succ[next[b]++];
+            if (cfg->blocks[s].rpo < 0) {
+                cfg->blocks[s].rpo = 0;
+                stack[sp++] = s;
+            }
+        } else {
+            post[npost++] = b;
+            sp--;
+        }
+    }
+    cfg->rpo_order = (int *)tac_xrealloc(NULL, sizeof(int) * (npost + 1));
+    cfg->nrpo = npost;
+    for (int i = 0; i < npost; i++) {
+        int b = post[npost - 1 - i];
+        cfg->rpo_order[i] = b;
+        cfg->blocks[b].rpo = i;
+    }
+    free(stack); free(next); free(post);
+}
+
+static inline int tac_dom_intersect(const TacCFG *cfg, int a, int b) {
+    while (a != b) {
+        while (cfg->blocks[a].rpo > cfg->blocks[b].rpo) a = cfg->blocks[a].idom;
+        while (cfg->blocks[b].rpo > cfg->blocks[a].rpo) b = cfg->blocks[b].idom;
+    }
+    return a;
+}
+
+// Cooper-Harvey-Kennedy iterative dominators over reverse postorder
+static inline void tac_compute_dominators(TacCFG *cfg) {
+    for (int b = 0; b < cfg->nblocks; b++) cfg->blocks[b].idom = -1;
+    if (cfg->nrpo == 0) return;
+    cfg->blocks[0].idom = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < cfg->nrpo; i++) {
+            int b = cfg->rpo_order[i];
+            TacBlock *bb = &cfg->blocks[b];
+            int new_idom = -1;
+            for (int k = 0; k < bb->npred; k++) {
+                int p = cfg->pred_list[bb->pred_start + k];
+                if (cfg->blocks[p].idom < 0) continue;
+                new_idom = new_idom < 0 ? p : tac_dom_intersect(cfg, p, new_idom);
+            }
+            if (new_idom != bb->idom) {
+                bb->idom = new_idom;
+                changed = 1;
+            }
+        }
+    }
+    cfg->blocks[0].idom = -1;
+
+    // Dominator tree children in CSR form
+    int n = cfg->nblocks;
+    cfg->dom_child_start = (int *)calloc(n + 2, sizeof(int));
+    cfg->dom_children    = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    for (int b = 0; b < n; b++)
+        if (cfg->blocks[b].idom >= 0) cfg->dom_child_start[cfg->blocks[b].idom + 2]++;
+    for (int b = 0; b < n; b++) cfg->dom_child_start[b + 2] += cfg->dom_child_start[b + 1];
+    for (int i = 0; i < cfg->nrpo; i++) {
+        int b = cfg->rpo_order[i];
+        if (cfg->blocks[b].idom >= 0)
+            cfg->dom_children[cfg->dom_child_start[cfg->blocks[b].idom + 1]++] = b;
+    }
+}
+
+// a dominates b (both reachable)
+static inline int tac_dominates(const TacCFG *cfg, int a, int b) {
+    while (b >= 0 && cfg->blocks[b].rpo > cfg->blocks[a].rpo) b = cfg->blocks[b].idom;
+    return b == a;
+}
+
+// Split fn into basic blocks at labels and after branches, then link edges
+static inline TacCFG *tac_build_cfg(const TacFunc *fn) {
+    TacCFG *cfg = (TacCFG *)calloc(1, sizeof(TacCFG));
+    int n = fn->count;
+    cfg->block_of = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    cfg->blocks   = (TacBlock *)tac_xrealloc(NULL, sizeof(TacBlock) * (n + 1));
+
+    // Leaders: first instruction, labels, instruction after a terminator
+    int nb = 0;
+    for (int i = 0; i < n; i++) {
+        int leader = i == 0 || fn->code[i].kind == TAC_LABEL || tac_is_terminator(&fn->code[i - 1]);
+        if (leader) {
+            if (nb > 0) cfg->blocks[nb - 1].end = i;
+            cfg->blocks[nb].start = i;
+            nb++;
+        }
+        cfg->block_of[i] = nb - 1;
+    }
+    if (nb == 0) {                       // Empty function: single empty block
+        cfg->blocks[0].start = 0;
+        nb = 1;
+    }
+    cfg->blocks[nb - 1].end = n;
+    cfg->nblocks = nb;
+
+    // Successors
+    int *label_block = tac_label_blocks(fn, cfg);
+    int  nedges = 0;
+    for (int b = 0; b < nb; b++) {
+        TacBlock *bb = &cfg->blocks[b];
+        bb->nsucc = 0;
+        bb->succ[0] = bb->succ[1] = -1;
+        const TacInstr *last = bb->end > bb->start ? &fn->code[bb->end - 1] : NULL;
+        if (last && last->kind == TAC_GOTO) {
+            bb->succ[bb->nsucc++] = label_block[last->label];
+        } else if (last && tac_is_cond_branch(last)) {
+            if (b + 1 < nb) bb->succ[bb->nsucc++] = b + 1;
+            int t = label_block[last->label];
+            if (bb->nsucc == 0 || t != bb->succ[0]) bb->succ[bb->nsucc++] = t;
+        } else if (!(last && last->kind == TAC_RETURN) && b + 1 < nb) {
+            bb->succ[bb->nsucc++] = b + 1;
+        }
+        for (int k = 0; k < bb->nsucc; k++)
+            if (bb->succ[k] < 0) {
+                fprintf(stderr, "TAC Error: jump to undefined label in function '%s'\n", fn->name);
+                exit(EXIT_FAILURE);
+            }
+        nedges += bb->nsucc;
+    }
+    free(label_block);
+
+    // Predecessors (CSR)
+    for (int b = 0; b < nb; b++) cfg->blocks[b].npred = 0;
+    for (int b = 0; b < nb; b++)
+        for (int k = 0; k < cfg->blocks[b].nsucc; k++) cfg->blocks[cfg->blocks[b].succ[k]].npred++;
+    int off = 0;
+    for (int b = 0; b < nb; b++) {
+        cfg->blocks[b].pred_start = off;
+        off += cfg->blocks[b].npred;
+        cfg->blocks[b].npred = 0;
+    }
+    cfg->pred_list = (int *)tac_xrealloc(NULL, sizeof(int) * (nedges + 1));
+    for (int b = 0; b < nb; b++)
+        for (int k = 0; k < cfg->blocks[b].nsucc; k++) {
+            TacBlock *s = &cfg->blocks[cfg->blocks[b].succ[k]];
+            cfg->pred_list[s->pred_start + s->npred++] = b;
+        }
+
+    tac_compute_rpo(cfg);
+    tac_compute_dominators(cfg);
+    cfg->version = fn->version;
+    return cfg;
+}
+
+static inline void tac_free_cfg(TacCFG *cfg) {
+    if (!cfg) return;
+    free(cfg->blocks); free(cfg->block_of); free(cfg->pred_list);
+    free(cfg->rpo_order); free(cfg->dom_child_start); free(cfg->dom_children);
+    free(cfg);
+}
+
+//--------------------------------------------------- Natural Loops
+// One loop per header: the header plus every block that reaches one of its
+// back edges (an edge whose target dominates its source) without passing
+// through the header. Loops are ordered innermost first.
+typedef struct {
+    int  header;        // Header block
+    int *blocks;        // Member blocks in layout order, header included
+    int  nblocks;
+    int  parent;        // Enclosing loop, -1 if outermost
+} TacLoop;
+
+typedef struct TacLoopInfo {
+    int      version;   // fn->version this was computed from
+    TacLoop *loops;
+    int      nloops;
+    int     *loop_of;   // Block -> innermost loop, -1 if none
+} TacLoopInfo;
+
+static inline int tac_loop_size_cmp(const void *x, const void *y) {
+    const TacLoop *a = (const TacLoop *)x, *b = (const TacLoop *)y;
+    return a->nblocks != b->nblocks ? a->nblocks - b->nblocks : a->header - b->header;
+}
+
+static inline int tac_int_cmp(const void *x, const void *y) {
+    return *(const int *)x - *(const int *)y;
+}
+
+// Is block b inside loop l (or one of its inner loops)?
+static inline int tac_in_loop(const TacLoopInfo *li, int l, int b) {
+    for (int x = li->loop_of[b]; x >= 0; x = li->loops[x].parent)
+        if (x == l) return 1;
+    return 0;
+}
+
+static inline TacLoopInfo *tac_build_loops(const TacCFG *cfg) {
+    TacLoopInfo *li = (TacLoopInfo *)calloc(1, sizeof(TacLoopInfo));
+    int n = cfg->nblocks;
+    int *mark  = (int *)calloc(n + 1, sizeof(int));
+    int *work  = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    int  cap   = 0;
+    li->loop_of = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+
+    for (int h = 0; h < n; h++) {
+        if (cfg->blocks[h].rpo < 0) continue;
+        int sp = 0, stamp = h + 1, back = 0;
+        const TacBlock *hb = &cfg->blocks[h];
+        mark[h] = stamp;            // The walk stops at the header, even for a self loop
+        for (int k = 0; k < hb->npred; k++) {
+            int p = cfg->pred_list[hb->pred_start + k];
+            if (cfg->blocks[p].rpo >= 0 && tac_dominates(cfg, h, p)) {
+                back = 1;
+                if (mark[p] != stamp) {
+                    mark[p] = stamp;
+                    work[sp++] = p;
+                }
+            }
+        }
+        if (!back) continue;
+
+        if (li->nloops >= cap) {
+            cap = cap ? cap * 2 : 8;
+            li->loops = (TacLoop *)tac_xrealloc(li->loops, sizeof(TacLoop) * cap);
+        }
+        TacLoop *lp = &li->loops[li->nloops++];
+        lp->header  = h;
+        lp->parent  = -1;
+        lp->nblocks = 0;
+        lp->blocks  = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+        lp->blocks[lp->nblocks++] = h;
+        while (sp > 0) {
+            int b = work[--sp];
+            lp->blocks[lp->nblocks++] = b;
+            const TacBlock *bb = &cfg->blocks[b];
+            for (int k = 0; k < bb->npred; k++) {
+                int p = cfg->pred_list[bb->pred_start + k];
+                if (cfg->blocks[p].rpo >= 0 && mark[p] != stamp) {
+                    mark[p] = stamp;
+                    work[sp++] = p;
+                }
+            }
+        }
+        qsort(lp->blocks, lp->nblocks, sizeof(int), tac_int_cmp);
+    }
+    qsort(li->loops, li->nloops, sizeof(TacLoop), tac_loop_size_cmp);
+
+    // Outermost first, so each block ends up owned by its innermost loop
+    for (int b = 0; b < n; b++) li->loop_of[b] = -1;
+    for (int l = li->nloops - 1; l >= 0; l--) {
+        li->loops[l].parent = li->loop_of[li->loops[l].header];
+        for (int k = 0; k < li->loops[l].nblocks; k++) li->loop_of[li->loops[l].blocks[k]] = l;
+    }
+    free(mark); free(work);
+    return li;
+}
+
+static inline void tac_free_loops(TacLoopInfo *li) {
+    if (!li) return;
+    for (int l = 0; l < li->nloops; l++) free(li->loops[l].blocks);
+    free(li->loops); free(li->loop_of);
+    free(li);
+}
+
+//--------------------------------------------------- Liveness
+// Dense bitsets over the function's global names: variables and temps that
+// are read in some block before being written there. Names that never cross
+// a block boundary cannot be live on an edge and stay out of the universe,
+// which keeps the sets small even for functions with many thousand temps.
+typedef struct TacLiveness {
+    int       version;      // fn->version this was computed from
+    int       nsyms;        // Size of index_of (symbols interned at build time)
+    int      *index_of;     // Symbol -> dense index, -1 if not a global name
+    int      *names;        // Dense index -> symbol
+    int       nnames;
+    int       words;        // 64-bit words per set
+    uint64_t *use;          // Upward-exposed uses, per block
+    uint64_t *def;          // Definitions, per block
+    uint64_t *in;           // Live on entry, per block
+    uint64_t *out;          // Live on exit, per block
+} TacLiveness;
+
+#define BITSET_TEST(set, i)   (((set)[(i) >> 6] >> ((i) & 63)) & 1)
+#define BITSET_SET(set, i)    ((set)[(i) >> 6] |= (uint64_t)1 << ((i) & 63))
+#define BITSET_CLEAR(set, i)  ((set)[(i) >> 6] &= ~((uint64_t)1 << ((i) & 63)))
+
+static inline int tac_is_name(int sym) {
+    return sym >= 0 && tac_syms[sym].kind != SYM_CONST && tac_syms[sym].kind != SYM_LABEL;
+}
+
+static inline int tac_live_index(const TacLiveness *lv, int sym) {
+    return sym >= 0 && sym < lv->nsyms ? lv->index_of[sym] : -1;
+}
+
+// Is sym live on exit from block b?
+static inline int tac_live_out(const TacLiveness *lv, int b, int sym) {
+    int k = tac_live_index(lv, sym);
+    return k >= 0 && BITSET_TEST(lv->out + (size_t)b * lv->words, k);
+}
+
+static inline int tac_live_in(const TacLiveness *lv, int b, int sym) {
+    int k = tac_live_index(lv, sym);
+    return k >= 0 && BITSET_TEST(lv->in + (size_t)b * lv->words, k);
+}
+
+static inline TacLiveness *tac_build_liveness(const TacFunc *fn, const TacCFG *cfg) {
+    TacLiveness *lv = (TacLiveness *)calloc(1, sizeof(TacLiveness));
+    int nb = cfg->nblocks;
+    lv->nsyms    = tac_sym_count;
+    lv->index_of = (int *)tac_xrealloc(NULL, sizeof(int) * (lv->nsyms + 1));
+    lv->names    = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count * 2 + 1));
+
+    // Global names: read before written within some block. Uses of the
+    // previous block's definitions are found with a per-block stamp.
+    int *seen = (int *)tac_xrealloc(NULL, sizeof(int) * (lv->nsyms + 1));
+    memset(lv->index_of, 0xff, sizeof(int) * (lv->nsyms + 1));
+    memset(seen, 0xff, sizeof(int) * (lv->nsyms + 1));
+    for (int b = 0; b < nb; b++) {
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            int u[4], nu = tac_uses(&fn->code[i], u);
+            for (int k = 0; k < nu; k++)
+                if (tac_is_name(u[k]) && seen[u[k]] != b && lv->index_of[u[k]] < 0) {
+                    lv->index_of[u[k]] = lv->nnames;
+                    lv->names[lv->nnames++] = u[k];
+                }
+            int d = tac_def(&fn->code[i]);
+            if (d >= 0) seen[d] = b;
+        }
+    }
+    free(seen);
+
+    lv->words = (lv->nnames + 63) / 64;
+    size_t total = (size_t)nb * lv->words + 1;
+    lv->use = (uint64_t *)calloc(total, sizeof(uint64_t));
+    lv->def = (uint64_t *)calloc(total, sizeof(uint64_t));
+    lv->in  = (uint64_t *)calloc(total, sizeof(uint64_t));
+    lv->out = (uint64_t *)calloc(total, sizeof(uint64_t));
+
+    for (int b = 0; b < nb; b++) {
+        uint64_t *use = lv->use + (size_t)b * lv->words;
+        uint64_t *def = lv->def + (size_t)b * lv->words;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            int u[4], nu = tac_uses(&fn->code[i], u);
+            for (int k = 0; k < nu; k++) {
+                int x = tac_live_index(lv, u[k]);
+                if (x >= 0 && !BITSET_TEST(def, x)) BITSET_SET(use, x);
+            }
+            int x = tac_live_index(lv, tac_def(&fn->code[i]));
+            if (x >= 0) BITSET_SET(def, x);
+        }
+        memcpy(lv->in + (size_t)b * lv->words, use, sizeof(uint64_t) * lv->words);
+    }
+
+    // Backward dataflow in postorder until nothing changes:
+    // out[b] = U in[s], in[b] = use[b] | (out[b] & ~def[b])
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = cfg->nrpo - 1; i >= 0; i--) {
+            int b = cfg->rpo_order[i];
+            const TacBlock *bb = &cfg->blocks[b];
+            uint64_t *out = lv->out + (size_t)b * lv->words;
+            uint64_t *in  = lv->in  + (size_t)b * lv->words;
+            uint64_t *use = lv->use + (size_t)b * lv->words;
+            uint64_t *def = lv->def + (size_t)b * lv->words;
+            for (int w = 0; w < lv->words; w++) {
+                uint64_t o = 0;
+                for (int k = 0; k < bb->nsucc; k++) o |= lv->in[(size_t)bb->succ[k] * lv->words + w];
+                uint64_t n = use[w] | (o & ~def[w]);
+                if (n != in[w]) changed = 1;
+                out[w] = o;
+                in[w]  = n;
+            }
+        }
+    }
+    lv->version = fn->version;
+    return lv;
+}
+
+static inline void tac_free_liveness(TacLiveness *lv) {
+    if (!lv) return;
+    free(lv->index_of); free(lv->names);
+    free(lv->use); free(lv->def); free(lv->in); free(lv->out);
+    free(lv);
+}
+
+//--------------------------------------------------- Analysis Cache
+// Analyses are computed on demand and kept on the function until the next
+// tac_changed(); a pass asking again after an edit gets a fresh result.
+static inline TacCFG *tac_get_cfg(TacFunc *fn) {
+    if (fn->cfg && fn->cfg->version == fn->version) return fn->cfg;
+    tac_free_cfg(fn->cfg);
+    fn->cfg = tac_build_cfg(fn);
+    return fn->cfg;
+}
+
+static inline TacLoopInfo *tac_get_loops(TacFunc *fn) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    if (fn->loops && fn->loops->version == fn->version) return fn->loops;
+    tac_free_loops(fn->loops);
+    fn->loops = tac_build_loops(cfg);
+    fn->loops->version = fn->version;
+    return fn->loops;
+}
+
+static inline TacLiveness *tac_get_liveness(TacFunc *fn) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    if (fn->live && fn->live->version == fn->version) return fn->live;
+    tac_free_liveness(fn->live);
+    fn->live = tac_build_liveness(fn, cfg);
+    return fn->live;
+}
+
+//--------------------------------------------------- Profiles
+// Block and edge execution counts per function, written by the VM with
+// -profile and fed back to phases 4 and 5. Blocks are numbered as
+// tac_build_cfg() numbers them, so an entry only fits the body it was
+// collected on: each function carries a hash of its text and consumers
+// ignore entries whose hash no longer matches. Temps and labels are hashed
+// by order of first appearance, so a function whose code did not change
+// keeps its hash when another one gains or loses a few temps.
+//     func <name> <hash> <blocks>
+//     block <b> <count>
+//     edge <b> <successor> <count>
+//     endfunc
+
+typedef struct {
+    char     *name;
+    unsigned  hash;
+    int       nblocks;
+    long     *count;        // Executions per block
+    int      *edge_to;      // Two per block: successor block, -1 if unused
+    long     *edge_count;   // Times each of those edges was taken
+} TacProfileFunc;
+
+typedef struct {
+    TacProfileFunc *funcs;
+    int             count;
+} TacProfile;
+
+static inline unsigned tac_hash_byte(unsigned h, unsigned char c) {
+    return (h ^ c) * 16777619u;
+}
+
+static inline int tac_is_name_char(int c) {
+    return isalnum(c) || c == '_' || c == '.' || c == '%';
+}
+
+// FNV-1a over one function's text ("func" to "endfunc"), with every temp
+// and label renumbered by its first appearance
+static inline unsigned tac_hash_text(const char *text) {
+    unsigned h = 2166136261u;
+    long *seen = NULL;
+    int   nseen = 0, cap = 0;
+    for (const char *p = text; *p; ) {
+        int start = p == text || !tac_is_name_char((unsigned char)p[-1]);
+        if (start && (*p == 't' || *p == 'L') && isdigit((unsigned char)p[1])) {
+            const char *q = p + 1;
+            while (isdigit((unsigned char)*q)) q++;
+            if (!tac_is_name_char((unsigned char)*q)) {
+                long key = strtol(p + 1, NULL, 10) * 2 + (*p == 'L');
+                int k = 0;
+                while (k < nseen && seen[k] != key) k++;
+                if (k == nseen) {
+                    if (nseen == cap) {
+                        cap = cap ? cap * 2 : 64;
+                        seen = (long *)tac_xrealloc(seen, sizeof(long) * cap);
+                    }
+                    seen[nseen++] = key;
+                }
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%c#%d", *p, k);
+                for (const char *s = buf; *s; s++) h = tac_hash_byte(h, (unsigned char)*s);
+                p = q;
+                continue;
+            }
+        }
+        h = tac_hash_byte(h, (unsigned char)*p++);
+    }
+    free(seen);
+    return h;
+}
+
+static inline unsigned tac_func_hash(const TacFunc *fn) {
+    char  *text = NULL;
+    size_t len  = 0;
+    FILE  *mem  = open_memstream(&text, &len);
+    if (!mem) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    tac_print_func(mem, fn);
+    fclose(mem);
+    unsigned h = tac_hash_text(text);
+    free(text);
+    return h;
+}
+
+static inline TacProfileFunc *tac_profile_add(TacProfile *prof, const char *name, unsigned hash, int nblocks) {
+    prof->funcs = (TacProfileFunc *)tac_xrealloc(prof->funcs, sizeof(TacProfileFunc) * (prof->count + 1));
+    TacProfileFunc *pf = &prof->funcs[prof->count++];
+    pf->name       = strdup(name);
+    pf->hash       = hash;
+    pf->nblocks    = nblocks;
+    pf->count      = (long *)calloc(nblocks + 1, sizeof(long));
+    pf->edge_to    = (int *)tac_xrealloc(NULL, sizeof(int) * (2 * nblocks + 1));
+    pf->edge_count = (long *)calloc(2 * nblocks + 1, sizeof(long));
+    for (int k = 0; k < 2 * nblocks; k++) pf->edge_to[k] = -1;
+    return pf;
+}
+
+// Count along edge b -> s, summed if recorded twice
+static inline void tac_profile_add_edge(TacProfileFunc *pf, int b, int s, long n) {
+    int k = pf->edge_to[2 * b] < 0 || pf->edge_to[2 * b] == s ? 0 : 1;
+    pf->edge_to[2 * b + k] = s;
+    pf->edge_count[2 * b + k] += n;
+}
+
+static inline long tac_profile_edge(const TacProfileFunc *pf, int b, int s) {
+    for (int k = 0; k < 2; k++)
+        if (pf->edge_to[2 * b + k] == s) return pf->edge_count[2 * b + k];
+    return 0;
+}
+
+static inline const TacProfileFunc *tac_profile_find(const TacProfile *prof, const char *name) {
+    for (int i = 0; i < prof->count; i++)
+        if (strcmp(prof->funcs[i].name, name) == 0) return &prof->funcs[i];
+    return NULL;
+}
+
+static inline void tac_write_profile(FILE *out, const TacProfile *prof) {
+    for (int i = 0; i < prof->count; i++) {
+        const TacProfileFunc *pf = &prof->funcs[i];
+        fprintf(out, "func %s %08x %d\n", pf->name, pf->hash, pf->nblocks);
+        for (int b = 0; b < pf->nblocks; b++) fprintf(out, "block %d %ld\n", b, pf->count[b]);
+        for (int b = 0; b < pf->nblocks; b++)
+            for (int k = 0; k < 2; k++)
+                if (pf->edge_to[2 * b + k] >= 0)
+                    fprintf(out, "edge %d %d %ld\n", b, pf->edge_to[2 * b + k], pf->edge_count[2 * b + k]);
+        fprintf(out, "endfunc\n");
+    }
+}
+
+static inline TacProfile *tac_read_profile(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Error opening profile");
+        exit(EXIT_FAILURE);
+    }
+    TacProfile *prof = (TacProfile *)calloc(1, sizeof(TacProfile));
+    TacProfileFunc *pf = NULL;
+    char line[TAC_MAX_LINE_LEN], name[TAC_MAX_LINE_LEN];
+    int  lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        line[strcspn(line, "\n")] = '\0';
+        unsigned hash;
+        int  nb, b, s;
+        long n;
+        if (line[0] == '\0') continue;
+        if (sscanf(line, "func %511s %x %d", name, &hash, &nb) == 3 && nb > 0) {
+            pf = tac_profile_add(prof, name, hash, nb);
+        } else if (strcmp(line, "endfunc") == 0) {
+            pf = NULL;
+        } else if (pf && sscanf(line, "block %d %ld", &b, &n) == 2 && b >= 0 && b < pf->nblocks) {
+            pf->count[b] = n;
+        } else if (pf && sscanf(line, "edge %d %d %ld", &b, &s, &n) == 3 && b >= 0 && b < pf->nblocks) {
+            tac_profile_add_edge(pf, b, s, n);
+        } else {
+            fclose(fp);
+            fprintf(stderr, "Profile Error [%s line %d]: '%s'\n", filename, lineno, line);
+            exit(EXIT_FAILURE);
+        }
+    }
+    fclose(fp);
+    return prof;
+}
+
+static inline void tac_free_profile(TacProfile *prof) {
+    if (!prof) return;
+    for (int i = 0; i < prof->count; i++) {
+        free(prof->funcs[i].name); free(prof->funcs[i].count);
+        free(prof->funcs[i].edge_to); free(prof->funcs[i].edge_count);
+    }
+    free(prof->funcs);
+    free(prof);
+}
+
+//--------------------------------------------------- SSA Form
+// tac_to_ssa() gives every local name a single definition: definitions of
+// x become x.1, x.2, ... and a use with no definition on some path reads x
+// itself, the value on entry. Phis go on the iterated dominance frontier
+// of x's definitions wherever x is live (pruned SSA, Cytron et al.).
+// Globals keep their names since other functions may read and write them.
+//
+// A phi has one argument per predecessor, in the order of the block's
+// pred_list, stored in fn->phi_args. Predecessor lists are sorted by block
+// position, so a pass that removes edges keeps the arguments aligned by
+// dropping the ones for removed edges. tac_uses() skips phis; only
+// SSA-aware code should run between tac_to_ssa() and tac_from_ssa().
+//
+// tac_from_ssa() turns phis into copies on the incoming edges, splitting
+// critical edges, then gives each name back its original spelling unless
+// two of its versions are live at the same time.
+
+static inline int tac_ssa_base(int sym) {
+    return tac_syms[sym].ssa_base >= 0 ? tac_syms[sym].ssa_base : sym;
+}
+
+static inline int tac_ssa_renamable(int sym) {
+    return sym >= 0 && tac_is_name(sym) && !IS_GLOBAL(sym);
+}
+
+static inline int tac_ssa_version(int base) {
+    char buf[TAC_MAX_LINE_LEN];
+    snprintf(buf, sizeof(buf), "%s.%d", SYM_NAME(base), ++tac_syms[base].ssa_versions);
+    int v = tac_intern(buf);
+    tac_syms[v].kind     = tac_syms[base].kind;
+    tac_syms[v].ssa_base = base;
+    return v;
+}
+
+#define TAC_PHI_ARG(fn, in, k) ((fn)->phi_args[(in)->a + (k)])
+
+static inline int tac_phi_alloc(TacFunc *fn, int n) {
+    if (fn->nphi_args + n > fn->phi_cap) {
+        while (fn->nphi_args + n > fn->phi_cap) fn->phi_cap = fn->phi_cap ? fn->phi_cap * 2 : 256;
+        fn->phi_args = (int *)tac_xrealloc(fn->phi_args, sizeof(int) * fn->phi_cap);
+    }
+    int off = fn->nphi_args;
+    fn->nphi_args += n;
+    return off;
+}
+
+// Dominance frontiers in CSR form (Cooper, Harvey & Kennedy)
+static inline void tac_dominance_frontiers(const TacCFG *cfg, int **df_start, int **df_list) {
+    int  n = cfg->nblocks, total = 0;
+    int *mark  = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+    int *count = (int *)calloc(n + 2, sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int b = 0; b < n; b++) mark[b] = -1;
+        for (int b = 0; b < n; b++) {
+            const TacBlock *bb = &cfg->blocks[b];
+            if (bb->npred < 2 || bb->rpo < 0) continue;
+            for (int k = 0; k < bb->npred; k++) {
+                int r = cfg->pred_list[bb->pred_start + k];
+                if (cfg->blocks[r].rpo < 0) continue;
+                for (; r != bb->idom && r >= 0; r = cfg->blocks[r].idom) {
+                    if (mark[r] == b) break;
+                    mark[r] = b;
+                    if (pass == 0) count[r + 1]++;
+                    else           (*df_list)[count[r]++] = b;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int b = 0; b < n; b++) count[b + 1] += count[b];
+            total = count[n];
+            *df_start = (int *)tac_xrealloc(NULL, sizeof(int) * (n + 1));
+            memcpy(*df_start, count, sizeof(int) * (n + 1));
+            *df_list = (int *)tac_xrealloc(NULL, sizeof(int) * (total + 1));
+        }
+    }
+    free(mark); free(count);
+}
+
+static inline void tac_to_ssa(TacFunc *fn) {
+    // Unreachable code has no dominator and takes no part in SSA
+    TacCFG *cfg = tac_get_cfg(fn);
+    int dropped = 0;
+    for (int i = 0; i < fn->count; i++)
+        if (cfg->blocks[cfg->block_of[i]].rpo < 0) { fn->code[i].kind = TAC_NOP; dropped = 1; }
+    if (dropped) tac_compact(fn);
+
+    // The entry block must not be a join point: give it a fresh label in front
+    cfg = tac_get_cfg(fn);
+    if (cfg->blocks[0].npred > 0) {
+        tac_emit(fn, tac_make(TAC_NOP, OP_NONE, -1, -1, -1, -1));
+        memmove(fn->code + 1, fn->code, sizeof(TacInstr) * (fn->count - 1));
+        fn->code[0] = tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, tac_new_label());
+        tac_changed(fn);
+        cfg = tac_get_cfg(fn);
+    }
+    TacLiveness *lv = tac_get_liveness(fn);
+    int nb = cfg->nblocks, nn = lv->nnames;
+
+    // Blocks defining each cross-block name, as a CSR list
+    int *def_start = (int *)calloc(nn + 2, sizeof(int));
+    int *def_list  = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    int *last      = (int *)tac_xrealloc(NULL, sizeof(int) * (nn + 1));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int k = 0; k < nn; k++) last[k] = -1;
+        for (int i = 0; i < fn->count; i++) {
+            int d = tac_def(&fn->code[i]), k = tac_live_index(lv, d);
+            if (k < 0 || !tac_ssa_renamable(d) || last[k] == cfg->block_of[i]) continue;
+            last[k] = cfg->block_of[i];
+            if (pass == 0) def_start[k + 1]++;
+            else           def_list[def_start[k]++] = cfg->block_of[i];
+        }
+        if (pass == 0) for (int k = 0; k < nn; k++) def_start[k + 1] += def_start[k];
+        else for (int k = nn; k > 0; k--) def_start[k] = def_start[k - 1];
+        if (pass == 1) def_start[0] = 0;
+    }
+
+    // Phi placement on the iterated dominance frontier, where the name is live
+    int *df_start, *df_list;
+    tac_dominance_frontiers(cfg, &df_start, &df_list);
+    int *has_phi  = (int *)tac_xrealloc(NULL, sizeof(int) * (nb + 1));
+    int *in_work  = (int *)tac_xrealloc(NULL, sizeof(int) * (nb + 1));
+    int *work     = (int *)tac_xrealloc(NULL, sizeof(int) * (nb + 1));
+    int *phi_count = (int *)calloc(nb + 1, sizeof(int));
+    int  nphis = 0, phi_cap = 0;
+    int *phi_block = NULL, *phi_name = NULL;
+    for (int b = 0; b < nb; b++) has_phi[b] = in_work[b] = -1;
+    for (int k = 0; k < nn; k++) {
+        int name = lv->names[k], sp = 0;
+        for (int j = def_start[k]; j < def_start[k + 1]; j++) {
+            in_work[def_list[j]] = k;
+            work[sp++] = def_list[j];
+        }
+        while (sp > 0) {
+            int d = work[--sp];
+            for (int j = df_start[d]; j < df_start[d + 1]; j++) {
+                int y = df_list[j];
+                if (has_phi[y] == k || !tac_live_in(lv, y, name)) continue;
+                has_phi[y] = k;
+                if (nphis >= phi_cap) {
+                    phi_cap = phi_cap ? phi_cap * 2 : 64;
+                    phi_block = (int *)tac_xrealloc(phi_block, sizeof(int) * phi_cap);
+                    phi_name  = (int *)tac_xrealloc(phi_name, sizeof(int) * phi_cap);
+                }
+                phi_block[nphis] = y;
+                phi_name[nphis++] = name;
+                phi_count[y]++;
+                if (in_work[y] != k) { in_work[y] = k; work[sp++] = y; }
+            }
+        }
+    }
+
+    // Insert the phis at block starts, after the label
+    fn->nphi_args = 0;
+    if (nphis > 0) {
+        int *first = (int *)tac_xrealloc(NULL, sizeof(int) * (nb + 1));
+        for (int b = 0, off = 0; b < nb; b++) { first[b] = off; off += phi_count[b]; }
+        TacInstr *phis = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * nphis);
+        for (int p = 0; p < nphis; p++) {
+            int y = phi_block[p], npred = cfg->blocks[y].npred;
+            int off = tac_phi_alloc(fn, npred);
+            for (int j = 0; j < npred; j++) fn->phi_args[off + j] = phi_name[p];
+            phis[first[y]++] = tac_make(TAC_PHI, OP_NONE, phi_name[p], off, npred, -1);
+        }
+        TacInstr *code = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * (fn->count + nphis + 1));
+        int n = 0, next = 0;
+        for (int b = 0; b < nb; b++) {
+            const TacBlock *bb = &cfg->blocks[b];
+            int i = bb->start;
+            if (i < bb->end && fn->code[i].kind == TAC_LABEL) code[n++] = fn->code[i++];
+            for (int p = 0; p < phi_count[b]; p++) code[n++] = phis[next++];
+            for (; i < bb->end; i++) code[n++] = fn->code[i];
+        }
+        free(fn->code);
+        fn->code = code;
+        fn->count = fn->capacity = n;
+        tac_changed(fn);
+        free(first); free(phis);
+    }
+    free(def_start); free(def_list); free(last); free(df_start); free(df_list);
+    free(has_phi); free(in_work); free(work); free(phi_count); free(phi_block); free(phi_name);
+
+    // Rename along the dominator tree; cur[x] is the version of x in scope
+    cfg = tac_get_cfg(fn);
+    nb = cfg->nblocks;
+    int  nsyms = tac_sym_count;
+    int *cur   = (int *)tac_xrealloc(NULL, sizeof(int) * nsyms);
+    int *undo  = (int *)tac_xrealloc(NULL, sizeof(int) * 2 * (fn->count + 1));
+    int *stack = (int *)tac_xrealloc(NULL, sizeof(int) * 3 * (nb + 1));
+    int  nundo = 0, sp = 0;
+    for (int x = 0; x < nsyms; x++) cur[x] = x;
+    if (cfg->nrpo > 0) {
+        stack[0] = 0; stack[1] = 0; stack[2] = 0;      // block, next child, undo mark
+        sp = 1;
+    }
+    while (sp > 0) {
+        int *fr = &stack[3 * (sp - 1)];
+        int  b  = fr[0];
+        if (fr[1] == 0) {
+            fr[2] = nundo;
+            const TacBlock *bb = &cfg->blocks[b];
+            for (int i = bb->start; i < bb->end; i++) {
+                TacInstr *in = &fn->code[i];
+                if (in->kind != TAC_PHI) {
+                    if (tac_ssa_renamable(in->a) && in->a < nsyms) in->a = cur[in->a];
+                    if (tac_ssa_renamable(in->b) && in->b < nsyms) in->b = cur[in->b];
+                }
+                if (tac_def(in) >= 0 && tac_ssa_renamable(in->dst)) {
+                    int base = in->dst;
+                    undo[2 * nundo] = base;
+                    undo[2 * nundo + 1] = cur[base];
+                    nundo++;
+                    cur[base] = in->dst = tac_ssa_version(base);
+                }
+            }
+            // Fill this block's argument slot in each successor's phis
+            for (int k = 0; k < bb->nsucc; k++) {
+                const TacBlock *sb = &cfg->blocks[bb->succ[k]];
+                int j = 0;
+                while (cfg->pred_list[sb->pred_start + j] != b) j++;
+                for (int i = sb->start; i < sb->end; i++) {
+                    const TacInstr *in = &fn->code[i];
+                    if (in->kind == TAC_LABEL) continue;
+                    if (in->kind != TAC_PHI) break;
+                    fn->phi_args[in->a + j] = cur[tac_ssa_base(in->dst)];
+                }
+            }
+        }
+        int first = cfg->dom_child_start[b], nchild = cfg->dom_child_start[b + 1] - first;
+        if (fr[1] < nchild) {
+            int c = cfg->dom_children[first + fr[1]++];
+            stack[3 * sp] = c; stack[3 * sp + 1] = 0; stack[3 * sp + 2] = 0;
+            sp++;
+            continue;
+        }
+        while (nundo > fr[2]) {
+            nundo--;
+            cur[undo[2 * nundo]] = undo[2 * nundo + 1];
+        }
+        sp--;
+    }
+    free(cur); free(undo); free(stack);
+    tac_changed(fn);
+}
+
+typedef struct {
+    int      pos;       // Insert before this instruction (fn->count: at the end)
+    int      seq;       // Creation order among edits at the same position
+    TacInstr in;
+} TacInsert;
+
+static inline int tac_insert_cmp(const void *x, const void *y) {
+    const TacInsert *a = (const TacInsert *)x, *b = (const TacInsert *)y;
+    return a->pos != b->pos ? a->pos - b->pos : a->seq - b->seq;
+}
+
+static inline void tac_insert_add(TacInsert **ins, int *n, int *cap, int pos, TacInstr in) {
+    if (*n >= *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        *ins = (TacInsert *)tac_xrealloc(*ins, sizeof(TacInsert) * *cap);
+    }
+    (*ins)[*n].pos = pos;
+    (*ins)[*n].seq = *n;
+    (*ins)[*n].in  = in;
+    (*n)++;
+}
+
+static inline void tac_from_ssa(TacFunc *fn) {
+    TacCFG *cfg = tac_get_cfg(fn);
+    int nb = cfg->nblocks;
+    TacInsert *ins = NULL;
+    int nins = 0, cap = 0;
+
+    // Labels for join blocks that lack one, added after all copies
+    int *block_label = (int *)tac_xrealloc(NULL, sizeof(int) * (nb + 1));
+    for (int b = 0; b < nb; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        block_label[b] = bb->start < bb->end && fn->code[bb->start].kind == TAC_LABEL ? fn->code[bb->start].label : -1;
+    }
+    char *need_label = (char *)calloc(nb + 1, 1);
+    int  *split      = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    int   nsplit     = 0;
+    int   open_end   = fn->count == 0 || (fn->code[fn->count - 1].kind != TAC_GOTO &&
+                                           fn->code[fn->count - 1].kind != TAC_RETURN);
+
+    int *dsts = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    int *srcs = (int *)tac_xrealloc(NULL, sizeof(int) * (fn->count + 1));
+    for (int b = 0; b < nb; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        int p0 = bb->start;
+        if (p0 < bb->end && fn->code[p0].kind == TAC_LABEL) p0++;
+        if (p0 >= bb->end || fn->code[p0].kind != TAC_PHI) continue;
+        for (int j = 0; j < bb->npred; j++) {
+            int pred = cfg->pred_list[bb->pred_start + j];
+            // The parallel copy for this edge; sources overwritten by an
+            // earlier copy of the group are saved in temps first
+            int n = 0;
+            for (int i = p0; i < bb->end && fn->code[i].kind == TAC_PHI; i++) {
+                const TacInstr *phi = &fn->code[i];
+                int src = fn->phi_args[phi->a + j];
+                if (src == phi->dst) continue;
+                dsts[n] = phi->dst;
+                srcs[n++] = src;
+            }
+            if (n == 0) continue;
+            TacInstr seq[2 * n + 2];
+            int ns = 0;
+            for (int k = 0; k < n; k++)
+                for (int m = 0; m < n; m++)
+                    if (srcs[k] == dsts[m]) {
+                        int t = tac_new_temp();
+                        seq[ns++] = tac_make(TAC_COPY, OP_NONE, t, srcs[k], -1, -1);
+                        srcs[k] = t;
+                        break;
+                    }
+            for (int k = 0; k < n; k++) seq[ns++] = tac_make(TAC_COPY, OP_NONE, dsts[k], srcs[k], -1, -1);
+
+            const TacBlock *pb = &cfg->blocks[pred];
+            const TacInstr *last = pb->end > pb->start ? &fn->code[pb->end - 1] : NULL;
+            if (last && last->kind == TAC_GOTO) {
+                for (int k = 0; k < ns; k++) tac_insert_add(&ins, &nins, &cap, pb->end - 1, seq[k]);
+            } else if (last && tac_is_cond_branch(last)) {
+                int target_is_b = block_label[b] >= 0 && last->label == block_label[b];
+                if (pred + 1 == b)          // Fall-through edge: copies between the two blocks
+                    for (int k = 0; k < ns; k++) tac_insert_add(&ins, &nins, &cap, pb->end, seq[k]);
+                if (target_is_b) {          // Taken edge: split it with a block at the end
+                    int Ls = tac_new_label();
+                    split[nsplit++] = Ls;
+                    if (open_end) {         // Keep falling off the end a return
+                        tac_insert_add(&ins, &nins, &cap, fn->count, tac_make(TAC_RETURN, OP_NONE, -1, -1, -1, -1));
+                        open_end = 0;
+                    }
+                    fn->code[pb->end - 1].label = Ls;
+                    tac_insert_add(&ins, &nins, &cap, fn->count, tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, Ls));
+                    for (int k = 0; k < ns; k++) tac_insert_add(&ins, &nins, &cap, fn->count, seq[k]);
+                    tac_insert_add(&ins, &nins, &cap, fn->count, tac_make(TAC_GOTO, OP_NONE, -1, -1, -1, block_label[b]));
+                }
+            } else {                        // Plain fall-through into b
+                for (int k = 0; k < ns; k++) tac_insert_add(&ins, &nins, &cap, pb->end, seq[k]);
+            }
+        }
+        for (int i = p0; i < bb->end && fn->code[i].kind == TAC_PHI; i++) fn->code[i].kind = TAC_NOP;
+        if (block_label[b] < 0) need_label[b] = 1;
+    }
+    for (int b = 0; b < nb; b++)
+        if (need_label[b]) {
+            // Only reached by fall-through, so no jump needs it; keep blocks distinct anyway
+            tac_insert_add(&ins, &nins, &cap, cfg->blocks[b].start,
+                           tac_make(TAC_LABEL, OP_NONE, -1, -1, -1, tac_new_label()));
+        }
+    free(dsts); free(srcs); free(block_label); free(need_label);
+
+    if (nins > 0) {
+        qsort(ins, nins, sizeof(TacInsert), tac_insert_cmp);
+        TacInstr *code = (TacInstr *)tac_xrealloc(NULL, sizeof(TacInstr) * (fn->count + nins + 1));
+        int n = 0, k = 0;
+        for (int i = 0; i <= fn->count; i++) {
+            while (k < nins && ins[k].pos == i) code[n++] = ins[k++].in;
+            if (i < fn->count) code[n++] = fn->code[i];
+        }
+        free(fn->code);
+        fn->code = code;
+        fn->count = fn->capacity = n;
+    }
+    free(ins);
+    free(fn->phi_args);
+    fn->phi_args = NULL;
+    fn->nphi_args = fn->phi_cap = 0;
+    tac_compact(fn);
+
+    // Versions of a name can share its original spelling unless one is
+    // defined while another holds a different live value
+    TacLiveness *lv = tac_get_liveness(fn);
+    cfg = tac_get_cfg(fn);
+    int   nsyms    = tac_sym_count;
+    char *live     = (char *)calloc(nsyms, 1);
+    int  *nlive    = (int *)calloc(nsyms, sizeof(int));
+    char *conflict = (char *)calloc(nsyms, 1);
+    int  *touched  = (int *)tac_xrealloc(NULL, sizeof(int) * (nsyms + 1));
+    for (int b = 0; b < cfg->nblocks; b++) {
+        const TacBlock *bb = &cfg->blocks[b];
+        int nt = 0;
+        for (int k = 0; k < lv->nnames; k++) {
+            int x = lv->names[k];
+            if (!BITSET_TEST(lv->out + (size_t)b * lv->words, k) || !tac_ssa_renamable(x)) continue;
+            live[x] = 1; nlive[tac_ssa_base(x)]++; touched[nt++] = x;
+        }
+        for (int i = bb->end - 1; i >= bb->start; i--) {
+            const TacInstr *in = &fn->code[i];
+            int d = tac_def(in);
+            if (d >= 0 && tac_ssa_renamable(d)) {
+                int base = tac_ssa_base(d);
+                int others = nlive[base] - live[d];
+                if (in->kind == TAC_COPY && tac_ssa_renamable(in->a) && in->a != d &&
+                    tac_ssa_base(in->a) == base && live[in->a])
+                    others--;               // Copies of the same value do not conflict
+                if (others > 0) conflict[base] = 1;
+                if (live[d]) { live[d] = 0; nlive[base]--; }
+            }
+            int u[4], nu = tac_uses(in, u);
+            for (int j = 0; j < nu; j++)
+                if (tac_ssa_renamable(u[j]) && !live[u[j]]) {
+                    live[u[j]] = 1; nlive[tac_ssa_base(u[j])]++; touched[nt++] = u[j];
+                }
+        }
+        for (int t = 0; t < nt; t++) { live[touched[t]] = 0; nlive[tac_ssa_base(touched[t])] = 0; }
+    }
+    for (int i = 0; i < fn->count; i++) {
+        TacInstr *in = &fn->code[i];
+        int *ops[3] = { &in->dst, &in->a, &in->b };
+        for (int k = 0; k < 3; k++)
+            if (*ops[k] >= 0 && tac_syms[*ops[k]].ssa_base >= 0 && !conflict[tac_syms[*ops[k]].ssa_base])
+                *ops[k] = tac_syms[*ops[k]].ssa_base;
+        if (in->kind == TAC_COPY && in->dst == in->a) in->kind = TAC_NOP;
+    }
+    free(live); free(nlive); free(conflict); free(touched);
+    tac_compact(fn);
+
+    // Split edges whose copies all coalesced away jump straight to the target again
+    int *at   = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    int *from = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    for (int k = 0; k < nsplit; k++) at[split[k]] = from[split[k]] = -1;
+    for (int i = 0; i < fn->count; i++) {
+        const TacInstr *in = &fn->code[i];
+        if (in->label < 0 || in->label >= tac_sym_count) continue;
+        if (in->kind == TAC_LABEL) at[in->label] = i;
+        else if (tac_is_jump(in))  from[in->label] = i;
+    }
+    for (int k = 0; k < nsplit; k++) {
+        int a = at[split[k]], f = from[split[k]];
+        if (a < 0 || f < 0 || a + 1 >= fn->count || fn->code[a + 1].kind != TAC_GOTO) continue;
+        fn->code[f].label = fn->code[a + 1].label;
+        fn->code[a].kind = fn->code[a + 1].kind = TAC_NOP;
+    }
+    free(at); free(from);
+    free(split);
+    tac_compact(fn);
+}
+
+//--------------------------------------------------- Call Graph
+// Call sites by caller, naming callees by function index; -1 stands for a
+// function the program does not define, which could do anything. A function
+// is pure when its result depends only on its arguments and calling it has
+// no other effect: it writes no global, reads no global that any function
+// writes, and calls only pure functions. Recursion does not spoil purity,
+// so it is a greatest fixpoint: every function starts pure and loses it.
+typedef struct {
+    int  *callee_start;     // Callees of f: callees[callee_start[f] .. callee_start[f + 1])
+    int  *callees;
+    char *pure;
+    int   npure;
+} TacCallGraph;
+
+static inline TacCallGraph *tac_build_call_graph(const TacProgram *prog) {
+    TacCallGraph *cg = (TacCallGraph *)calloc(1, sizeof(TacCallGraph));
+    char *written = (char *)calloc(tac_sym_count + 1, 1);
+    int   ncalls = 0;
+    for (int f = 0; f < prog->count; f++)
+        for (int i = 0; i < prog->funcs[f].count; i++) {
+            const TacInstr *in = &prog->funcs[f].code[i];
+            int d = tac_def(in);
+            if (IS_GLOBAL(d)) written[d] = 1;
+            ncalls += in->kind == TAC_CALL;
+        }
+
+    cg->callee_start = (int *)tac_xrealloc(NULL, sizeof(int) * (prog->count + 1));
+    cg->callees      = (int *)tac_xrealloc(NULL, sizeof(int) * (ncalls + 1));
+    cg->pure         = (char *)tac_xrealloc(NULL, prog->count + 1);
+    int k = 0;
+    for (int f = 0; f < prog->count; f++) {
+        const TacFunc *fn = &prog->funcs[f];
+        cg->callee_start[f] = k;
+        cg->pure[f] = 1;
+        for (int i = 0; i < fn->count; i++) {
+            const TacInstr *in = &fn->code[i];
+            int uses[2], nu = tac_uses(in, uses);
+            if (in->kind == TAC_CALL) {
+                const TacFunc *callee = tac_find_func(prog, SYM_NAME(in->label));
+                cg->callees[k++] = callee ? (int)(callee - prog->funcs) : -1;
+                nu = in->a >= 0;        // b is the argument count
+            }
+            if (IS_GLOBAL(tac_def(in))) cg->pure[f] = 0;
+            for (int u = 0; u < nu; u++)
+                if (IS_GLOBAL(uses[u]) && written[uses[u]]) cg->pure[f] = 0;
+        }
+    }
+    cg->callee_start[prog->count] = k;
+
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int f = 0; f < prog->count; f++)
+            for (int c = cg->callee_start[f]; c < cg->callee_start[f + 1] && cg->pure[f]; c++)
+                if (cg->callees[c] < 0 || !cg->pure[cg->callees[c]]) {
+                    cg->pure[f] = 0;
+                    changed = 1;
+                }
+    }
+    cg->npure = 0;
+    for (int f = 0; f < prog->count; f++) cg->npure += cg->pure[f];
+    free(written);
+    return cg;
+}
+
+static inline void tac_free_call_graph(TacCallGraph *cg) {
+    if (!cg) return;
+    free(cg->callee_start); free(cg->callees); free(cg->pure);
+    free(cg);
+}
+
+//--------------------------------------------------- Static Types
+// Only float operators carry a type in TAC, so backends that need machine
+// types give each name a static type from what is assigned to it, across
+// the whole program:
+// arguments flow into parameters and return values into call results. A
+// name nothing is known about is an int. Phase 4 converts wherever an int
+// meets a float, so a name that receives both has no single machine type
+// and the program is rejected rather than miscompiled.
+
+typedef struct {
+    char **local;       // [function][symbol] type of a local name
+    char  *global;      // Global variables, by symbol
+    char **param;       // [function][parameter]
+    char  *ret;         // Return type per function
+} TacTypes;
+
+// Types form a set: TY_INT | TY_FLOAT is a name that holds both
+static inline int tac_type_join(int x, int y) {
+    return x | y;
+}
+
+static inline int tac_type(const TacTypes *ty, int f, int sym) {
+    if (sym < 0)        return TY_INT;
+    if (IS_CONST(sym))  return tac_is_int_const(sym) ? TY_INT : TY_FLOAT;
+    if (IS_GLOBAL(sym)) return ty->global[sym];
+    return ty->local[f][sym];
+}
+
+static inline int tac_result_type(const TacTypes *ty, int f, const TacInstr *in) {
+    int ta = tac_type(ty, f, in->a);
+    if (in->type == TY_FLOAT) return tac_is_relop(in->op) ? TY_INT : TY_FLOAT;
+    switch (in->op) {
+        case OP_NEG:
+            return ta;
+        case OP_TOFLOAT:
+            return TY_FLOAT;
+        case OP_NONE:
+            return ta;
+        default:
+            return TY_INT;
+    }
+}
+
+// Raise *slot to include t; returns nonzero if it changed
+static inline int tac_type_raise(char *slot, int t) {
+    if (tac_type_join(*slot, t) == *slot) return 0;
+    *slot = (char)tac_type_join(*slot, t);
+    return 1;
+}
+
+static inline int tac_type_raise_sym(TacTypes *ty, int f, int sym, int t) {
+    if (sym < 0 || IS_CONST(sym)) return 0;
+    return tac_type_raise(IS_GLOBAL(sym) ? &ty->global[sym] : &ty->local[f][sym], t);
+}
+
+static inline void tac_mixed_type_error(const char *what, const char *name, const char *func) {
+    if (func) fprintf(stderr, "Error: %s '%s' in function '%s' holds both int and float values\n", what, name, func);
+    else      fprintf(stderr, "Error: %s '%s' holds both int and float values\n", what, name);
+    exit(EXIT_FAILURE);
+}
+
+// Operands of in must have the type its form expects; && and || take either
+static inline void tac_check_form(const TacTypes *ty, int f, const TacFunc *fn, const TacInstr *in) {
+    int is_op = in->kind == TAC_BINARY || ((in->kind == TAC_IF || in->kind == TAC_IFFALSE) && in->op != OP_NONE);
+    if (!is_op || in->op == OP_AND || in->op == OP_OR) return;
+    int want = in->type == TY_FLOAT ? TY_FLOAT : TY_INT;
+    int ta = tac_type(ty, f, in->a), tb = tac_type(ty, f, in->b);
+    if ((ta == TY_TOP || ta == want) && (tb == TY_TOP || tb == want)) return;
+    fprintf(stderr, "Error: %s in function '%s': ",
+            want == TY_FLOAT ? "float operator applied to an int" : "integer operator applied to a float", fn->name);
+    tac_print_instr(stderr, fn, in);
+    exit(EXIT_FAILURE);
+}
+
+// Rejects a program in which some name would need two machine types, or an
+// operator is applied to the other type
+static inline void tac_check_types(const TacProgram *prog, const TacTypes *ty) {
+    const int mixed = TY_INT | TY_FLOAT;
+    for (int g = 0; g < prog->nglobals; g++)
+        if (ty->global[prog->globals[g].sym] == mixed)
+            tac_mixed_type_error("global", SYM_NAME(prog->globals[g].sym), NULL);
+    for (int f = 0; f < prog->count; f++) {
+        const TacFunc *fn = &prog->funcs[f];
+        if (ty->ret[f] == mixed) tac_mixed_type_error("return value of", fn->name, NULL);
+        for (int sym = 0; sym < tac_sym_count; sym++)
+            if (ty->local[f][sym] == mixed) tac_mixed_type_error("name", SYM_NAME(sym), fn->name);
+        for (int i = 0; i < fn->count; i++) tac_check_form(ty, f, fn, &fn->code[i]);
+    }
+}
+
+static inline TacTypes *tac_infer_types(const TacProgram *prog) {
+    int nsyms = tac_sym_count;
+    TacTypes *ty = (TacTypes *)calloc(1, sizeof(TacTypes));
+    ty->local  = (char **)tac_xrealloc(NULL, sizeof(char *) * (prog->count + 1));
+    ty->param  = (char **)tac_xrealloc(NULL, sizeof(char *) * (prog->count + 1));
+    ty->ret    = (char *)calloc(prog->count + 1, 1);
+    ty->global = (char *)calloc(nsyms + 1, 1);
+    for (int f = 0; f < prog->count; f++) {
+        ty->local[f] = (char *)calloc(nsyms + 1, 1);
+        ty->param[f] = (char *)calloc(prog->funcs[f].nparams + 1, 1);
+    }
+    for (int g = 0; g < prog->nglobals; g++)
+        if (prog->globals[g].init >= 0) ty->global[prog->globals[g].sym] = (char)tac_type(ty, 0, prog->globals[g].init);
+
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int f = 0; f < prog->count; f++) {
+            const TacFunc *fn = &prog->funcs[f];
+            for (int k = 0; k < fn->nparams; k++) changed |= tac_type_raise_sym(ty, f, fn->params[k], ty->param[f][k]);
+            for (int i = 0; i < fn->count; i++) {
+                const TacInstr *in = &fn->code[i];
+                switch (in->kind) {
+                    case TAC_COPY:
+                    case TAC_UNARY:
+                    case TAC_BINARY:
+                        changed |= tac_type_raise_sym(ty, f, in->dst, tac_result_type(ty, f, in));
+                        break;
+                    case TAC_RETURN:
+                        if (in->a >= 0) changed |= tac_type_raise(&ty->ret[f], tac_type(ty, f, in->a));
+                        break;
+                    case TAC_CALL: {
+                        const TacFunc *callee = tac_find_func(prog, SYM_NAME(in->label));
+                        if (!callee) {
+                            fprintf(stderr, "Error: call to undefined function '%s'\n", SYM_NAME(in->label));
+                            exit(EXIT_FAILURE);
+                        }
+                        int c = (int)(callee - prog->funcs), n = (int)tac_const_int(in->b);
+                        // The arguments are the n params right before the call
+                        for (int k = 0, j = i - n; k < n && k < callee->nparams; k++, j++)
+                            changed |= tac_type_raise(&ty->param[c][k], tac_type(ty, f, fn->code[j].a));
+                        changed |= tac_type_raise_sym(ty, f, in->dst, ty->ret[c]);
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+    tac_check_types(prog, ty);
+    return ty;
+}
+
+static inline void tac_free_types(const TacProgram *prog, TacTypes *ty) {
+    if (!ty) return;
+    for (int f = 0; f < prog->count; f++) {
+        free(ty->local[f]);
+        free(ty->param[f]);
+    }
+    free(ty->local); free(ty->param); free(ty->ret); free(ty->global);
+    free(ty);
+}
+
+//--------------------------------------------------- Reference Interpreter
+// Runs a function straight off its instruction array. It exists to check
+// transformations and to count dynamic instructions, not to be fast.
+// Arithmetic follows C: int unless an operand is a float, and literals
+// with a decimal point are floats. With tac_trapping set a runtime error
+// does not exit: it is recorded in tac_trap and the run unwinds, which is
+// how the optimizer evaluates calls at compile time.
+typedef struct {
+    int    is_float;
+    long   i;
+    double f;
+} TacValue;
+
+typedef struct {
+    long executed;      // Instructions executed, labels excluded
+    long jumps;         // Jumps taken, conditional or not
+    long branches;      // Conditional branches executed
+    long calls;         // Calls made
+    long step_limit;    // Runtime error after this many instructions, 0 for no limit
+    int  depth_limit;   // Nested calls allowed, 0 for TAC_MAX_CALL_DEPTH
+} TacRunStats;
+
+static int         tac_trapping = 0;
+static const char *tac_trap     = NULL;     // First error while trapping
+
+static inline TacValue tac_int_value(long i) {
+    TacValue v = { 0, i, 0.0 };
+    return v;
+}
+
+static inline TacValue tac_float_value(double f) {
+    TacValue v = { 1, 0, f };
+    return v;
+}
+
+// Symbol of the shortest literal that reads back as v
+static inline int tac_value_literal(TacValue v) {
+    if (!v.is_float) return tac_intern_int(v.i);
+    char buf[64];
+    for (int prec = 6; prec <= 17; prec++) {
+        snprintf(buf, sizeof(buf), "%.*g", prec, v.f);
+        if (strtod(buf, NULL) == v.f) break;
+    }
+    // Float literals are told apart from ints by their '.'
+    if (!strchr(buf, '.')) {
+        char *e = strchr(buf, 'e');
+        char tail[64] = "";
+        if (e) { snprintf(tail, sizeof(tail), "%s", e); *e = '\0'; }
+        strcat(buf, ".0");
+        strcat(buf, tail);
+    }
+    return tac_intern(buf);
+}
+
+static inline TacValue tac_const_value(int sym) {
+    const char *s = SYM_NAME(sym);
+    return strchr(s, '.') ? tac_float_value(strtod(s, NULL)) : tac_int_value(strtol(s, NULL, 10));
+}
+
+static inline int tac_value_true(TacValue v) {
+    return v.is_float ? v.f != 0.0 : v.i != 0;
+}
+
+static inline void tac_runtime_error(const char *msg, const char *fname) {
+    if (tac_trapping) {
+        if (!tac_trap) tac_trap = msg;
+        return;
+    }
+    fprintf(stderr, "TAC Runtime Error: %s in function '%s'\n", msg, fname);
+    exit(EXIT_FAILURE);
+}
+
+static inline TacValue tac_eval(const char *fname, TacOp op, TacValue x, TacValue y) {
+    switch (op) {
+        case OP_NOT: return tac_int_value(!tac_value_true(x));
+        case OP_NEG: return x.is_float ? tac_float_value(-x.f) : tac_int_value(-x.i);
+        case OP_TOINT:   return x.is_float ? tac_int_value((long)x.f) : x;
+        case OP_TOFLOAT: return x.is_float ? x : tac_float_value((double)x.i);
+        case OP_AND: return tac_int_value(tac_value_true(x) && tac_value_true(y));
+        case OP_OR:  return tac_int_value(tac_value_true(x) || tac_value_true(y));
+        default:     break;
+    }
+    if (x.is_float || y.is_float) {
+        double a = x.is_float ? x.f : (double)x.i;
+        double b = y.is_float ? y.f : (double)y.i;
+        switch (op) {
+            case OP_ADD: return tac_float_value(a + b);
+            case OP_SUB: return tac_float_value(a - b);
+            case OP_MUL: return tac_float_value(a * b);
+            case OP_DIV: return tac_float_value(a / b);
+            case OP_LT:  return tac_int_value(a < b);
+            case OP_GT:  return tac_int_value(a > b);
+            case OP_LE:  return tac_int_value(a <= b);
+            case OP_GE:  return tac_int_value(a >= b);
+            case OP_EQ:  return tac_int_value(a == b);
+            case OP_NE:  return tac_int_value(a != b);
+            default:     tac_runtime_error("integer operator applied to a float", fname);
+        }
+    }
+    long a = x.i, b = y.i;
+    switch (op) {
+        case OP_ADD:  return tac_int_value(a + b);
+        case OP_SUB:  return tac_int_value(a - b);
+        case OP_MUL:  return tac_int_value(a * b);
+        case OP_DIV:
+        case OP_MOD:
+            if (b == 0) {
+                tac_runtime_error("division by zero", fname);
+                return tac_int_value(0);
+            }
+            return tac_int_value(op == OP_DIV ? a / b : a % b);
+        case OP_LT:   return tac_int_value(a < b);
+        case OP_GT:   return tac_int_value(a > b);
+        case OP_LE:   return tac_int_value(a <= b);
+        case OP_GE:   return tac_int_value(a >= b);
+        case OP_EQ:   return tac_int_value(a == b);
+        case OP_NE:   return tac_int_value(a != b);
+        case OP_SHL:  return tac_int_value(a << b);
+        case OP_SHR:  return tac_int_value(a >> b);
+        case OP_BAND: return tac_int_value(a & b);
+        default:      tac_runtime_error("unknown operator", fname);
+    }
+    return tac_int_value(0);
+}
+
+// A float operator must only ever see floats, and the int form of one only
+// ints: anything else means phase 4 left out a conversion, and the backends
+// would read an int's bits as a double or the other way round
+static inline TacValue tac_eval_instr(const char *fname, const TacInstr *in, TacValue x, TacValue y) {
+    if (in->type == TY_FLOAT && (!x.is_float || !y.is_float))
+        tac_runtime_error("float operator applied to an int", fname);
+    if (in->type != TY_FLOAT && tac_has_float_form(in->op) && (x.is_float || y.is_float))
+        tac_runtime_error("integer operator applied to a float", fname);
+    return tac_eval(fname, in->op, x, y);
+}
+
+// Values are indexed by symbol id. Constants and global initializers are
+// filled in here, so create the environment after the last pass has run.
+static inline TacValue *tac_env_new(const TacProgram *prog) {
+    TacValue *env = (TacValue *)calloc(tac_sym_count + 1, sizeof(TacValue));
+    for (int s = 0; s < tac_sym_count; s++)
+        if (IS_CONST(s)) env[s] = tac_const_value(s);
+    for (int g = 0; prog && g < prog->nglobals; g++)
+        if (prog->globals[g].init >= 0) env[prog->globals[g].sym] = tac_const_value(prog->globals[g].init);
+    return env;
+}
+
+static int tac_call_depth = 0;
+
+// Run fn with its variables in env. A call runs the callee on a copy of the
+// caller's environment and copies the globals back when it returns.
+static inline TacValue tac_run(const TacProgram *prog, const TacFunc *fn, TacValue *env, TacRunStats *st) {
+    int *label_pc = (int *)tac_xrealloc(NULL, sizeof(int) * (tac_sym_count + 1));
+    for (int i = 0; i < fn->count; i++)
+        if (fn->code[i].kind == TAC_LABEL) label_pc[fn->code[i].label] = i;
+
+    TacValue  ret  = tac_int_value(0);
+    TacValue *args = NULL;
+    int nargs = 0, pc = 0;
+    while (pc < fn->count && !tac_trap) {
+        const TacInstr *in = &fn->code[pc++];
+        if (in->kind == TAC_LABEL || in->kind == TAC_NOP) continue;
+        st->executed++;
+        if (st->step_limit && st->executed > st->step_limit) {
+            tac_runtime_error("step limit reached", fn->name);
+            break;
+        }
+        switch (in->kind) {
+            case TAC_COPY:
+                env[in->dst] = env[in->a];
+                break;
+            case TAC_UNARY:
+                env[in->dst] = tac_eval(fn->name, in->op, env[in->a], env[in->a]);
+                break;
+            case TAC_BINARY:
+                env[in->dst] = tac_eval_instr(fn->name, in, env[in->a], env[in->b]);
+                break;
+            case TAC_GOTO:
+                pc = label_pc[in->label];
+                st->jumps++;
+                break;
+            case TAC_IF:
+            case TAC_IFFALSE: {
+                TacValue c = in->op == OP_NONE ? env[in->a] : tac_eval_instr(fn->name, in, env[in->a], env[in->b]);
+                st->branches++;
+                if (tac_value_true(c) == (in->kind == TAC_IF)) {
+                    pc = label_pc[in->label];
+                    st->jumps++;
+                }
+                break;
+            }
+            case TAC_RETURN:
+                if (in->a >= 0) ret = env[in->a];
+                pc = fn->count;
+                break;
+            case TAC_PARAM:
+                args = (TacValue *)tac_xrealloc(args, sizeof(TacValue) * (nargs + 1));
+                args[nargs++] = env[in->a];
+                break;
+            case TAC_CALL: {
+                const TacFunc *callee = tac_find_func(prog, SYM_NAME(in->label));
+                int n = (int)tac_const_int(in->b);
+                if (!callee || n != callee->nparams || n > nargs) {
+                    tac_runtime_error(callee ? "wrong number of arguments" : "call to an undefined function", fn->name);
+                    break;
+                }
+                if (tac_call_depth >= (st->depth_limit ? st->depth_limit : TAC_MAX_CALL_DEPTH)) {
+                    tac_runtime_error("call stack overflow", fn->name);
+                    break;
+                }
+                tac_call_depth++;
+                TacValue *frame = (TacValue *)tac_xrealloc(NULL, sizeof(TacValue) * (tac_sym_count + 1));
+                memcpy(frame, env, sizeof(TacValue) * (tac_sym_count + 1));
+                nargs -= n;
+                for (int k = 0; k < n; k++) frame[callee->params[k]] = args[nargs + k];
+                st->calls++;
+                TacValue r = tac_run(prog, callee, frame, st);
+                for (int g = 0; g < prog->nglobals; g++) env[prog->globals[g].sym] = frame[prog->globals[g].sym];
+                if (in->dst >= 0) env[in->dst] = r;
+                free(frame);
+                tac_call_depth--;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    free(label_pc);
+    free(args);
+    return ret;
+}
+
+#endif
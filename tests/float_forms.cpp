@@ -0,0 +1,30 @@
+// expect: 29
+// Every backend takes int or float arithmetic from the operator's form
+// ("a * b" or "a *. b") rather than from the operands, so the peephole
+// rewrites must keep the form: !!f on a float, x - x and x * 0 on floats.
+float scale = 2.5;
+
+int check(float x, int k) {
+    int r = 0;
+    float z = x - x;
+    float w = x * 0.0;
+    if (!!x) {
+        r = r + 1;
+    }
+    if (z == 0.0) {
+        r = r + 2;
+    }
+    if (w == 0.0) {
+        r = r + 4;
+    }
+    if (x * 1.0 > 2.0) {
+        r = r + k;
+    }
+    return r;
+}
+
+int main() {
+    int total = check(scale, 16);
+    total = total + check(0.0, 100);
+    return total;
+}
@@ -0,0 +1,11 @@
+// expect: -63
+// Global initializers that are not a single literal: phase 4 once kept only
+// a Number initializer, so g started at 0 instead of -7.
+int g = 0 - 7;
+int k = (3 + 4) * 2 / 3 % 4 + 1;
+float h = (float)7 / 2 - 0.5;
+
+int main() {
+    float s = h * 2.0;
+    return g * 10 + k + (int)s;
+}
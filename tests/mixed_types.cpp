@@ -0,0 +1,23 @@
+// expect: -9
+// Int and float temps are live in the same loop; the register allocator
+// once gave them the same %r register, so the backends typed the int
+// arithmetic as float.
+int limit = 10;
+
+int mix(int count) {
+    float f = 1.0;
+    int s = 0;
+    int n;
+    for (n = 0; n < count; n = n + 1) {
+        f = f * 1.5 + 0.25;
+        s = (s + n) / 2 * 3 - n;
+    }
+    if (f > 100.0) {
+        s = s + 1;
+    }
+    return s;
+}
+
+int main() {
+    return mix(limit);
+}
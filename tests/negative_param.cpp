@@ -0,0 +1,18 @@
+// expect: -21
+// n is only ever stepped upward inside f, but its value on entry comes from
+// the caller and is negative here, so n % 4 and n / 2 must not become n & 3
+// and n >> 1. The call to twice keeps f from being inlined into main.
+int base = 7;
+
+int twice(int x) {
+    return x + x;
+}
+
+int f(int n) {
+    n = n + 2;
+    return n % 4 + twice(n / 2) * 5;
+}
+
+int main() {
+    return f(0 - base);
+}
@@ -0,0 +1,42 @@
+#!/bin/sh
+# End-to-end regression programs. Each tests/*.cpp goes through phases 1-5
+# with the default options and then runs on the VM, the x86-64 JIT and the
+# C backend; all three must return the value on its "// expect: N" line
+# (the C program's exit status holds only the low 8 bits).
+# Run from the repository root:
+#     sh tests/run_tests.sh
+root=$(pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+for p in phase1_lexer phase2_syntax phase_3_semantic phase_4_tac_generator phase_5_optimizer \
+         phase_6_vm phase_7_x86_backend phase_8_c_backend; do
+    gcc -O2 -I"$root" "$root/$p.c" -o "$work/$p" -lm || exit 1
+done
+
+failed=0
+for t in "$root"/tests/*.cpp; do
+    name=$(basename "$t" .cpp)
+    want=$(sed -n 's|^// expect: *\(-*[0-9]*\).*|\1|p' "$t")
+    cp "$t" "$work/source_file.cpp"
+    cd "$work"
+    if ! (./phase1_lexer && ./phase2_syntax && timeout 10 ./phase_3_semantic &&
+          ./phase_4_tac_generator && ./phase_5_optimizer) > pipeline.log 2>&1; then
+        echo "FAIL $name: pipeline (see phase output below)"
+        tail -5 pipeline.log
+        failed=1
+        cd "$root"
+        continue
+    fi
+    vm=$(./phase_6_vm tac_opt.txt | sed -n 's/^\[vm\] main returned //p')
+    jit=$(./phase_7_x86_backend -jit tac_opt.txt | sed -n 's/^\[jit\] main returned //p')
+    ./phase_8_c_backend -o out.c tac_opt.txt > /dev/null && cc -O2 out.c -o out_c && ./out_c
+    c=$?
+    if [ "$vm" = "$want" ] && [ "$jit" = "$want" ] && [ "$c" -eq $(( (want % 256 + 256) % 256 )) ]; then
+        echo "ok   $name ($want)"
+    else
+        echo "FAIL $name: expected $want, vm $vm, jit $jit, c exit status $c"
+        failed=1
+    fi
+    cd "$root"
+done
+exit $failed
@@ -0,0 +1,18 @@
+// expect: 1803
+// Bodies without braces: phase 2 once put the statement itself under If,
+// Else, While or For instead of a Body, and phase 3 never got past it.
+int pick(int x) {
+    int y = 0;
+    if (x > 10) { y = 1; } else y = 7;
+    if (x > 3) y = y * 10;
+    if (x > 100) y = y + 1; else if (x > 4) y = y + 2; else y = y + 3;
+    while (x > 1) x = x - 1;
+    return y + x;
+}
+
+int main() {
+    int s = 0;
+    int i;
+    for (i = 0; i < 3; i = i + 1) s = s * 10 + pick(i * 5);
+    return s;
+}